@@ -0,0 +1,115 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/geom/builtin.h>
+#include <libcurv/geom/tempfile.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace curv;
+
+static std::vector<Benchmark*>& registry()
+{
+    static std::vector<Benchmark*> benchmarks;
+    return benchmarks;
+}
+
+Benchmark::Benchmark(const char* name, void (*run)())
+:
+    name_(name),
+    run_(run)
+{
+    registry().push_back(this);
+}
+
+void report(const char* name, const char* what,
+    double count, const char* unit, double seconds)
+{
+    std::cout << name << ": " << what << ": "
+        << (long long)(count / seconds) << " " << unit << "/s ("
+        << (long long)count << " " << unit << " in " << seconds << "s)"
+        << std::endl;
+}
+
+void report_allocations(const char* name, const char* what,
+    double allocations, double count, const char* unit)
+{
+    std::cout << name << ": " << what << ": "
+        << allocations / count << " allocations per " << unit
+        << std::endl;
+}
+
+// glibc allows a program to replace malloc and related functions.
+// These replacements count the allocations, then call the glibc versions.
+static std::atomic<size_t> nallocations{0};
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void __libc_free(void*);
+
+void* malloc(size_t size)
+{
+    nallocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+void* calloc(size_t n, size_t size)
+{
+    nallocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+void* realloc(void* p, size_t size)
+{
+    nallocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+void free(void* p)
+{
+    __libc_free(p);
+}
+}
+#endif
+
+size_t bench_allocations()
+{
+    return nallocations.load(std::memory_order_relaxed);
+}
+
+System& bench_system()
+{
+    static System_Impl* sys = nullptr;
+    if (sys == nullptr) {
+        sys = new System_Impl(std::cerr);
+        geom::add_builtins(*sys);
+        sys->load_library(make_string("../lib/curv/std.curv"));
+    }
+    return *sys;
+}
+
+int
+main(int argc, char** argv)
+{
+    atexit(geom::remove_all_tempfiles);
+    try {
+        for (auto b : registry()) {
+            bool selected = (argc == 1);
+            for (int i = 1; i < argc; ++i) {
+                if (strcmp(argv[i], b->name_) == 0)
+                    selected = true;
+            }
+            if (selected)
+                b->run_();
+        }
+    } catch (std::exception& e) {
+        bench_system().error(e);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <libcurv/system.h>
+#include <chrono>
+
+// A minimal benchmark harness.
+//
+// A benchmark is a function defined using the BENCHMARK macro. It times an
+// operation using a Bench_Timer, then reports the throughput using `report`.
+// `make bench` builds an optimized `bench` executable and runs all of the
+// benchmarks. `bench name...` runs the named benchmarks.
+
+struct Benchmark
+{
+    const char* name_;
+    void (*run_)();
+
+    // Registers the benchmark.
+    Benchmark(const char* name, void (*run)());
+};
+
+#define BENCHMARK(name) \
+    static void bench_##name(); \
+    static Benchmark benchmark_##name(#name, bench_##name); \
+    static void bench_##name()
+
+struct Bench_Timer
+{
+    std::chrono::steady_clock::time_point start_ =
+        std::chrono::steady_clock::now();
+
+    // Seconds elapsed since the timer was constructed.
+    double elapsed() const
+    {
+        std::chrono::duration<double> d =
+            std::chrono::steady_clock::now() - start_;
+        return d.count();
+    }
+};
+
+// Print a line like "name: what: 1234 units/s (count units in 1.2s)".
+void report(const char* name, const char* what,
+    double count, const char* unit, double seconds);
+
+// Print a line like "name: what: 1.5 allocations per unit".
+void report_allocations(const char* name, const char* what,
+    double allocations, double count, const char* unit);
+
+// The number of heap allocations (calls to malloc, calloc and realloc)
+// made so far. Allocations are only counted when using glibc: elsewhere,
+// this returns 0.
+size_t bench_allocations();
+
+// A System with the standard library loaded, shared by all benchmarks.
+curv::System& bench_system();
+
+#endif // header guard
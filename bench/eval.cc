@@ -0,0 +1,132 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/geom/builtin.h>
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/program.h>
+#include <libcurv/source.h>
+#include <iostream>
+#include <thread>
+
+using namespace curv;
+
+// A System with the standard library loaded, which uses either the tree
+// walking interpreter or the bytecode interpreter to call functions.
+static System&
+evaluator_system(bool bytecode)
+{
+    static System_Impl* systems[2] = {nullptr, nullptr};
+    System_Impl*& sys = systems[bytecode];
+    if (sys == nullptr) {
+        sys = new System_Impl(std::cerr);
+        sys->use_bytecode_ = bytecode;
+        geom::add_builtins(*sys);
+        sys->load_library(make_string("../lib/curv/std.curv"));
+    }
+    return *sys;
+}
+
+// Evaluate a program using both interpreters, and check that the results
+// are the same.
+static void
+eval_program(const char* what, const char* src, double count, const char* unit)
+{
+    Value results[2];
+    for (int bytecode = 0; bytecode <= 1; ++bytecode) {
+        System& sys = evaluator_system(bytecode);
+        Program prog{make<String_Source>("", src), sys};
+        prog.compile();
+        Bench_Timer t;
+        results[bytecode] = prog.eval();
+        report(bytecode ? "evaluator bytecode" : "evaluator tree",
+            what, count, unit, t.elapsed());
+        if (bytecode && !results[0].equal(results[1], At_Program(prog)))
+            throw Exception(At_Program(prog), "results differ");
+    }
+}
+
+BENCHMARK(evaluator)
+{
+    eval_program("tail recursion",
+        "let sum(i,acc) = if (i <= 0) acc else sum(i-1, acc+i);"
+        "in sum(1000000, 0)",
+        1e6, "calls");
+    eval_program("fib",
+        "let fib n = if (n < 2) n else fib(n-1) + fib(n-2);"
+        "in fib 25",
+        242785, "calls");
+    eval_program("map",
+        "let f x = let y = x*x; in if (y > 100 && x != 3) y - x else -y;"
+        "in sum(map f (0..<200000))",
+        2e5, "calls");
+    eval_program("vector",
+        "let d[x,y,z] = sqrt(x*x + y*y + z*z) - 1;"
+        "    g(p,i) = if (i <= 0) p else g(p*0.5 + [d p, 1, 2], i-1);"
+        "in g([1,2,3], 300000)",
+        3e5, "calls");
+    eval_program("for loop",
+        "do local s = 0; for (i in 0..<1000000) s := s + i; in s",
+        1e6, "iterations");
+    eval_program("list comprehension",
+        "sum [for (i in 0..<1000000) i*i]",
+        1e6, "elements");
+}
+
+// Arithmetic on lists of numbers: vectors, matrices, and long lists.
+BENCHMARK(array_op)
+{
+    eval_program("vec3*num + vec3",
+        "let g(p,i) = if (i <= 0) p else g(p*0.5 + [1,2,3], i-1);"
+        "in g([1,2,3], 300000)",
+        6e5, "ops");
+    eval_program("mat3 dot vec3",
+        "let m = [[0,1,0],[-1,0,0],[0,0,1]];"
+        "    g(p,i) = if (i <= 0) p else g(dot(m,p), i-1);"
+        "in g([1,2,3], 100000)",
+        1e5, "ops");
+    eval_program("mat3 * mat3",
+        "let m = [[0,1,0],[-1,0,0],[0,0,1]];"
+        "    g(a,i) = if (i <= 0) a else g(dot(a,m), i-1);"
+        "in g(m, 30000)",
+        3e4, "ops");
+    eval_program("list of 1000",
+        "let v = 0..<1000;"
+        "    g(a,i) = if (i <= 0) a else g(a*0.5 + v, i-1);"
+        "in sum(g(v, 10000))",
+        2e7, "elements");
+}
+
+// Evaluate a program with 8 independent, expensive top-level definitions,
+// using 1 thread and using one thread per core.
+BENCHMARK(eval_parallel)
+{
+    const char* src =
+        "let fib n = if (n < 2) n else fib(n-1) + fib(n-2);\n"
+        "    a = fib 22; b = fib 22; c = fib 22; d = fib 22;\n"
+        "    e = fib 22; f = fib 22; g = fib 22; h = fib 22;\n"
+        "in [a,b,c,d,e,f,g,h]";
+    unsigned ncores = std::thread::hardware_concurrency();
+    if (ncores == 0) ncores = 1;
+    System& sys = evaluator_system(false);
+    Value results[2];
+    int i = 0;
+    for (unsigned nthreads : {1u, ncores}) {
+        sys.eval_threads_ = nthreads;
+        Program prog{make<String_Source>("", src), sys};
+        prog.compile();
+        Bench_Timer t;
+        results[i] = prog.eval();
+        report("eval_parallel",
+            stringify(nthreads, nthreads == 1 ? " thread" : " threads")
+                ->c_str(),
+            8, "definitions", t.elapsed());
+        if (i > 0 && !results[0].equal(results[1], At_Program(prog)))
+            throw Exception(At_Program(prog), "results differ");
+        ++i;
+    }
+    sys.eval_threads_ = 1;
+}
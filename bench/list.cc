@@ -0,0 +1,62 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/list.h>
+#include <libcurv/program.h>
+#include <libcurv/source.h>
+
+using namespace curv;
+
+// Time a list construction loop, and count its heap allocations.
+template <class F>
+static void
+construct(const char* what, size_t nlists, size_t n, F f)
+{
+    size_t a = bench_allocations();
+    Bench_Timer t;
+    for (size_t i = 0; i < nlists; ++i)
+        f(n);
+    double secs = t.elapsed();
+    report("list_construct", what, double(nlists*n), "elements", secs);
+    report_allocations("list_construct", what,
+        double(bench_allocations() - a), double(nlists), "list");
+}
+
+BENCHMARK(list_construct)
+{
+    for (size_t n : {3, 1000}) {
+        size_t nlists = 3000000 / n;
+        construct(n == 3 ? "List_Builder, 3 elements"
+                         : "List_Builder, 1000 elements",
+            nlists, n, [](size_t n)->void {
+                List_Builder lb;
+                for (size_t i = 0; i < n; ++i)
+                    lb.push_back(Value{double(i)});
+                lb.get_list();
+            });
+    }
+
+    // List literals and list comprehensions, using the tree interpreter.
+    struct { const char* what; const char* src; double count; } progs[] = {
+        {"list literal",
+         "let f(p,i) = if (i <= 0) p else f([p[1],p[2],p[0]], i-1);"
+         "in f([1,2,3], 300000)", 3e5},
+        {"list comprehension",
+         "let f(p,i) = if (i <= 0) p else f([for (x in p) x], i-1);"
+         "in f([1,2,3], 300000)", 3e5},
+    };
+    for (auto& p : progs) {
+        Program prog{make<String_Source>("", p.src), bench_system()};
+        prog.compile();
+        size_t a = bench_allocations();
+        Bench_Timer t;
+        prog.eval();
+        double secs = t.elapsed();
+        report("list_construct", p.what, p.count, "lists", secs);
+        report_allocations("list_construct", p.what,
+            double(bench_allocations() - a), p.count, "list");
+    }
+}
@@ -0,0 +1,117 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/geom/compiled_shape.h>
+#include <libcurv/geom/mesh.h>
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/program.h>
+#include <libcurv/source.h>
+#include <cmath>
+#include <streambuf>
+
+using namespace curv;
+
+namespace {
+
+// A stream buffer that counts and discards its output, so that we measure
+// the cost of formatting a mesh file, not the speed of the disk.
+struct Counting_Buf : public std::streambuf
+{
+    double count_ = 0;
+
+    std::streamsize xsputn(const char*, std::streamsize n) override
+    {
+        count_ += n;
+        return n;
+    }
+    int overflow(int c) override
+    {
+        ++count_;
+        return traits_type::not_eof(c);
+    }
+};
+
+// A torus made of n*n quads, with irregular float coordinates like the
+// output of a mesher.
+geom::Mesh make_torus(unsigned n)
+{
+    geom::Mesh mesh;
+    const double pi = 3.141592653589793;
+    for (unsigned i = 0; i < n; ++i) {
+        double a = 2*pi*i/n;
+        for (unsigned j = 0; j < n; ++j) {
+            double b = 2*pi*j/n;
+            double r = 3 + std::cos(b);
+            mesh.points_.push_back(glm::vec3(
+                float(r*std::cos(a)), float(r*std::sin(a)), float(std::sin(b))));
+        }
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned i1 = (i + 1) % n;
+        for (unsigned j = 0; j < n; ++j) {
+            unsigned j1 = (j + 1) % n;
+            mesh.quads_.push_back(
+                glm::uvec4(i*n + j, i1*n + j, i1*n + j1, i*n + j1));
+        }
+    }
+    return mesh;
+}
+
+// For comparison: writing an OBJ file using `out << x` for each value.
+void write_obj_ostream(const geom::Mesh& mesh, std::ostream& out)
+{
+    for (auto& pt : mesh.points_)
+        out << "v " << pt.x << " " << pt.y << " " << pt.z << "\n";
+    for (auto& q : mesh.quads_) {
+        out << "f " << q[0]+1 << " " << q[1]+1 << " "
+                    << q[2]+1 << " " << q[3]+1 << "\n";
+    }
+}
+
+} // namespace
+
+// Writing a mesh file, for each mesh format.
+BENCHMARK(mesh_write)
+{
+    geom::Mesh mesh = make_torus(500);
+    const double ntri = double(mesh.ntriangles());
+
+    Program prog{make<String_Source>("", "sphere 8 >> colour red"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+    geom::Compiled_Shape cshape(shape, geom::Jit_Backend::vm);
+
+    enum Format { stl_ascii, stl_binary, obj, obj_ostream, x3d };
+    static const struct { Format format; const char* name; } formats[] = {
+        {stl_ascii, "stl ascii"},
+        {stl_binary, "stl binary"},
+        {obj, "obj"},
+        {obj_ostream, "obj, using ostream <<"},
+        {x3d, "x3d, vertex colours"},
+    };
+    for (auto& f : formats) {
+        Counting_Buf buf;
+        std::ostream out(&buf);
+        Bench_Timer t;
+        switch (f.format) {
+        case stl_ascii: geom::write_stl(mesh, false, out); break;
+        case stl_binary: geom::write_stl(mesh, true, out); break;
+        case obj: geom::write_obj(mesh, out); break;
+        case obj_ostream: write_obj_ostream(mesh, out); break;
+        case x3d:
+            geom::write_x3d(mesh, cshape, geom::Mesh_Colouring::vertex, out);
+            break;
+        }
+        double secs = t.elapsed();
+        report("mesh_write", f.name, ntri, "triangles", secs);
+        report("mesh_write", f.name, buf.count_ / 1e6, "MB", secs);
+    }
+}
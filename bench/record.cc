@@ -0,0 +1,58 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/program.h>
+#include <libcurv/record.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+
+using namespace curv;
+
+// Field lookup in records, which is dominated by symbol comparison.
+BENCHMARK(record_access)
+{
+    const int n = 10000000;
+    Program prog{make<String_Source>("",
+        "{dist: 1, colour: 2, bbox: 3, is_2d: 4, is_3d: 5}"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    auto rec = val.to<Record>(At_Program(prog));
+    Symbol_Ref names[] = {
+        make_symbol("dist"), make_symbol("colour"), make_symbol("bbox"),
+        make_symbol("is_2d"), make_symbol("is_3d")
+    };
+    At_Program cx(prog);
+    double sum = 0.0;
+    Bench_Timer t1;
+    for (int i = 0; i < n; ++i)
+        sum += rec->getfield(names[i % 5], cx).to_num_or_nan();
+    report("record_access", "shape record", n, "lookups", t1.elapsed());
+
+    // Field references in Curv code: `s` is a shape, which is a module.
+    Program prog2{make<String_Source>("",
+        "let s = cube 1; in sum(map (i -> s.bbox[1][0] + (if (s.is_3d) 1 else 0)) (0..<100000))"),
+        bench_system()};
+    prog2.compile();
+    Bench_Timer t2;
+    prog2.eval();
+    report("record_access", "dot expression", 2e5, "lookups", t2.elapsed());
+
+    Program prog3{make<String_Source>("", "cube 1"), bench_system()};
+    prog3.compile();
+    Value shape_val = prog3.eval();
+    Bench_Timer t3;
+    for (int i = 0; i < n/10; ++i) {
+        Shape_Program shape(prog3);
+        if (!shape.recognize(shape_val, nullptr))
+            throw Exception(At_Program(prog3), "not a shape");
+    }
+    report("record_access", "shape recognition", n/10, "shapes", t3.elapsed());
+    if (sum != n/5*15)
+        throw Exception(At_Program(prog), "wrong sum");
+}
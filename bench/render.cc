@@ -0,0 +1,169 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/geom/compiled_shape.h>
+#include <libcurv/geom/cpu_render.h>
+#include <libcurv/geom/png.h>
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/filesystem.h>
+#include <libcurv/format.h>
+#include <libcurv/output_file.h>
+#include <libcurv/program.h>
+#include <libcurv/source.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace curv;
+
+// The CPU renderer used by `curv -o png -O renderer=#cpu`, using 1 thread
+// and then all cores.
+BENCHMARK(cpu_render)
+{
+    static const struct { const char* name; const char* src; } shapes[] = {
+        {"2D", "union[circle 2, square 2 >> colour red >> move(1.5,0)]"},
+        {"3D", "union[sphere 2, cube 2 >> colour red >> move(1.5,0,0)]"},
+    };
+    const glm::ivec2 size{256, 256};
+    const double npixels = double(size.x) * double(size.y);
+    unsigned ncores = std::thread::hardware_concurrency();
+    if (ncores == 0) ncores = 1;
+
+    for (auto& s : shapes) {
+        Program prog{make<String_Source>("", s.src), bench_system()};
+        prog.compile();
+        Value val = prog.eval();
+        Shape_Program shape(prog);
+        if (!shape.recognize(val, nullptr))
+            throw Exception(At_Program(prog), "not a shape");
+        geom::Compiled_Shape cshape(shape, geom::Jit_Backend::vm);
+        Render_Opts opts;
+        std::vector<unsigned char> pixels(size.x * size.y * 4);
+
+        for (unsigned nthreads = 1; ; nthreads = ncores) {
+            Bench_Timer t;
+            geom::cpu_render(cshape, opts, size, 0.0, nthreads, pixels.data());
+            report("cpu_render",
+                stringify(s.name,", threads=",nthreads)->c_str(),
+                npixels, "pixels", t.elapsed());
+            if (nthreads == ncores) break;
+        }
+    }
+}
+
+// The 2D pixel loop of the viewer's fragment shader, for a shape that
+// covers little of its bounding box. Most pixels are background, where the
+// shader only needs dist. Calling the fused dist_colour function on every
+// pixel computes a colour that is thrown away.
+BENCHMARK(render_2d)
+{
+    Program prog{make<String_Source>("",
+        "union[for (i in 0..<8)"
+        "  circle 0.6 >> move(4*cos(i*0.8), 4*sin(i*0.8))"
+        "    >> colour (sRGB.hue(i/8))]"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+    geom::Compiled_Shape cshape(shape, geom::Jit_Backend::vm, true);
+
+    const int size = 512;
+    const double npixels = double(size) * double(size);
+    const BBox& b = cshape.bbox_;
+    auto px = [&](int i) { return b.xmin + (b.xmax-b.xmin)*(i+0.5)/size; };
+    auto py = [&](int j) { return b.ymin + (b.ymax-b.ymin)*(j+0.5)/size; };
+
+    long nbg = 0;
+    double sum1 = 0.0;
+    Bench_Timer t1;
+    for (int j = 0; j < size; ++j) {
+        for (int i = 0; i < size; ++i) {
+            double d = cshape.dist(px(i), py(j), 0.0, 0.0);
+            if (d > 0.0) {
+                ++nbg;
+                continue;
+            }
+            Vec3 c = cshape.colour(px(i), py(j), 0.0, 0.0);
+            sum1 += c.x + c.y + c.z;
+        }
+    }
+    report("render_2d",
+        stringify("dist, then colour if inside (",
+            int(100.0*nbg/npixels), "% background)")->c_str(),
+        npixels, "pixels", t1.elapsed());
+
+    double sum2 = 0.0;
+    Bench_Timer t2;
+    for (int j = 0; j < size; ++j) {
+        for (int i = 0; i < size; ++i) {
+            Vec3 c;
+            double d = cshape.dist_colour(px(i), py(j), 0.0, 0.0, c);
+            if (d <= 0.0)
+                sum2 += c.x + c.y + c.z;
+        }
+    }
+    report("render_2d", "dist_colour", npixels, "pixels", t2.elapsed());
+
+    if (std::abs(sum1 - sum2) > 1e-3 * std::abs(sum1))
+        throw Exception(At_Program(prog), "render_2d: results differ");
+}
+
+// Exporting an animation using the CPU renderer: one frame at a time, each
+// frame using all cores (which is how export_png is called for each frame),
+// versus export_png_frames, which renders frames concurrently.
+BENCHMARK(png_frames)
+{
+    namespace fs = Filesystem;
+    const unsigned nframes = 50;
+    Program prog{make<String_Source>("",
+        "union[cube 2 >> colour red, make_shape {\n"
+        "  dist(x,y,z,t): mag(x - 2*sin t, y, z) - 1,\n"
+        "  bbox: [[-3,-1,-1],[3,1,1]], is_3d: true,\n"
+        "}]"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+
+    geom::Image_Export ix;
+    ix.size = glm::ivec2{128, 128};
+    ix.aa_ = 1;
+    ix.renderer_ = geom::Image_Export::Renderer::cpu;
+    ix.jit_ = geom::Jit_Backend::vm;
+    ix.threads_ = std::thread::hardware_concurrency();
+    if (ix.threads_ == 0) ix.threads_ = 1;
+
+    fs::path dir = fs::temp_directory_path()
+        / fs::unique_path(",curv-png-frames-%%%%%%%%");
+    fs::create_directory(dir);
+    std::vector<fs::path> paths;
+    for (unsigned i = 0; i < nframes; ++i)
+        paths.push_back(dir / fs::path(stringify(i,".png")->c_str()));
+
+    Bench_Timer t1;
+    double fstart = ix.fstart_;
+    for (unsigned i = 0; i < nframes; ++i) {
+        ix.fstart_ = fstart + i * ix.fdur_;
+        Output_File ofile{bench_system()};
+        ofile.set_path(paths[i]);
+        geom::export_png(shape, ix, ofile);
+        ofile.commit();
+    }
+    ix.fstart_ = fstart;
+    report("png_frames", "export_png per frame", nframes, "frames",
+        t1.elapsed());
+
+    Bench_Timer t2;
+    geom::export_png_frames(shape, ix, paths);
+    report("png_frames", "export_png_frames", nframes, "frames",
+        t2.elapsed());
+    fs::remove_all(dir);
+}
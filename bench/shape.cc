@@ -0,0 +1,291 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/geom/compiled_shape.h>
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/function.h>
+#include <libcurv/program.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace curv;
+
+// Sample the interpreted `dist` function of a shape over a grid of points.
+static void
+sample_dist(const char* name, const char* shape_src)
+{
+    const int n = 40;
+    Program prog{make<String_Source>("", shape_src), bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+
+    // The old implementation of Shape_Program::dist, which allocates
+    // a new point list for every sample.
+    double sum1 = 0.0;
+    Bench_Timer t1;
+    for (int x = 0; x < n; ++x) {
+        for (int y = 0; y < n; ++y) {
+            for (int z = 0; z < n; ++z) {
+                Shared<List> point = List::make(
+                    {Value{x*0.1}, Value{y*0.1}, Value{z*0.1}, Value{0.0}});
+                Value result = shape.dist_fun_->call({point}, *shape.dist_frame_);
+                sum1 += result.to_num(At_Program(prog));
+            }
+        }
+    }
+    report(name, "new point per sample", n*n*n, "samples", t1.elapsed());
+
+    double sum2 = 0.0;
+    Bench_Timer t2;
+    for (int x = 0; x < n; ++x) {
+        for (int y = 0; y < n; ++y) {
+            for (int z = 0; z < n; ++z)
+                sum2 += shape.dist(x*0.1, y*0.1, z*0.1, 0.0);
+        }
+    }
+    report(name, "Shape_Program::dist", n*n*n, "samples", t2.elapsed());
+
+    if (sum1 != sum2)
+        throw Exception(At_Program(prog), "results differ");
+}
+
+BENCHMARK(shape_dist)
+{
+    // A primitive: the cost of the call overhead dominates.
+    sample_dist("shape_dist sphere", "sphere 1");
+    // A CSG tree, with the common case of nested `dist p` calls.
+    sample_dist("shape_dist union",
+        "union[cube 1, sphere 1.2 >> move(0.5,0,0), torus{major:2,minor:0.5}]");
+}
+
+// Compare the per-point and batched entry points of a JIT compiled shape.
+BENCHMARK(jit_dist)
+{
+    const unsigned n = 64*64*64;
+    Program prog{make<String_Source>("",
+        "union[cube 1, sphere 1.2 >> move(0.5,0,0), torus{major:2,minor:0.5}]"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+    geom::Compiled_Shape cshape(shape);
+
+    std::vector<float> x(n), y(n), z(n), t(n, 0.0f), d1(n), d2(n);
+    for (unsigned i = 0; i < n; ++i) {
+        x[i] = (i % 64) * 0.1f - 3.2f;
+        y[i] = (i / 64 % 64) * 0.1f - 3.2f;
+        z[i] = (i / 4096) * 0.1f - 3.2f;
+    }
+
+    Bench_Timer t1;
+    for (unsigned i = 0; i < n; ++i)
+        d1[i] = cshape.dist(x[i], y[i], z[i], t[i]);
+    report("jit_dist", "Compiled_Shape::dist", n, "samples", t1.elapsed());
+
+    Bench_Timer t2;
+    cshape.dist_batch(n, x.data(), y.data(), z.data(), t.data(), d2.data());
+    report("jit_dist", "Compiled_Shape::dist_batch", n, "samples",
+        t2.elapsed());
+
+    // The results may differ in the last bits, since the compiler is free
+    // to contract a*b+c into a fused multiply-add in one version only.
+    for (unsigned i = 0; i < n; ++i) {
+        if (std::abs(d1[i] - d2[i]) > 1e-4f)
+            throw Exception(At_Program(prog), "jit_dist: results differ");
+    }
+}
+
+// Compare compile latency and evaluation speed of the JIT backends.
+BENCHMARK(jit_backend)
+{
+    const unsigned n = 64*64*64;
+    Program prog{make<String_Source>("",
+        "union[cube 1, sphere 1.2 >> move(0.5,0,0), torus{major:2,minor:0.5}]"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+
+    std::vector<float> x(n), y(n), z(n), t(n, 0.0f), d(n);
+    for (unsigned i = 0; i < n; ++i) {
+        x[i] = (i % 64) * 0.1f - 3.2f;
+        y[i] = (i / 64 % 64) * 0.1f - 3.2f;
+        z[i] = (i / 4096) * 0.1f - 3.2f;
+    }
+
+    // Measure the cost of running the C++ compiler, not of a cache hit.
+    setenv("CURV_CACHE_DIR", "", 1);
+    static const struct { const char* name; geom::Jit_Backend backend; }
+    backends[] = {
+        {"cpp", geom::Jit_Backend::cpp},
+        {"vm", geom::Jit_Backend::vm},
+    };
+    for (auto& b : backends) {
+        Bench_Timer t1;
+        geom::Compiled_Shape cshape(shape, b.backend);
+        report("jit_backend", stringify(b.name," compile")->c_str(),
+            1, "shapes", t1.elapsed());
+
+        Bench_Timer t2;
+        cshape.dist_batch(n, x.data(), y.data(), z.data(), t.data(), d.data());
+        report("jit_backend", stringify(b.name," dist_batch")->c_str(),
+            n, "samples", t2.elapsed());
+    }
+}
+
+// A shape whose distance function uses a conditional to skip an expensive
+// computation for most points: the bounding sphere test of a union of 16
+// spheres. Only the taken arm of `if` should be evaluated.
+BENCHMARK(sc_branch)
+{
+    const unsigned n = 64*64*64;
+    Program prog{make<String_Source>("",
+        "let s = union[for (i in 0..<16)"
+        "      sphere 0.3 >> move(2*cos(i*0.4), 2*sin(i*0.4), 0)];\n"
+        "in make_shape {\n"
+        "  dist p: let b = mag[p[X],p[Y],p[Z]] - 2.5;\n"
+        "          in if (b > 0.5 || p[Z] > 1) b else s.dist p,\n"
+        "  bbox: s.bbox, is_3d: true,\n"
+        "}"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+
+    std::vector<float> x(n), y(n), z(n), t(n, 0.0f), d(n);
+    for (unsigned i = 0; i < n; ++i) {
+        x[i] = (i % 64) * 0.1f - 3.2f;
+        y[i] = (i / 64 % 64) * 0.1f - 3.2f;
+        z[i] = (i / 4096) * 0.1f - 3.2f;
+    }
+
+    geom::Compiled_Shape cshape(shape, geom::Jit_Backend::vm);
+    std::cout << "sc_branch: vm code size: "
+        << cshape.vm_dist_->code_.size() << " instrs\n";
+    Bench_Timer t1;
+    cshape.dist_batch(n, x.data(), y.data(), z.data(), t.data(), d.data());
+    report("sc_branch", "vm dist_batch", n, "samples", t1.elapsed());
+
+    for (unsigned i = 0; i < n; i += 97) {
+        double d0 = shape.dist(x[i], y[i], z[i], t[i]);
+        if (std::abs(d0 - d[i]) > 1e-4)
+            throw Exception(At_Program(prog), "sc_branch: results differ");
+    }
+}
+
+// Evaluate the dist and colour of a coloured CSG tree, using separate
+// functions and using the fused dist_colour function.
+BENCHMARK(dist_colour)
+{
+    const int n = 200000;
+    Program prog{make<String_Source>("",
+        "union[for (i in 0..<8)"
+        "  sphere 0.6 >> move(cos(i*0.8), sin(i*0.8), 0)"
+        "    >> colour (sRGB.hue(i/8))]"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+    geom::Compiled_Shape cshape(shape, geom::Jit_Backend::vm, true);
+    std::cout << "dist_colour: vm code size: dist "
+        << cshape.vm_dist_->code_.size() << ", colour "
+        << cshape.vm_colour_->code_.size() << ", dist_colour "
+        << cshape.vm_dist_colour_->code_.size() << " instrs\n";
+
+    double sum1 = 0.0;
+    Bench_Timer t1;
+    for (int i = 0; i < n; ++i) {
+        double x = (i % 100) * 0.03 - 1.5, y = (i / 100 % 100) * 0.03 - 1.5;
+        Vec3 c = cshape.colour(x, y, 0.0, 0.0);
+        sum1 += cshape.dist(x, y, 0.0, 0.0) + c.x + c.y + c.z;
+    }
+    report("dist_colour", "dist + colour", n, "samples", t1.elapsed());
+
+    double sum2 = 0.0;
+    Bench_Timer t2;
+    for (int i = 0; i < n; ++i) {
+        double x = (i % 100) * 0.03 - 1.5, y = (i / 100 % 100) * 0.03 - 1.5;
+        Vec3 c;
+        sum2 += cshape.dist_colour(x, y, 0.0, 0.0, c) + c.x + c.y + c.z;
+    }
+    report("dist_colour", "dist_colour", n, "samples", t2.elapsed());
+
+    if (std::abs(sum1 - sum2) > 1e-3 * std::abs(sum1))
+        throw Exception(At_Program(prog), "dist_colour: results differ");
+}
+
+// A union of N small spheres on a grid, using the BVH accelerated union
+// and the linear chain of _union2, evaluated by the interpreter and by the
+// VM. The distance functions agree, since sphere distances are exact.
+BENCHMARK(union_bvh)
+{
+    for (int n : {64, 256, 1024}) {
+        auto src = stringify(
+            "let g = [for (i in 0..<",n,")"
+            "    sphere 0.4 >> move(mod(i,32), floor(i/32), 0)];\n"
+            "in [_union_bvh g, reduce(nothing, _union2) g]");
+        Program prog{make<String_Source>("", src), bench_system()};
+        prog.compile();
+        auto shapes = prog.eval().to<List>(At_Program(prog));
+        Shape_Program bvh(prog), chain(prog);
+        if (!bvh.recognize(shapes->at(0), nullptr)
+            || !chain.recognize(shapes->at(1), nullptr))
+        {
+            throw Exception(At_Program(prog), "not a shape");
+        }
+        const int samples = 2000;
+        double sum1 = 0.0, sum2 = 0.0;
+        Bench_Timer t1;
+        for (int i = 0; i < samples; ++i)
+            sum1 += bvh.dist(i % 37 - 2.5, i % 11 - 2.5, 0.5, 0.0);
+        report("union_bvh", stringify("interp bvh N=",n)->c_str(),
+            samples, "samples", t1.elapsed());
+        Bench_Timer t2;
+        for (int i = 0; i < samples; ++i)
+            sum2 += chain.dist(i % 37 - 2.5, i % 11 - 2.5, 0.5, 0.0);
+        report("union_bvh", stringify("interp chain N=",n)->c_str(),
+            samples, "samples", t2.elapsed());
+        if (std::abs(sum1 - sum2) > 1e-6 * std::abs(sum2))
+            throw Exception(At_Program(prog), "union_bvh: results differ");
+
+        geom::Compiled_Shape cbvh(bvh, geom::Jit_Backend::vm);
+        geom::Compiled_Shape cchain(chain, geom::Jit_Backend::vm);
+        const unsigned m = 20000;
+        std::vector<float> x(m), y(m), z(m, 0.5f), t(m, 0.0f), d1(m), d2(m);
+        for (unsigned i = 0; i < m; ++i) {
+            x[i] = (i % 200) * 0.2f - 4.0f;
+            y[i] = (i / 200 % 100) * 0.25f - 4.0f;
+        }
+        Bench_Timer t3;
+        cbvh.dist_batch(m, x.data(), y.data(), z.data(), t.data(), d1.data());
+        report("union_bvh", stringify("vm bvh N=",n)->c_str(),
+            m, "samples", t3.elapsed());
+        Bench_Timer t4;
+        cchain.dist_batch(m, x.data(), y.data(), z.data(), t.data(), d2.data());
+        report("union_bvh", stringify("vm chain N=",n)->c_str(),
+            m, "samples", t4.elapsed());
+        for (unsigned i = 0; i < m; ++i) {
+            if (std::abs(d1[i] - d2[i]) > 1e-4f)
+                throw Exception(At_Program(prog), "union_bvh: results differ");
+        }
+    }
+}
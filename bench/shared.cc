@@ -0,0 +1,86 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/program.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace curv;
+
+// Sample the interpreted dist function of `shape` at n points, starting
+// with point number `first`, and return the sum of the distances.
+static double
+sample(Shape_Program& shape, int first, int n)
+{
+    double sum = 0.0;
+    for (int i = first; i < first + n; ++i)
+        sum += shape.dist(i % 40 * 0.1, i / 40 % 40 * 0.1, i / 1600 * 0.1, 0.0);
+    return sum;
+}
+
+// The cost of atomic reference counting in the interpreter: sample dist
+// using one thread, outside and inside of a Thread_Shared_Scope, then using
+// several threads, each with its own copy of the Shape_Program.
+BENCHMARK(thread_shared)
+{
+    const int n = 64000;
+    Program prog{make<String_Source>("",
+        "union[cube 1, sphere 1.2 >> move(0.5,0,0), torus{major:2,minor:0.5}]"),
+        bench_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    if (!shape.recognize(val, nullptr))
+        throw Exception(At_Program(prog), "not a shape");
+
+    Bench_Timer t1;
+    double sum1 = sample(shape, 0, n);
+    report("thread_shared", "1 thread, non-atomic", n, "samples",
+        t1.elapsed());
+
+    double sum2;
+    {
+        Thread_Shared_Scope scope;
+        Bench_Timer t2;
+        sum2 = sample(shape, 0, n);
+        report("thread_shared", "1 thread, atomic", n, "samples",
+            t2.elapsed());
+    }
+    if (sum1 != sum2)
+        throw Exception(At_Program(prog), "thread_shared: results differ");
+
+    unsigned nthreads = std::thread::hardware_concurrency();
+    if (nthreads < 2) return;
+    std::vector<double> sums(nthreads);
+    {
+        Thread_Shared_Scope scope;
+        Bench_Timer t3;
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < nthreads; ++i) {
+            threads.emplace_back([&,i]() -> void {
+                Shape_Program copy(shape);
+                int first = n * i / nthreads;
+                int last = n * (i+1) / nthreads;
+                sums[i] = sample(copy, first, last - first);
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        report("thread_shared",
+            stringify(nthreads," threads, atomic")->c_str(),
+            n, "samples", t3.elapsed());
+    }
+    double sum3 = 0.0;
+    for (double s : sums)
+        sum3 += s;
+    if (std::abs(sum1 - sum3) > 1e-9 * std::abs(sum1))
+        throw Exception(At_Program(prog), "thread_shared: results differ");
+}
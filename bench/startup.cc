@@ -0,0 +1,43 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include "bench.h"
+
+#include <libcurv/geom/builtin.h>
+#include <libcurv/context.h>
+#include <libcurv/program.h>
+#include <libcurv/source.h>
+#include <iostream>
+
+using namespace curv;
+
+// The cost of constructing a System and loading the standard library.
+BENCHMARK(startup)
+{
+    const char* std_path = "../lib/curv/std.curv";
+    const int n = 20;
+
+    // What load_library does without a snapshot: read, compile and
+    // evaluate std.curv.
+    System_Impl sys(std::cerr);
+    geom::add_builtins(sys);
+    Bench_Timer t1;
+    for (int i = 0; i < n; ++i) {
+        auto file = make<File_Source>(make_string(std_path), At_System{sys});
+        Program prog{std::move(file), sys};
+        prog.compile();
+        prog.eval();
+    }
+    report("startup", "compile std", n, "loads", t1.elapsed());
+
+    // The first call to load_library in this process makes a snapshot,
+    // unless an earlier benchmark already loaded std.
+    Bench_Timer t2;
+    for (int i = 0; i < n; ++i) {
+        System_Impl sys2(std::cerr);
+        geom::add_builtins(sys2);
+        sys2.load_library(make_string(std_path));
+    }
+    report("startup", "load std snapshot", n, "loads", t2.elapsed());
+}
@@ -35,10 +35,13 @@ extern "C" {
 namespace fs = curv::Filesystem;
 
 curv::System&
-make_system(const char* argv0, std::list<const char*>& libs, std::ostream& out)
+make_system(
+    const char* argv0, std::list<const char*>& libs, bool bytecode,
+    std::ostream& out)
 {
     static curv::System_Impl sys(out);
     if (isatty(2)) sys.use_colour_ = true;
+    sys.use_bytecode_ = bytecode;
     try {
         curv::geom::add_builtins(sys);
         curv::geom::add_importers(sys);
@@ -90,6 +93,10 @@ const char help_infix[] =
 "   -x : Interpret filename argument as expression.\n"
 "general options:\n"
 "   -v : Verbose & debug output.\n"
+"   --bytecode : Evaluate functions using the experimental bytecode\n"
+"      interpreter. It is not yet faster than the default interpreter.\n"
+"   --eval-threads=N : Evaluate independent top-level definitions and\n"
+"      imports using up to N threads (default 1).\n"
 "   -O name=value : Set parameter controlling the specified output format.\n"
 "      If '-o fmt' is specified, use 'curv --help -o fmt' for help.\n"
 "      If '-o fmt' is not specified, the following parameters are available:\n"
@@ -119,12 +126,18 @@ main(int argc, char** argv)
     const char* editor = nullptr;
     bool help = false;
     bool version = false;
+    bool bytecode = false;
+    unsigned eval_threads = 1;
 
     constexpr int HELP = 1000;
     constexpr int VERSION = 1001;
+    constexpr int BYTECODE = 1002;
+    constexpr int EVAL_THREADS = 1003;
     static struct option longopts[] = {
         {"help",    no_argument, nullptr, HELP },
         {"version", no_argument, nullptr, VERSION },
+        {"bytecode", no_argument, nullptr, BYTECODE },
+        {"eval-threads", required_argument, nullptr, EVAL_THREADS },
         {nullptr,   0,           nullptr, 0 }
     };
 
@@ -138,6 +151,22 @@ main(int argc, char** argv)
         case VERSION:
             version = true;
             break;
+        case BYTECODE:
+            bytecode = true;
+            break;
+        case EVAL_THREADS:
+          {
+            char* end;
+            long n = strtol(optarg, &end, 10);
+            if (*end != '\0' || n < 1 || n > 1024) {
+                std::cerr << "--eval-threads: argument must be a number"
+                             " from 1 to 1024\n"
+                          << "Use " << argv0 << " --help for help.\n";
+                return EXIT_FAILURE;
+            }
+            eval_threads = unsigned(n);
+            break;
+          }
         case 'o':
           {
             const char* oarg = optarg;
@@ -266,7 +295,8 @@ main(int argc, char** argv)
     // Create system, a precondition for parsing -O parameters.
     // This can fail, so we do as much argument validation as possible
     // before this point.
-    curv::System& sys(make_system(usestdlib, libs, std::cerr));
+    curv::System& sys(make_system(usestdlib, libs, bytecode, std::cerr));
+    sys.eval_threads_ = eval_threads;
     atexit(curv::geom::remove_all_tempfiles);
 
     try {
@@ -303,6 +333,10 @@ main(int argc, char** argv)
         curv::Program prog{std::move(source), sys};
         prog.compile();
         auto value = prog.eval();
+        if (verbose && sys.import_hits_ + sys.import_misses_ > 0) {
+            std::cerr << "import cache: " << sys.import_hits_ << " hits, "
+                << sys.import_misses_ << " misses\n";
+        }
 
         if (exporter != exporters.end()) {
             curv::Output_File ofile{sys};
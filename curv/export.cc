@@ -30,6 +30,7 @@
 #include <cstring>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 using namespace curv;
 
@@ -261,20 +262,14 @@ void export_all_png(
     unsigned count = unsigned(animate / ix.fdur_ + 0.5);
     if (count == 0) count = 1;
     unsigned digs = ndigits(count);
-    double fstart = ix.fstart_;
+    std::vector<Filesystem::path> paths;
     for (unsigned i = 0; i < count; ++i) {
-        ix.fstart_ = fstart + i * ix.fdur_;
         char num[12];
         snprintf(num, sizeof(num), "%0*d", digs, i);
         auto opath = stringify(prefix, num, suffix);
-        Output_File oofile{shape.system_};
-        oofile.set_path(opath->c_str());
-        geom::export_png(shape, ix, oofile);
-        oofile.commit();
-        //std::cerr << ".";
-        //std::cerr.flush();
+        paths.push_back(opath->c_str());
     }
-    //std::cerr << "done\n";
+    geom::export_png_frames(shape, ix, paths);
 }
 
 void describe_png_opts(std::ostream& out)
@@ -283,7 +278,12 @@ void describe_png_opts(std::ostream& out)
     "-v : verbose output logged to stderr\n"
     "-O xsize=<image width in pixels>\n"
     "-O ysize=<image height in pixels>\n"
-    "-O fstart=<animation frame start time, in seconds> (default 0)\n";
+    "-O fstart=<animation frame start time, in seconds> (default 0)\n"
+    "-O renderer=#gpu|#cpu : #cpu renders without a GPU, using a JIT compiled\n"
+    "   shape (default #gpu).\n"
+    "-O jit=#cpp|#vm : JIT backend used by -O renderer=#cpu (default #cpp).\n"
+    "-O threads=<number of threads> : Used by -O renderer=#cpu, and to encode\n"
+    "   animation frames (default: all cores).\n";
     describe_render_opts(out);
     out <<
     "-O animate=<duration of animation> (exports an image sequence)\n";
@@ -299,6 +299,8 @@ void export_png(Value value,
     int xsize = 0;
     int ysize = 0;
     double animate = 0.0;
+    ix.threads_ = std::thread::hardware_concurrency();
+    if (ix.threads_ == 0) ix.threads_ = 1;
     for (auto& i : params.map_) {
         Param p{params, i};
         if (parse_render_param(p, ix)) {
@@ -311,6 +313,13 @@ void export_png(Value value,
             ix.fstart_ = p.to_double();
         } else if (p.name_ == "animate") {
             animate = p.to_double();
+        } else if (p.name_ == "renderer") {
+            ix.renderer_ = geom::Image_Export::Renderer(
+                p.to_enum({"gpu", "cpu"}));
+        } else if (p.name_ == "jit") {
+            ix.jit_ = geom::Jit_Backend(p.to_enum({"cpp", "vm"}));
+        } else if (p.name_ == "threads") {
+            ix.threads_ = p.to_int(1, INT_MAX);
         } else {
             p.unknown_parameter();
         }
@@ -388,7 +397,7 @@ void describe_no_opts(std::ostream&) {}
 
 std::map<std::string, Exporter> exporters = {
     {"curv", {export_curv, "Curv expression", describe_no_opts}},
-    {"stl", {export_stl, "STL mesh file (3D shape only)", describe_mesh_opts}},
+    {"stl", {export_stl, "STL mesh file (3D shape only)", describe_stl_opts}},
     {"obj", {export_obj, "OBJ mesh file (3D shape only)", describe_mesh_opts}},
     {"x3d", {export_x3d, "X3D colour mesh file (3D shape only)",
              describe_colour_mesh_opts}},
@@ -134,6 +134,7 @@ extern void export_png(curv::Value value,
     curv::Output_File&);
 
 void describe_mesh_opts(std::ostream&);
+void describe_stl_opts(std::ostream&);
 void describe_colour_mesh_opts(std::ostream&);
 
 void parse_viewer_config(
@@ -2,16 +2,28 @@
 // Licensed under the Apache License, version 2.0
 // See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <openvdb/openvdb.h>
+#include <openvdb/tools/SignedFloodFill.h>
 #include <openvdb/tools/VolumeToMesh.h>
 #include <glm/geometric.hpp>
 
 #include "export.h"
 #include <libcurv/geom/compiled_shape.h>
+#include <libcurv/geom/mesh.h>
 #include <libcurv/shape.h>
 #include <libcurv/exception.h>
 #include <libcurv/context.h>
@@ -59,40 +71,6 @@ void export_x3d(curv::Value value,
     export_mesh(x3d_format, value, prog, params, ofile.ostream());
 }
 
-void put_triangle(std::ostream& out, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
-{
-    glm::vec3 n = glm::normalize(glm::cross(v1 - v0, v2 - v0));
-    out << "facet normal " << n.x << " " << n.y << " " << n.z << "\n"
-        << " outer loop\n"
-        << "  vertex " << v0.x << " " << v0.y << " " << v0.z << "\n"
-        << "  vertex " << v1.x << " " << v1.y << " " << v1.z << "\n"
-        << "  vertex " << v2.x << " " << v2.y << " " << v2.z << "\n"
-        << " endloop\n"
-        << "endfacet\n";
-}
-
-curv::Vec3 linear_RGB_to_sRGB(curv::Vec3 c)
-{
-    constexpr double k = 0.4545;
-    return curv::Vec3{pow(c.x, k), pow(c.y, k), pow(c.z, k)};
-}
-
-void put_face_colour(std::ostream& out, curv::Shape& shape,
-    Vec3s v0, Vec3s v1, Vec3s v2)
-{
-    Vec3s centroid = (v0 + v1 + v2) / 3.0;
-    curv::Vec3 c = shape.colour(centroid.x(), centroid.y(), centroid.z(), 0.0);
-    c = linear_RGB_to_sRGB(c);
-    out << " " << c.x << " " << c.y << " " << c.z;
-}
-
-void put_vertex_colour(std::ostream& out, curv::Shape& shape, Vec3s v)
-{
-    curv::Vec3 c = shape.colour(v.x(), v.y(), v.z(), 0.0);
-    c = linear_RGB_to_sRGB(c);
-    out << " " << c.x << " " << c.y << " " << c.z;
-}
-
 inline glm::vec3 V3(Vec3s v)
 {
     return glm::vec3{v.x(), v.y(), v.z()};
@@ -102,8 +80,26 @@ void describe_mesh_opts(std::ostream& out)
 {
     out <<
     "-O jit : Fast evaluation using JIT compiler (uses C++ compiler).\n"
+    "-O jit=#vm : JIT compile in-process, without a C++ compiler.\n"
+    "   Compiles faster, but evaluates slower than -O jit.\n"
+    "-O threads=<number of threads> : Used with -O jit (default: all cores).\n"
+    "   Without -O jit, dist is interpreted using 1 thread, unless -O threads\n"
+    "   is specified.\n"
+    "-O lipschitz=<k> : Lipschitz constant of dist, used to skip empty space\n"
+    "   (default 1). Use -O lipschitz=inf if dist is not Lipschitz continuous.\n"
     "-O vsize=<voxel size>\n"
     "-O adaptive=<0...1> : Deprecated. Use meshlab to simplify mesh.\n"
+    "-O tile=<N> : Mesh the shape in tiles of N×N×N voxels, writing each\n"
+    "   tile as it is meshed, so that memory use is bounded by the tile size.\n"
+    "   For very large meshes. STL and OBJ only; try -O tile=256.\n"
+    ;
+}
+void describe_stl_opts(std::ostream& out)
+{
+    describe_mesh_opts(out);
+    out <<
+    "-O binary : Write a binary STL file, which is much smaller and faster\n"
+    "   to write and read than the default ASCII STL file.\n"
     ;
 }
 void describe_colour_mesh_opts(std::ostream& out)
@@ -114,6 +110,469 @@ void describe_colour_mesh_opts(std::ostream& out)
     ;
 }
 
+// Populate a grid with the distance field of a shape.
+//
+// VolumeToMesh only needs distance values in a narrow band around the
+// surface, so we don't evaluate dist at every voxel. The voxel range is
+// divided into blocks matching the OpenVDB leaf nodes, and each block is
+// recursively subdivided into octants. We evaluate dist at the centre of a
+// block. If the distance function has Lipschitz constant L, and the block
+// has radius R, then the block is skipped if |dist| > L*R + band, since no
+// voxel in the block can be within the band. Skipped voxels are left
+// inactive, and a signed flood fill assigns them the background distance
+// (with the correct sign) once sampling is finished.
+//
+// The blocks are grouped into slabs along the X axis, and nthreads worker
+// threads claim slabs one at a time. Each thread writes into a private tree
+// using its own accessor, and the trees are merged into the grid at the end.
+// Since the slabs are leaf aligned, no two trees populate the same leaf node.
+// A Compiled_Shape is thread safe. A Shape_Program is not, so each thread
+// samples its own copy, within a Thread_Shared_Scope.
+//
+// If shell_ > 0, then voxels within shell_ voxels of the edge of the range
+// are always evaluated. Tiled meshing uses this so that every skipped block
+// is enclosed by evaluated voxels, even where a tile cuts through the
+// shape, which lets the flood fill determine its sign.
+struct Voxel_Sampler
+{
+    using Tree = openvdb::FloatTree;
+    static constexpr int block_size = Tree::LeafNodeType::DIM;
+    struct Worker;
+
+    curv::Shape& shape_;
+    Vec3i vmin_, vmax_; // range of voxel coordinates
+    double voxelsize_;
+    double lipschitz_;
+    double band_;
+    int shell_ = 0;
+    unsigned nthreads_ = 1; // number of threads used by the last sample()
+
+    Voxel_Sampler(curv::Shape& shape, Vec3i vmin, Vec3i vmax,
+        double voxelsize, double lipschitz)
+    :
+        shape_(shape), vmin_(vmin), vmax_(vmax),
+        voxelsize_(voxelsize), lipschitz_(lipschitz),
+        band_(2.0 * voxelsize)
+    {}
+
+    // Returns the number of points at which dist was evaluated.
+    // At most `nthreads` threads are used, and no more than one per slab.
+    long sample(openvdb::FloatGrid& grid, unsigned nthreads);
+
+    bool overlaps_range(Vec3i origin, int size) const
+    {
+        return origin.x() <= vmax_.x() && origin.x() + size > vmin_.x()
+            && origin.y() <= vmax_.y() && origin.y() + size > vmin_.y()
+            && origin.z() <= vmax_.z() && origin.z() + size > vmin_.z();
+    }
+    bool overlaps_shell(Vec3i origin, int size) const
+    {
+        return shell_ > 0 && (
+               origin.x() < vmin_.x() + shell_
+            || origin.y() < vmin_.y() + shell_
+            || origin.z() < vmin_.z() + shell_
+            || origin.x() + size > vmax_.x() + 1 - shell_
+            || origin.y() + size > vmax_.y() + 1 - shell_
+            || origin.z() + size > vmax_.z() + 1 - shell_);
+    }
+};
+
+// The state of one sampling thread. The blocks of a slab are processed
+// breadth first, one level of subdivision at a time, so that dist can be
+// evaluated in large batches using Shape::dist_batch, which is vectorized
+// for a Compiled_Shape.
+struct Voxel_Sampler::Worker
+{
+    static constexpr unsigned batch_size = 1024;
+
+    Voxel_Sampler& sampler_;
+    curv::Shape& shape_;
+    openvdb::tree::ValueAccessor<Tree> accessor_;
+    long nevals_ = 0;
+
+    // A batch of points at which to evaluate dist, as structure of arrays.
+    std::vector<float> x_, y_, z_, t_, dist_;
+    // If the batch contains voxel centres, these are the voxel coordinates.
+    std::vector<openvdb::Coord> voxels_;
+
+    Worker(Voxel_Sampler& sampler, curv::Shape& shape, Tree& tree)
+    :
+        sampler_(sampler), shape_(shape), accessor_(tree)
+    {}
+
+    void sample_slab(int x);
+    void sample_blocks(const std::vector<Vec3i>& blocks, int size);
+    void sample_voxels(const std::vector<Vec3i>& blocks, int size);
+
+    void add_point(double x, double y, double z)
+    {
+        x_.push_back(float(x));
+        y_.push_back(float(y));
+        z_.push_back(float(z));
+    }
+    void eval_batch()
+    {
+        unsigned n = unsigned(x_.size());
+        t_.resize(n, 0.0f);
+        dist_.resize(n);
+        if (n > 0) {
+            shape_.dist_batch(n,
+                x_.data(), y_.data(), z_.data(), t_.data(), dist_.data());
+        }
+        nevals_ += n;
+    }
+    void clear_batch()
+    {
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        voxels_.clear();
+    }
+    void store_voxels()
+    {
+        eval_batch();
+        for (unsigned i = 0; i < voxels_.size(); ++i)
+            accessor_.setValue(voxels_[i], dist_[i]);
+        clear_batch();
+    }
+};
+
+long Voxel_Sampler::sample(openvdb::FloatGrid& grid, unsigned nthreads)
+{
+    const int xorigin = vmin_.x() & ~(block_size - 1);
+    const int nslabs = (vmax_.x() - xorigin) / block_size + 1;
+    nthreads = std::max(1u, std::min(nthreads, unsigned(nslabs)));
+    nthreads_ = nthreads;
+
+    long nevals = 0;
+    if (nthreads == 1) {
+        Worker worker(*this, shape_, grid.tree());
+        for (int slab = 0; slab < nslabs; ++slab)
+            worker.sample_slab(xorigin + slab*block_size);
+        nevals = worker.nevals_;
+    } else {
+        auto prog = dynamic_cast<curv::Shape_Program*>(&shape_);
+        curv::Thread_Shared_Scope scope;
+        std::atomic<int> next_slab{0};
+        std::vector<Tree::Ptr> trees;
+        std::vector<long> counts(nthreads, 0);
+        std::vector<std::exception_ptr> errors(nthreads);
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < nthreads; ++i)
+            trees.push_back(Tree::Ptr(new Tree(grid.background())));
+        for (unsigned i = 0; i < nthreads; ++i) {
+            workers.emplace_back([&,i]() -> void {
+                try {
+                    std::unique_ptr<curv::Shape_Program> copy;
+                    if (prog != nullptr)
+                        copy.reset(new curv::Shape_Program(*prog));
+                    Worker worker(*this, copy ? *copy : shape_, *trees[i]);
+                    for (;;) {
+                        int slab = next_slab++;
+                        if (slab >= nslabs) break;
+                        worker.sample_slab(xorigin + slab*block_size);
+                    }
+                    counts[i] = worker.nevals_;
+                } catch (...) {
+                    // stop the other workers, and report the error
+                    next_slab = nslabs;
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        for (auto& e : errors) {
+            if (e) std::rethrow_exception(e);
+        }
+        for (unsigned i = 0; i < nthreads; ++i) {
+            grid.tree().merge(*trees[i]);
+            nevals += counts[i];
+        }
+    }
+    openvdb::tools::signedFloodFill(grid.tree());
+    return nevals;
+}
+
+void Voxel_Sampler::Worker::sample_slab(int x)
+{
+    const int yorigin = sampler_.vmin_.y() & ~(block_size - 1);
+    const int zorigin = sampler_.vmin_.z() & ~(block_size - 1);
+    std::vector<Vec3i> blocks;
+    for (int y = yorigin; y <= sampler_.vmax_.y(); y += block_size) {
+        for (int z = zorigin; z <= sampler_.vmax_.z(); z += block_size)
+            blocks.push_back(Vec3i(x,y,z));
+    }
+    sample_blocks(blocks, block_size);
+}
+
+void Voxel_Sampler::Worker::sample_blocks(
+    const std::vector<Vec3i>& blocks, int size)
+{
+    if (size <= 2 || std::isinf(sampler_.lipschitz_)) {
+        sample_voxels(blocks, size);
+        return;
+    }
+
+    // Evaluate dist at the block centres, then subdivide the blocks that
+    // may intersect the band.
+    const double vsize = sampler_.voxelsize_;
+    const double half = (size - 1) / 2.0;
+    for (auto& b : blocks)
+        add_point((b.x()+half)*vsize, (b.y()+half)*vsize, (b.z()+half)*vsize);
+    eval_batch();
+
+    const double radius = half * std::sqrt(3.0) * vsize;
+    const double limit = sampler_.lipschitz_ * radius + sampler_.band_;
+    const int h = size / 2;
+    std::vector<Vec3i> children;
+    for (unsigned i = 0; i < blocks.size(); ++i) {
+        if (std::abs(dist_[i]) > limit
+            && !sampler_.overlaps_shell(blocks[i], size))
+        {
+            continue;
+        }
+        for (int j = 0; j < 8; ++j) {
+            Vec3i child = blocks[i]
+                + Vec3i((j&1) ? h : 0, (j&2) ? h : 0, (j&4) ? h : 0);
+            if (sampler_.overlaps_range(child, h))
+                children.push_back(child);
+        }
+    }
+    clear_batch();
+    if (!children.empty())
+        sample_blocks(children, h);
+}
+
+void Voxel_Sampler::Worker::sample_voxels(
+    const std::vector<Vec3i>& blocks, int size)
+{
+    // I assume each distance value is in the centre of a voxel.
+    const double vsize = sampler_.voxelsize_;
+    for (auto& b : blocks) {
+        // clip the block against the voxel range
+        Vec3i lo = openvdb::math::maxComponent(b, sampler_.vmin_);
+        Vec3i hi = openvdb::math::minComponent(b + Vec3i(size-1),
+            sampler_.vmax_);
+        for (int x = lo.x(); x <= hi.x(); ++x) {
+            for (int y = lo.y(); y <= hi.y(); ++y) {
+                for (int z = lo.z(); z <= hi.z(); ++z) {
+                    voxels_.push_back(openvdb::Coord{x,y,z});
+                    add_point(x*vsize, y*vsize, z*vsize);
+                    if (voxels_.size() >= batch_size)
+                        store_voxels();
+                }
+            }
+        }
+    }
+    store_voxels();
+}
+
+// Create an empty grid for a signed distance field.
+openvdb::FloatGrid::Ptr make_grid(double voxelsize)
+{
+    // 2.0 is the background (or default) distance value for this
+    // sparse array of voxels. Each voxel is a `float`.
+    openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create(2.0);
+
+    // Attach a scaling transform that sets the voxel size in world space.
+    grid->setTransform(
+        openvdb::math::Transform::createLinearTransform(voxelsize));
+
+    // Identify the grid as a signed distance field.
+    grid->setGridClass(openvdb::GRID_LEVEL_SET);
+    return grid;
+}
+
+// Tiled meshing, for meshes too large to build in memory.
+//
+// The voxel range is divided into cubic tiles, which are meshed one at a
+// time and streamed to the output, so peak memory use is bounded by the tile
+// size, not the model size. Each tile is sampled with a margin of voxels
+// around it, and keeps only the faces whose centroid lies inside the tile.
+// Without adaptivity, a mesh vertex depends only on the 8 voxels around it,
+// so a vertex on the seam between two tiles is computed with bit-identical
+// coordinates by both tiles. Vertices near a seam are looked up by position
+// in a hash table, so that they are shared by the faces on either side.
+//
+// Tiles are processed in slabs along the X axis. The hash table only holds
+// the vertices from the current and previous slab.
+struct Tiled_Mesher
+{
+    static constexpr int margin = 3;          // voxels sampled around a tile
+    static constexpr float seam_width = 2.0f; // in voxels
+
+    struct Key
+    {
+        uint32_t bits[3];
+        bool operator==(const Key& k) const
+        {
+            return bits[0]==k.bits[0] && bits[1]==k.bits[1]
+                && bits[2]==k.bits[2];
+        }
+    };
+    struct Key_Hash
+    {
+        size_t operator()(const Key& k) const
+        {
+            size_t h = k.bits[0];
+            h = h * 1000003u ^ k.bits[1];
+            h = h * 1000003u ^ k.bits[2];
+            return h;
+        }
+    };
+    using Seam_Map = std::unordered_map<Key, unsigned, Key_Hash>;
+
+    curv::Shape& shape_;
+    unsigned nthreads_;
+    Vec3i vmin_, vmax_;
+    double voxelsize_;
+    double lipschitz_;
+    int tile_;
+
+    Seam_Map seams_, prev_seams_;
+    unsigned next_id_ = 0;
+    long nevals_ = 0;
+    unsigned nthreads_used_ = 1; // most threads used to sample a tile
+    long ntiles_ = 0;
+    long ntriangles_ = 0;
+    long nquads_ = 0;
+
+    Tiled_Mesher(curv::Shape& shape, unsigned nthreads, Vec3i vmin,
+        Vec3i vmax, double voxelsize, double lipschitz, int tile)
+    :
+        shape_(shape), nthreads_(nthreads), vmin_(vmin), vmax_(vmax),
+        voxelsize_(voxelsize), lipschitz_(lipschitz), tile_(tile)
+    {}
+
+    void run(curv::geom::Mesh_Stream& stream)
+    {
+        for (int x = vmin_.x(); x <= vmax_.x(); x += tile_) {
+            prev_seams_.swap(seams_);
+            seams_.clear();
+            for (int y = vmin_.y(); y <= vmax_.y(); y += tile_) {
+                for (int z = vmin_.z(); z <= vmax_.z(); z += tile_) {
+                    Vec3i lo(x, y, z);
+                    Vec3i hi = openvdb::math::minComponent(
+                        lo + Vec3i(tile_), vmax_ + Vec3i(1));
+                    mesh_tile(lo, hi, stream);
+                }
+            }
+        }
+    }
+
+    // Mesh the voxels from lo to hi-1.
+    void mesh_tile(Vec3i lo, Vec3i hi, curv::geom::Mesh_Stream& stream);
+
+    // The id of a vertex, in the whole mesh.
+    unsigned vertex_id(glm::vec3 p, glm::vec3 lo, glm::vec3 hi);
+};
+
+void Tiled_Mesher::mesh_tile(Vec3i lo, Vec3i hi,
+    curv::geom::Mesh_Stream& stream)
+{
+    openvdb::tools::VolumeToMesh mesher(0.0, 0.0);
+    {
+        openvdb::FloatGrid::Ptr grid = make_grid(voxelsize_);
+        Voxel_Sampler sampler(shape_,
+            openvdb::math::maxComponent(lo - Vec3i(margin), vmin_),
+            openvdb::math::minComponent(hi + Vec3i(margin - 1), vmax_),
+            voxelsize_, lipschitz_);
+        sampler.shell_ = 1;
+        nevals_ += sampler.sample(*grid, nthreads_);
+        nthreads_used_ = std::max(nthreads_used_, sampler.nthreads_);
+        mesher(*grid);
+    }
+    ++ntiles_;
+
+    // Tile bounds, in voxel coordinates.
+    const float vsize = float(voxelsize_);
+    const glm::vec3 tlo(lo.x(), lo.y(), lo.z());
+    const glm::vec3 thi(hi.x(), hi.y(), hi.z());
+    auto owned = [&](glm::vec3 centroid)->bool {
+        glm::vec3 c = centroid / vsize;
+        return c.x >= tlo.x && c.x < thi.x
+            && c.y >= tlo.y && c.y < thi.y
+            && c.z >= tlo.z && c.z < thi.z;
+    };
+
+    // Copy the faces we own into `piece`, with their vertices.
+    curv::geom::Mesh piece;
+    std::vector<unsigned> ids;
+    std::vector<unsigned> local(mesher.pointListSize(), UINT_MAX);
+    auto point = [&](unsigned i)->unsigned {
+        if (local[i] == UINT_MAX) {
+            glm::vec3 p = V3(mesher.pointList()[i]);
+            local[i] = unsigned(piece.points_.size());
+            piece.points_.push_back(p);
+            ids.push_back(vertex_id(p, tlo, thi));
+        }
+        return local[i];
+    };
+    auto pt = [&](unsigned i)->glm::vec3 { return V3(mesher.pointList()[i]); };
+    for (unsigned int i=0; i<mesher.polygonPoolListSize(); ++i) {
+        openvdb::tools::PolygonPool& pool = mesher.polygonPoolList()[i];
+        for (unsigned int j=0; j<pool.numTriangles(); ++j) {
+            // swap ordering of nodes to get outside-normals
+            auto& t = pool.triangle(j);
+            if (!owned((pt(t[0]) + pt(t[2]) + pt(t[1])) / 3.0f))
+                continue;
+            piece.triangles_.push_back(
+                glm::uvec3{point(t[0]), point(t[2]), point(t[1])});
+        }
+        for (unsigned int j=0; j<pool.numQuads(); ++j) {
+            auto& q = pool.quad(j);
+            if (!owned((pt(q[0]) + pt(q[3]) + pt(q[2]) + pt(q[1])) / 4.0f))
+                continue;
+            piece.quads_.push_back(
+                glm::uvec4{point(q[0]), point(q[3]), point(q[2]), point(q[1])});
+        }
+    }
+    ntriangles_ += long(piece.triangles_.size());
+    nquads_ += long(piece.quads_.size());
+    stream.write(piece, ids);
+}
+
+unsigned Tiled_Mesher::vertex_id(glm::vec3 p, glm::vec3 lo, glm::vec3 hi)
+{
+    glm::vec3 v = p / float(voxelsize_);
+    bool on_seam =
+           v.x - lo.x < seam_width || hi.x - v.x < seam_width
+        || v.y - lo.y < seam_width || hi.y - v.y < seam_width
+        || v.z - lo.z < seam_width || hi.z - v.z < seam_width;
+    if (!on_seam)
+        return next_id_++;
+    Key key;
+    memcpy(key.bits, &p.x, 4);
+    memcpy(key.bits + 1, &p.y, 4);
+    memcpy(key.bits + 2, &p.z, 4);
+    auto i = seams_.find(key);
+    if (i != seams_.end())
+        return i->second;
+    i = prev_seams_.find(key);
+    if (i != prev_seams_.end())
+        return i->second;
+    unsigned id = next_id_++;
+    seams_[key] = id;
+    return id;
+}
+
+void report_mesh_size(long ntri, long nquad)
+{
+    if (ntri == 0 && nquad == 0) {
+        std::cerr << "WARNING: no mesh was created (no volumes were found).\n"
+          << "Maybe you should try a smaller voxel size.\n";
+    } else {
+        if (ntri > 0)
+            std::cerr << ntri << " triangles";
+        if (ntri > 0 && nquad > 0)
+            std::cerr << ", ";
+        if (nquad > 0)
+            std::cerr << nquad << " quads";
+        std::cerr << ".\n";
+    }
+}
+
 void export_mesh(Mesh_Format format, curv::Value value,
     curv::Program& prog,
     const Export_Params& params,
@@ -125,18 +584,40 @@ void export_mesh(Mesh_Format format, curv::Value value,
         throw curv::Exception(cx, "mesh export: not a 3D shape");
 
     bool jit = false;
+    auto backend = curv::geom::Jit_Backend::cpp;
     double vsize = 0.0;
     double adaptive = 0.0;
-    enum {face_colour, vertex_colour} colouring = face_colour;
+    double lipschitz = 1.0;
+    unsigned nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0) nthreads = 1;
+    bool threads_specified = false;
+    auto colouring = curv::geom::Mesh_Colouring::face;
+    bool binary = false;
+    int tile = 0;
     for (auto& i : params.map_) {
         Param p{params, i};
-        if (p.name_ == "jit")
-            jit = p.to_bool();
-        else if (p.name_ == "vsize") {
+        if (p.name_ == "jit") {
+            curv::Value val = p.eval(curv::Value{true});
+            if (val.is_bool())
+                jit = val.to_bool(p);
+            else {
+                jit = true;
+                backend = curv::geom::Jit_Backend(
+                    curv::value_to_enum(val, {"cpp", "vm"}, p));
+            }
+        } else if (p.name_ == "threads") {
+            nthreads = p.to_int(1, INT_MAX);
+            threads_specified = true;
+        } else if (p.name_ == "vsize") {
             vsize = p.to_double();
             if (vsize <= 0.0) {
                 throw curv::Exception(p, "'vsize' must be positive");
             }
+        } else if (p.name_ == "lipschitz") {
+            lipschitz = p.to_double();
+            if (!(lipschitz > 0.0)) {
+                throw curv::Exception(p, "'lipschitz' must be positive");
+            }
         } else if (p.name_ == "adaptive") {
             adaptive = p.to_double(1.0);
             if (adaptive < 0.0 || adaptive > 1.0) {
@@ -145,21 +626,31 @@ void export_mesh(Mesh_Format format, curv::Value value,
         } else if (format == Mesh_Format::x3d_format && p.name_ == "colouring") {
             auto val = p.to_symbol();
             if (val == "face")
-                colouring = face_colour;
+                colouring = curv::geom::Mesh_Colouring::face;
             else if (val == "vertex")
-                colouring = vertex_colour;
+                colouring = curv::geom::Mesh_Colouring::vertex;
             else {
                 throw curv::Exception(p, "'colouring' must be #face or #vertex");
             }
-        } else
+        } else if (format == Mesh_Format::stl_format && p.name_ == "binary")
+            binary = p.to_bool();
+        else if (format != Mesh_Format::x3d_format && p.name_ == "tile")
+            tile = p.to_int(8, INT_MAX);
+        else
             p.unknown_parameter();
     }
+    if (tile > 0 && adaptive > 0.0)
+        throw curv::Exception(cx, "'adaptive' can't be used with 'tile'");
+    if (tile > 0 && binary && out.tellp() == std::ostream::pos_type(-1)) {
+        throw curv::Exception(cx,
+            "binary STL export with 'tile' requires an output file");
+    }
 
     std::unique_ptr<curv::geom::Compiled_Shape> cshape = nullptr;
     if (jit) {
         //std::chrono::time_point<std::chrono::steady_clock> cstart_time, cend_time;
         auto cstart_time = std::chrono::steady_clock::now();
-        cshape = std::make_unique<curv::geom::Compiled_Shape>(shape);
+        cshape = std::make_unique<curv::geom::Compiled_Shape>(shape, backend);
         auto cend_time = std::chrono::steady_clock::now();
         std::chrono::duration<double> compile_time = cend_time - cstart_time;
         std::cerr
@@ -212,210 +703,112 @@ void export_mesh(Mesh_Format format, curv::Value value,
     // Create a FloatGrid and populate it with a signed distance field.
     std::chrono::time_point<std::chrono::steady_clock> start_time, end_time;
     start_time = std::chrono::steady_clock::now();
-
-    // 2.0 is the background (or default) distance value for this
-    // sparse array of voxels. Each voxel is a `float`.
-    openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create(2.0);
-
-    // Attach a scaling transform that sets the voxel size in world space.
-    grid->setTransform(
-        openvdb::math::Transform::createLinearTransform(voxelsize));
-
-    // Identify the grid as a signed distance field.
-    grid->setGridClass(openvdb::GRID_LEVEL_SET);
-
-    // Populate the grid.
-    // I assume each distance value is in the centre of a voxel.
-    auto accessor = grid->getAccessor();
+    // The shape and number of threads used to sample the distance field.
+    // The interpreter only uses multiple threads on request, since reference
+    // counts are updated atomically when Values are shared between threads.
+    curv::Shape* sshape = &shape;
+    unsigned sthreads = threads_specified ? nthreads : 1;
     if (cshape != nullptr) {
-        // TODO: use multiple threads, since cshape->dist is thread safe.
-        for (int x = voxelrange_min.x(); x <= voxelrange_max.x(); ++x) {
-            for (int y = voxelrange_min.y(); y <= voxelrange_max.y(); ++y) {
-                for (int z = voxelrange_min.z(); z <= voxelrange_max.z(); ++z) {
-                    accessor.setValue(openvdb::Coord{x,y,z},
-                        cshape->dist(x*voxelsize, y*voxelsize, z*voxelsize, 0.0));
-                }
-            }
-        }
-    } else {
-        for (int x = voxelrange_min.x(); x <= voxelrange_max.x(); ++x) {
-            for (int y = voxelrange_min.y(); y <= voxelrange_max.y(); ++y) {
-                for (int z = voxelrange_min.z(); z <= voxelrange_max.z(); ++z) {
-                    accessor.setValue(openvdb::Coord{x,y,z},
-                        shape.dist(x*voxelsize, y*voxelsize, z*voxelsize, 0.0));
-                }
-            }
-        }
+        sshape = cshape.get();
+        sthreads = nthreads;
+    }
+    long nvoxels =
+        long(voxelrange_max.x() - voxelrange_min.x() + 1) *
+        long(voxelrange_max.y() - voxelrange_min.y() + 1) *
+        long(voxelrange_max.z() - voxelrange_min.z() + 1);
+
+    if (tile > 0) {
+        curv::geom::Mesh_Stream stream(
+            format == obj_format ? curv::geom::Mesh_Stream::Format::obj
+            : binary ? curv::geom::Mesh_Stream::Format::binary_stl
+            : curv::geom::Mesh_Stream::Format::ascii_stl,
+            out);
+        Tiled_Mesher tiler(*sshape, sthreads, voxelrange_min, voxelrange_max,
+            voxelsize, lipschitz, tile);
+        tiler.run(stream);
+        stream.finish();
+        out.flush();
+        end_time = std::chrono::steady_clock::now();
+        std::chrono::duration<double> mesh_time = end_time - start_time;
+        std::cerr
+            << "Meshed " << nvoxels << " voxels in " << tiler.ntiles_
+            << " tiles of " << tile << "³ voxels in "
+            << mesh_time.count() << "s ("
+            << long(nvoxels/mesh_time.count()) << " voxels/s, "
+            << "evaluated dist at " << tiler.nevals_ << " points";
+        if (tiler.nthreads_used_ > 1)
+            std::cerr << ", " << tiler.nthreads_used_ << " threads";
+        std::cerr << ").\n";
+        if (format == obj_format)
+            report_mesh_size(tiler.ntriangles_, tiler.nquads_);
+        else
+            report_mesh_size(tiler.ntriangles_ + 2*tiler.nquads_, 0);
+        return;
     }
+
+    openvdb::FloatGrid::Ptr grid = make_grid(voxelsize);
+    Voxel_Sampler sampler(*sshape, voxelrange_min, voxelrange_max,
+        voxelsize, lipschitz);
+    long nevals = sampler.sample(*grid, sthreads);
     end_time = std::chrono::steady_clock::now();
     std::chrono::duration<double> render_time = end_time - start_time;
-    int nvoxels =
-        (voxelrange_max.x() - voxelrange_min.x() + 1) *
-        (voxelrange_max.y() - voxelrange_min.y() + 1) *
-        (voxelrange_max.z() - voxelrange_min.z() + 1);
     std::cerr
         << "Rendered " << nvoxels
         << " voxels in " << render_time.count() << "s ("
-        << int(nvoxels/render_time.count()) << " voxels/s).\n";
+        << long(nvoxels/render_time.count()) << " voxels/s, "
+        << "evaluated dist at " << nevals << " points";
+    if (sampler.nthreads_ > 1)
+        std::cerr << ", " << sampler.nthreads_ << " threads";
+    std::cerr << ").\n";
     std::cerr.flush();
 
     // convert grid to a mesh
     openvdb::tools::VolumeToMesh mesher(0.0, adaptive);
     mesher(*grid);
+    grid.reset();
+
+    // Convert the mesher output to a Mesh, and free the mesher's copy.
+    // Swap the vertex order of each face to get outside-normals.
+    curv::geom::Mesh mesh;
+    mesh.points_.reserve(mesher.pointListSize());
+    for (unsigned int i = 0; i < mesher.pointListSize(); ++i)
+        mesh.points_.push_back(V3(mesher.pointList()[i]));
+    for (unsigned int i=0; i<mesher.polygonPoolListSize(); ++i) {
+        openvdb::tools::PolygonPool& pool = mesher.polygonPoolList()[i];
+        for (unsigned int j=0; j<pool.numTriangles(); ++j) {
+            auto& t = pool.triangle(j);
+            mesh.triangles_.push_back(glm::uvec3{t[0], t[2], t[1]});
+        }
+        for (unsigned int j=0; j<pool.numQuads(); ++j) {
+            auto& q = pool.quad(j);
+            mesh.quads_.push_back(glm::uvec4{q[0], q[3], q[2], q[1]});
+        }
+    }
+    mesher.pointList().reset();
+    mesher.polygonPoolList().reset();
 
     // output a mesh file
-    int ntri = 0;
-    int nquad = 0;
+    start_time = std::chrono::steady_clock::now();
     switch (format) {
     case stl_format:
-        out << "solid curv\n";
-        for (unsigned int i=0; i<mesher.polygonPoolListSize(); ++i) {
-            openvdb::tools::PolygonPool& pool = mesher.polygonPoolList()[i];
-            for (unsigned int j=0; j<pool.numTriangles(); ++j) {
-                // swap ordering of nodes to get outside-normals
-                put_triangle(out,
-                    V3(mesher.pointList()[ pool.triangle(j)[0] ]),
-                    V3(mesher.pointList()[ pool.triangle(j)[2] ]),
-                    V3(mesher.pointList()[ pool.triangle(j)[1] ]));
-                ++ntri;
-            }
-            for (unsigned int j=0; j<pool.numQuads(); ++j) {
-                // swap ordering of nodes to get outside-normals
-                put_triangle(out,
-                    V3(mesher.pointList()[ pool.quad(j)[0] ]),
-                    V3(mesher.pointList()[ pool.quad(j)[2] ]),
-                    V3(mesher.pointList()[ pool.quad(j)[1] ]));
-                put_triangle(out,
-                    V3(mesher.pointList()[ pool.quad(j)[0] ]),
-                    V3(mesher.pointList()[ pool.quad(j)[3] ]),
-                    V3(mesher.pointList()[ pool.quad(j)[2] ]));
-                ntri += 2;
-            }
-        }
-        out << "endsolid curv\n";
+        curv::geom::write_stl(mesh, binary, out);
         break;
     case obj_format:
-        for (unsigned int i = 0; i < mesher.pointListSize(); ++i) {
-            auto& pt = mesher.pointList()[i];
-            out << "v " << pt.x() << " " << pt.y() << " " << pt.z() << "\n";
-        }
-        for (unsigned int i=0; i<mesher.polygonPoolListSize(); ++i) {
-            openvdb::tools::PolygonPool& pool = mesher.polygonPoolList()[i];
-            for (unsigned int j=0; j<pool.numTriangles(); ++j) {
-                // swap ordering of nodes to get outside-normals
-                auto& tri = pool.triangle(j);
-                out << "f " << tri[0]+1 << " "
-                            << tri[2]+1 << " "
-                            << tri[1]+1 << "\n";
-                ++ntri;
-            }
-            for (unsigned int j=0; j<pool.numQuads(); ++j) {
-                // swap ordering of nodes to get outside-normals
-                auto& q = pool.quad(j);
-                out << "f " << q[0]+1 << " "
-                            << q[3]+1 << " "
-                            << q[2]+1 << " "
-                            << q[1]+1 << "\n";
-                ++nquad;
-            }
-        }
+        curv::geom::write_obj(mesh, out);
         break;
     case x3d_format:
-      {
-        out <<
-        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-        "<!DOCTYPE X3D PUBLIC \"ISO//Web3D//DTD X3D 3.1//EN\" \"http://www.web3d.org/specifications/x3d-3.1.dtd\">\n"
-        "<X3D profile=\"Interchange\" version=\"3.1\" xsd:noNamespaceSchemaLocation=\"http://www.web3d.org/specifications/x3d-3.1.xsd\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
-        " <head>\n"
-        "  <meta content=\"Curv, https://github.com/doug-moen/curv\" name=\"generator\"/>\n"
-        " </head>\n"
-        " <Scene>\n"
-        "  <Shape>\n"
-        "   <IndexedFaceSet colorPerVertex=\"";
-        out << (colouring == vertex_colour ? "true" : "false");
-        out << "\" coordIndex=\"";
-        bool first = true;
-        for (unsigned int i=0; i<mesher.polygonPoolListSize(); ++i) {
-            openvdb::tools::PolygonPool& pool = mesher.polygonPoolList()[i];
-            for (unsigned int j=0; j<pool.numTriangles(); ++j) {
-                if (!first) out << " ";
-                first = false;
-                auto& tri = pool.triangle(j);
-                out << tri[0] << " " << tri[2] << " " << tri[1] << " -1";
-                ++ntri;
-            }
-            for (unsigned int j=0; j<pool.numQuads(); ++j) {
-                if (!first) out << " ";
-                first = false;
-                auto& q = pool.quad(j);
-                out << q[0] << " " << q[2] << " " << q[1] << " -1 "
-                    << q[0] << " " << q[3] << " " << q[2] << " -1";
-                ntri += 2;
-            }
-        }
-        out <<
-        "\">\n"
-        "    <Coordinate point=\"";
-        first = true;
-        for (unsigned int i = 0; i < mesher.pointListSize(); ++i) {
-            if (!first) out << " ";
-            first = false;
-            auto& pt = mesher.pointList()[i];
-            out << pt.x() << " " << pt.y() << " " << pt.z();
-        }
-        out <<
-        "\"/>\n"
-        "    <Color color=\"";
-        switch (colouring) {
-        case face_colour:
-            for (unsigned int i=0; i<mesher.polygonPoolListSize(); ++i) {
-                openvdb::tools::PolygonPool& pool = mesher.polygonPoolList()[i];
-                for (unsigned int j=0; j<pool.numTriangles(); ++j) {
-                    put_face_colour(out, shape,
-                        mesher.pointList()[ pool.triangle(j)[0] ],
-                        mesher.pointList()[ pool.triangle(j)[2] ],
-                        mesher.pointList()[ pool.triangle(j)[1] ]);
-                }
-                for (unsigned int j=0; j<pool.numQuads(); ++j) {
-                    put_face_colour(out, shape,
-                        mesher.pointList()[ pool.quad(j)[0] ],
-                        mesher.pointList()[ pool.quad(j)[2] ],
-                        mesher.pointList()[ pool.quad(j)[1] ]);
-                    put_face_colour(out, shape,
-                        mesher.pointList()[ pool.quad(j)[0] ],
-                        mesher.pointList()[ pool.quad(j)[3] ],
-                        mesher.pointList()[ pool.quad(j)[2] ]);
-                }
-            }
-            break;
-        case vertex_colour:
-            for (unsigned int i = 0; i < mesher.pointListSize(); ++i) {
-                put_vertex_colour(out, shape, mesher.pointList()[i]);
-            }
-            break;
-        }
-        out <<
-        "\"/>\n"
-        "   </IndexedFaceSet>\n"
-        "  </Shape>\n"
-        " </Scene>\n"
-        "</X3D>\n";
+        curv::geom::write_x3d(mesh, shape, colouring, out);
         break;
-      }
     default:
         curv::die("bad mesh format");
     }
-
-    if (ntri == 0 && nquad == 0) {
-        std::cerr << "WARNING: no mesh was created (no volumes were found).\n"
-          << "Maybe you should try a smaller voxel size.\n";
-    } else {
-        if (ntri > 0)
-            std::cerr << ntri << " triangles";
-        if (ntri > 0 && nquad > 0)
-            std::cerr << ", ";
-        if (nquad > 0)
-            std::cerr << nquad << " quads";
-        std::cerr << ".\n";
-    }
+    out.flush();
+    end_time = std::chrono::steady_clock::now();
+    std::chrono::duration<double> write_time = end_time - start_time;
+    std::cerr << "Wrote mesh file in " << write_time.count() << "s.\n";
+    if (format == obj_format) {
+        report_mesh_size(
+            long(mesh.triangles_.size()), long(mesh.quads_.size()));
+    } else
+        report_mesh_size(long(mesh.ntriangles()), 0);
 }
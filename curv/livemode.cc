@@ -13,14 +13,23 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 }
-#include <iostream>
+#include <algorithm>
 #include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
 #include <thread>
+#include <vector>
 
 #include "shapes.h"
 #include "view_server.h"
 #include <libcurv/context.h>
+#include <libcurv/import.h>
 #include <libcurv/program.h>
 #include <libcurv/source.h>
 #include <libcurv/system.h>
@@ -66,18 +75,137 @@ poll_editor()
     }
 }
 
+namespace fs = curv::Filesystem;
+
+// Waits for a change to any of a set of files (the program file, and the
+// files it imports). On Linux, inotify is used to watch the directories
+// containing those files: watching the directory, rather than the file,
+// catches editors that save a file by writing a new copy and renaming it.
+// Elsewhere, the modification times of the files are polled.
+struct File_Watcher
+{
+    std::vector<fs::path> files_;
+  #ifdef __linux__
+    int fd_ = -1;
+    std::map<int, fs::path> dirs_; // watch descriptor -> directory
+  #endif
+    std::vector<time_t> mtimes_;
+
+    ~File_Watcher() { close(); }
+
+    void close()
+    {
+      #ifdef __linux__
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        dirs_.clear();
+      #endif
+    }
+
+    static time_t mtime(const fs::path& file)
+    {
+        struct stat st;
+        if (stat(file.c_str(), &st) != 0)
+            return 0;
+        return st.st_mtime;
+    }
+
+    void watch(std::vector<fs::path> files)
+    {
+        close();
+        files_ = std::move(files);
+        mtimes_.clear();
+        for (auto& f : files_)
+            mtimes_.push_back(mtime(f));
+      #ifdef __linux__
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0)
+            return;
+        std::set<fs::path> dirs;
+        for (auto& f : files_) {
+            dirs.insert(f.parent_path());
+            // A directory import depends on the directory listing.
+            boost::system::error_code errcode;
+            if (fs::is_directory(f, errcode))
+                dirs.insert(f);
+        }
+        for (auto& d : dirs) {
+            int wd = inotify_add_watch(fd_, d.c_str(),
+                IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_CREATE|IN_DELETE);
+            if (wd >= 0)
+                dirs_[wd] = d;
+        }
+      #endif
+    }
+
+    bool watched(const fs::path& p) const
+    {
+        return std::find(files_.begin(), files_.end(), p) != files_.end();
+    }
+
+    // Wait up to 'ms' milliseconds for a watched file to change.
+    bool wait(int ms)
+    {
+      #ifdef __linux__
+        if (fd_ >= 0) {
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, ms) <= 0)
+                return false;
+            alignas(struct inotify_event) char buf[4096];
+            bool changed = false;
+            ssize_t n;
+            while ((n = ::read(fd_, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + n; ) {
+                    auto ev = (struct inotify_event*)p;
+                    auto d = dirs_.find(ev->wd);
+                    if (d != dirs_.end()) {
+                        if (watched(d->second)
+                            || (ev->len > 0 && watched(d->second / ev->name)))
+                        {
+                            changed = true;
+                        }
+                    }
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+            return changed;
+        }
+      #endif
+        usleep(ms * 1000);
+        for (size_t i = 0; i < files_.size(); ++i) {
+            if (mtime(files_[i]) != mtimes_[i])
+                return true;
+        }
+        return false;
+    }
+};
+
 void
 poll_file(
     curv::System* sys, curv::viewer::Viewer_Config* opts,
     const char* editor, const char* filename)
 {
+    fs::path filepath = fs::absolute(filename);
+    File_Watcher watcher;
     for (;;) {
+        // The files to watch: the program file and its imports, which are
+        // recorded while the program is being evaluated. Imported files are
+        // cached by the System (see curv_import), so when an imported file
+        // changes, only that file and the files that import it are
+        // re-evaluated.
+        //
+        // The watcher is started after evaluation, so it misses an edit
+        // made during evaluation. To catch these, each file is hashed as it
+        // is read: the program file before evaluation, and each import as
+        // it is recorded. If a hash no longer matches once the watcher has
+        // started, the program is evaluated again.
+        std::vector<fs::path> files{filepath};
+        curv::System::File_Hashes deps;
         struct stat st;
-        if (stat(filename, &st) != 0) {
-            // file doesn't exist.
-            memset((void*)&st, 0, sizeof(st));
-        } else {
+        if (stat(filename, &st) == 0) {
             // evaluate file.
+            deps.push_back({filepath, curv::hash_file(filepath)});
+            curv::Record_Imports record(*sys, deps);
             try {
                 auto file = curv::make<curv::File_Source>(
                     curv::make_string(filename), curv::At_System{*sys});
@@ -94,19 +222,27 @@ poll_file(
             } catch (std::exception& e) {
                 sys->error(e);
             }
+            for (size_t i = 1; i < deps.size(); ++i)
+                files.push_back(deps[i].first);
         }
-        // Wait for file to change or editor to quit.
+        watcher.watch(std::move(files));
+
+        // Wait for a file to change or editor to quit.
+        bool changed_during_eval = !curv::files_unchanged(deps);
         for (;;) {
-            usleep(500'000);
+            bool changed = changed_during_eval || watcher.wait(500);
+            changed_during_eval = false;
             if (editor && !poll_editor()) {
                 live_view_server.exit();
                 return;
             }
-            struct stat st2;
-            if (stat(filename, &st2) != 0)
-                memset((void*)&st2, 0, sizeof(st));
-            if (st.st_mtime != st2.st_mtime)
+            if (changed) {
+                // An editor may write a file in several steps:
+                // wait for it to finish.
+                while (watcher.wait(20))
+                    ;
                 break;
+            }
         }
     }
 }
@@ -3,15 +3,26 @@
 // See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
 
 extern "C" {
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 }
+#include <cerrno>
+#include <csignal>
+#include <cstring>
 #include <iostream>
+#include <streambuf>
+#include <string>
 
 #include <libcurv/context.h>
+#include <libcurv/exception.h>
 #include <libcurv/gpu_program.h>
 #include <libcurv/json.h>
 #include <libcurv/progdir.h>
 #include <libcurv/program.h>
+#include <libcurv/record.h>
+#include <libcurv/render.h>
 #include <libcurv/source.h>
 #include <libcurv/system.h>
 #include <libcurv/version.h>
@@ -19,37 +30,238 @@ extern "C" {
 namespace fs = curv::Filesystem;
 using namespace curv;
 
+// Compile a program, and write the result (a shape or a value) as a line
+// of JSON. Errors are reported by the caller.
+static void
+compile(Shared<const Source> source, System& sys, const Render_Opts& opts)
+{
+    Program prog{std::move(source), sys};
+    prog.compile();
+    auto value = prog.eval();
+    GPU_Program gprog{prog};
+    std::ostream& out = sys.console();
+    if (!gprog.recognize(value, opts)) {
+        out << "{\"value\":";
+        write_json_value(value, out);
+        out << "}\n";
+    } else {
+        out << "{\"shape\":";
+        gprog.write_json(out);
+        out << "}\n";
+    }
+}
+
+// Server mode. Each line of input is a JSON object, which is a compile
+// request, containing either a "path" or a "source" field, and an optional
+// "render" field (a record of render options, see `curv --help`).
+// Requests are processed in order. The response to each request is a
+// sequence of JSON-API lines: zero or more "print" and "warning" lines
+// written by the program, followed by a "shape", "value" or "error" line.
+//
+// The System persists between requests, so the standard library and the
+// import cache of files referenced using `file` stay warm.
+static void
+serve(System& sys, std::istream& in)
+{
+    static Symbol_Ref path_key = make_symbol("path");
+    static Symbol_Ref source_key = make_symbol("source");
+    static Symbol_Ref render_key = make_symbol("render");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        try {
+            At_System cx{sys};
+            auto request = read_json_value(line.c_str(), cx).to<Record>(cx);
+            Shared<const Source> source;
+            if (request->hasfield(path_key)) {
+                auto path = request->getfield(path_key, cx).to<String>(cx);
+                source = make<File_Source>(path, cx);
+            } else if (request->hasfield(source_key)) {
+                auto src = request->getfield(source_key, cx).to<String>(cx);
+                source = make<String_Source>("", src);
+            } else {
+                throw Exception(cx, "request has no 'path' or 'source' field");
+            }
+            Render_Opts opts;
+            if (request->hasfield(render_key)) {
+                auto render =
+                    request->getfield(render_key, cx).to<Record>(cx);
+                render->each_field(cx, [&](Symbol_Ref name, Value val)->void {
+                    if (!opts.set_field(name.c_str(), val, cx))
+                        throw Exception(cx, stringify(
+                            "unknown render option '", name, "'"));
+                });
+            }
+            compile(std::move(source), sys, opts);
+        } catch (std::exception& e) {
+            sys.error(e);
+        }
+        sys.console().flush();
+    }
+}
+
+// A stream buffer for reading and writing a socket.
+// If a write fails (EPIPE if the client has disconnected), then the
+// connection is treated as closed: further output is discarded, and the
+// input reaches end of file.
+struct Socket_Buf : public std::streambuf
+{
+    int fd_;
+    bool closed_ = false;
+    char in_[4096];
+    char out_[4096];
+
+    Socket_Buf(int fd) : fd_(fd)
+    {
+        setg(in_, in_, in_);
+        setp(out_, out_ + sizeof(out_));
+    }
+    ~Socket_Buf() { sync(); }
+
+    virtual int underflow() override
+    {
+        if (closed_)
+            return traits_type::eof();
+        ssize_t n;
+        do n = ::read(fd_, in_, sizeof(in_));
+        while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return traits_type::eof();
+        setg(in_, in_, in_ + n);
+        return traits_type::to_int_type(*gptr());
+    }
+    virtual int overflow(int c) override
+    {
+        if (sync() != 0)
+            return traits_type::eof();
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+    virtual int sync() override
+    {
+        for (char* p = pbase(); p < pptr() && !closed_; ) {
+            ssize_t n = ::write(fd_, p, pptr() - p);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                closed_ = true;
+                setg(in_, in_, in_);
+            } else
+                p += n;
+        }
+        setp(out_, out_ + sizeof(out_));
+        return closed_ ? -1 : 0;
+    }
+};
+
+// Redirect a stream to another stream buffer, for the lifetime of this
+// object. The stream's state is cleared when it is restored, in case an
+// error was caused by the stream buffer.
+struct Redirect_Stream
+{
+    std::ostream& stream_;
+    std::streambuf* saved_;
+
+    Redirect_Stream(std::ostream& stream, std::streambuf* buf)
+    :
+        stream_(stream), saved_(stream.rdbuf(buf))
+    {}
+    ~Redirect_Stream() { stream_.rdbuf(saved_); }
+    Redirect_Stream(const Redirect_Stream&) = delete;
+    Redirect_Stream& operator=(const Redirect_Stream&) = delete;
+};
+
+// Listen on a Unix domain socket, and serve each connection in turn.
+// The console stream is redirected to the connection while it is served.
+// A stale socket left at `path` by an earlier server is replaced, but any
+// other kind of file is left alone.
+static int
+serve_socket(System& sys, std::ostream& console, const char* path)
+{
+    // A client that disconnects early ends its connection, not the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        std::cerr << "curvc: socket path too long: " << path << "\n";
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+    struct stat st;
+    if (::lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "curvc: can't listen on " << path
+                << ": file exists and is not a socket\n";
+            return EXIT_FAILURE;
+        }
+        ::unlink(path);
+    }
+    int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0
+        || ::bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0
+        || ::listen(sock, 8) < 0)
+    {
+        int err = errno;
+        if (sock >= 0) ::close(sock);
+        std::cerr << "curvc: can't listen on " << path << ": "
+            << strerror(err) << "\n";
+        return EXIT_FAILURE;
+    }
+    for (;;) {
+        int conn = ::accept(sock, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "curvc: accept: " << strerror(errno) << "\n";
+            ::close(sock);
+            return EXIT_FAILURE;
+        }
+        {
+            Socket_Buf buf(conn);
+            std::istream in(&buf);
+            Redirect_Stream redirect(console, &buf);
+            serve(sys, in);
+        }
+        ::close(conn);
+    }
+}
+
 int
 main(int argc, char** argv)
 {
-    if (argc != 2) {
-        std::cerr << "Usage: curvc filename | curvc --version\n";
+    bool server = (argc >= 2 && strcmp(argv[1], "--server") == 0);
+    if (!(argc == 2 || (server && argc == 3))) {
+        std::cerr <<
+            "Usage: curvc filename | curvc --server [socket] | curvc --version\n";
         return EXIT_FAILURE;
     }
     if (strcmp(argv[1], "--version") == 0) {
         std::cout << CURV_VERSION << "\n";
         return EXIT_SUCCESS;
     }
-    System_Impl sys(std::cout);
+    std::ostream console(std::cout.rdbuf());
+    System_Impl sys(console);
     sys.use_json_api_ = true;
     try {
         sys.load_library(
             fs::canonical(progdir(argv[0])/"../lib/curv/std.curv").c_str());
-        auto source = make<File_Source>(argv[1], At_System(sys));
-        Program prog{std::move(source), sys};
-        prog.compile();
-        auto value = prog.eval();
-        GPU_Program gprog{prog};
-        Render_Opts opts;
-        if (!gprog.recognize(value, opts)) {
-            std::cout << "{\"value\":";
-            write_json_value(value, std::cout);
-            std::cout << "}\n";
-        } else {
-            std::cout << "{\"shape\":";
-            gprog.write_json(std::cout);
-            std::cout << "}\n";
-        }
+    } catch (std::exception& e) {
+        sys.error(e);
+        return server ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (server) {
+        if (argc == 3)
+            return serve_socket(sys, console, argv[2]);
+        serve(sys, std::cin);
+        return EXIT_SUCCESS;
+    }
+    try {
+        compile(make<File_Source>(argv[1], At_System(sys)), sys, Render_Opts());
     } catch (std::exception& e) {
         sys.error(e);
     }
@@ -931,11 +931,12 @@ void
 List_Expr_Base::init()
 {
     pure_ = true;
+    fixed_size_ = true;
     for (size_t i = 0; i < size(); ++i) {
-        if (!array_[i]->pure_) {
+        if (!array_[i]->pure_)
             pure_ = false;
-            return;
-        }
+        if (dynamic_cast<const Just_Expression*>(&*array_[i]) == nullptr)
+            fixed_size_ = false;
     }
 }
 
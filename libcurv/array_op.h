@@ -93,6 +93,14 @@ struct Binary_Numeric_Array_Op
     static Shared<List>
     broadcast_left(const Scalar_Op& f, Shared<List> xlist, Value y)
     {
+        auto& xs = *xlist;
+        if (y.is_num() && !xs.empty() && xs[0].is_num()) {
+            double b = y.to_num_unsafe();
+            auto result = num_kernel(f, xs.size(),
+                [&](size_t i)->double { return xs[i].to_num_or_nan(); },
+                [&](size_t)->double { return b; });
+            if (result) return result;
+        }
         Shared<List> result = List::make(xlist->size());
         for (unsigned i = 0; i < xlist->size(); ++i)
             (*result)[i] = op(f, (*xlist)[i], y);
@@ -102,6 +110,14 @@ struct Binary_Numeric_Array_Op
     static Shared<List>
     broadcast_right(const Scalar_Op& f, Value x, Shared<List> ylist)
     {
+        auto& ys = *ylist;
+        if (x.is_num() && !ys.empty() && ys[0].is_num()) {
+            double a = x.to_num_unsafe();
+            auto result = num_kernel(f, ys.size(),
+                [&](size_t)->double { return a; },
+                [&](size_t i)->double { return ys[i].to_num_or_nan(); });
+            if (result) return result;
+        }
         Shared<List> result = List::make(ylist->size());
         for (unsigned i = 0; i < ylist->size(); ++i)
             (*result)[i] = op(f, x, (*ylist)[i]);
@@ -115,11 +131,42 @@ struct Binary_Numeric_Array_Op
             throw Exception(f.cx, stringify(
                 "mismatched list sizes (",
                 xs->size(),",",ys->size(),") in array operation"));
+        if (!xs->empty() && (*xs)[0].is_num() && (*ys)[0].is_num()) {
+            auto result = num_kernel(f, xs->size(),
+                [&](size_t i)->double { return (*xs)[i].to_num_or_nan(); },
+                [&](size_t i)->double { return (*ys)[i].to_num_or_nan(); });
+            if (result) return result;
+        }
         Shared<List> result = List::make(xs->size());
         for (unsigned i = 0; i < xs->size(); ++i)
             (*result)[i] = op(f, (*xs)[i], (*ys)[i]);
         return result;
     }
+
+    // Fast path for lists of numbers (vectors, and the rows of a matrix):
+    // result[i] = f.call(x(i), y(i)), for i in [0,n), where x(i) and y(i)
+    // are NaN if the corresponding element isn't a number. The loop has no
+    // per-element dispatch or reference counting, and errors are checked
+    // once at the end. It returns nullptr if an argument isn't a number or
+    // a result is NaN; then the caller takes the slow path, which handles
+    // nested lists and reactive values, and reports domain errors.
+    template <class X, class Y>
+    static Shared<List>
+    num_kernel(const Scalar_Op& f, size_t n, X x, Y y)
+    {
+        Shared<List> result = List::make(n);
+        auto& rs = *result;
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) {
+            double a = x(i);
+            double b = y(i);
+            double r = f.call(a, b);
+            ok &= (a == a) & (b == b) & (r == r);
+            rs[i] = {r};
+        }
+        if (!ok) return nullptr;
+        return result;
+    }
 };
 
 // This Prim accepts Bool but not Bool32 arguments in SubCurv.
@@ -461,12 +508,27 @@ struct Binary_Array_Op
         throw Exception(cx, "expected a list of size 2");
     }
 
+    // In the following loops, scalar elements are unboxed and passed
+    // directly to Prim::call, which is the common case. Only the elements
+    // that are lists or reactive values recurse through `op`.
+
     static Value
     broadcast_left(const Context& cx, List& xlist, Value y)
     {
         Shared<List> result = List::make(xlist.size());
-        for (unsigned i = 0; i < xlist.size(); ++i)
-            (*result)[i] = op(cx, xlist[i], y);
+        typename Prim::left_t sx{};
+        typename Prim::right_t sy{};
+        if (Prim::unbox_right(y, sy, cx)) {
+            for (unsigned i = 0; i < xlist.size(); ++i) {
+                if (Prim::unbox_left(xlist[i], sx, cx))
+                    (*result)[i] = Prim::call(sx, sy, cx);
+                else
+                    (*result)[i] = op(cx, xlist[i], y);
+            }
+        } else {
+            for (unsigned i = 0; i < xlist.size(); ++i)
+                (*result)[i] = op(cx, xlist[i], y);
+        }
         return {result};
     }
 
@@ -474,8 +536,19 @@ struct Binary_Array_Op
     broadcast_right(const Context& cx, Value x, List& ylist)
     {
         Shared<List> result = List::make(ylist.size());
-        for (unsigned i = 0; i < ylist.size(); ++i)
-            (*result)[i] = op(cx, x, ylist[i]);
+        typename Prim::left_t sx{};
+        typename Prim::right_t sy{};
+        if (Prim::unbox_left(x, sx, cx)) {
+            for (unsigned i = 0; i < ylist.size(); ++i) {
+                if (Prim::unbox_right(ylist[i], sy, cx))
+                    (*result)[i] = Prim::call(sx, sy, cx);
+                else
+                    (*result)[i] = op(cx, x, ylist[i]);
+            }
+        } else {
+            for (unsigned i = 0; i < ylist.size(); ++i)
+                (*result)[i] = op(cx, x, ylist[i]);
+        }
         return {result};
     }
 
@@ -487,8 +560,16 @@ struct Binary_Array_Op
                 "mismatched list sizes (",
                 xs.size(),",",ys.size(),") in array operation"));
         Shared<List> result = List::make(xs.size());
-        for (unsigned i = 0; i < xs.size(); ++i)
-            (*result)[i] = op(cx, xs[i], ys[i]);
+        typename Prim::left_t sx{};
+        typename Prim::right_t sy{};
+        for (unsigned i = 0; i < xs.size(); ++i) {
+            if (Prim::unbox_left(xs[i], sx, cx)
+                && Prim::unbox_right(ys[i], sy, cx))
+            {
+                (*result)[i] = Prim::call(sx, sy, cx);
+            } else
+                (*result)[i] = op(cx, xs[i], ys[i]);
+        }
         return {result};
     }
 
@@ -553,6 +634,19 @@ struct Unary_Numeric_Array_Op
     static Shared<List>
     element_wise_op(const Scalar_Op& f, Shared<List> xs)
     {
+        // Fast path for a list of numbers, like Binary_Numeric_Array_Op.
+        if (!xs->empty() && (*xs)[0].is_num()) {
+            Shared<List> result = List::make(xs->size());
+            auto& rs = *result;
+            bool ok = true;
+            for (size_t i = 0; i < xs->size(); ++i) {
+                double a = (*xs)[i].to_num_or_nan();
+                double r = f.call(a);
+                ok &= (a == a) & (r == r);
+                rs[i] = {r};
+            }
+            if (ok) return result;
+        }
         Shared<List> result = List::make(xs->size());
         for (unsigned i = 0; i < xs->size(); ++i)
             (*result)[i] = op(f, (*xs)[i]);
@@ -595,8 +689,13 @@ struct Unary_Array_Op
     element_wise_op(const Context& cx, List& xs)
     {
         Shared<List> result = List::make(xs.size());
-        for (unsigned i = 0; i < xs.size(); ++i)
-            (*result)[i] = op(cx, xs[i]);
+        typename Prim::scalar_t sx;
+        for (unsigned i = 0; i < xs.size(); ++i) {
+            if (Prim::unbox(xs[i], sx, cx))
+                (*result)[i] = Prim::call(sx, cx);
+            else
+                (*result)[i] = op(cx, xs[i]);
+        }
         return {result};
     }
 
@@ -17,6 +17,7 @@
 #include <libcurv/pattern.h>
 #include <libcurv/picker.h>
 #include <libcurv/program.h>
+#include <libcurv/shape.h>
 #include <libcurv/source.h>
 #include <libcurv/system.h>
 #include <libcurv/typeconv.h>
@@ -24,6 +25,7 @@
 #include <boost/math/constants/constants.hpp>
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
 #include <cmath>
@@ -822,6 +824,73 @@ struct Fields_Function : public Legacy_Function
     }
 };
 
+// A leaf of a bounding volume hierarchy: the centre of a shape's
+// bounding box, and the shape's index in the argument list.
+struct BVH_Item
+{
+    double centre_[3];
+    unsigned index_;
+};
+static Value
+bvh_build(std::vector<BVH_Item>& items, size_t lo, size_t hi)
+{
+    if (hi - lo == 1)
+        return {double(items[lo].index_)};
+
+    // Split at the median centre, along the axis in which the centres
+    // are most spread out.
+    double cmin[3] = {INFINITY, INFINITY, INFINITY};
+    double cmax[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (size_t i = lo; i < hi; ++i) {
+        for (int a = 0; a < 3; ++a) {
+            cmin[a] = std::min(cmin[a], items[i].centre_[a]);
+            cmax[a] = std::max(cmax[a], items[i].centre_[a]);
+        }
+    }
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (cmax[a] - cmin[a] > cmax[axis] - cmin[axis])
+            axis = a;
+    }
+    size_t mid = (lo + hi) / 2;
+    std::nth_element(items.begin() + lo, items.begin() + mid,
+        items.begin() + hi,
+        [&](const BVH_Item& i1, const BVH_Item& i2) -> bool {
+            if (i1.centre_[axis] != i2.centre_[axis])
+                return i1.centre_[axis] < i2.centre_[axis];
+            return i1.index_ < i2.index_;
+        });
+    return {List::make({bvh_build(items, lo, mid), bvh_build(items, mid, hi)})};
+}
+// _bvh_tree bboxes: Given a list of bounding boxes, return a binary tree
+// that groups nearby boxes together: a leaf is an index into the list,
+// and a branch is a pair [left,right]. Used by `union` in std.curv.
+struct BVH_Tree_Function : public Legacy_Function
+{
+    static const char* name() { return "_bvh_tree"; }
+    BVH_Tree_Function() : Legacy_Function(1,name()) {}
+    Value call(Frame& args) override
+    {
+        At_Arg cx(*this, args);
+        auto list = args[0].to<List>(cx);
+        if (list->empty())
+            return {List::make(0)};
+        std::vector<BVH_Item> items(list->size());
+        for (size_t i = 0; i < list->size(); ++i) {
+            BBox b = BBox::from_value(list->at(i), At_Index(i, cx));
+            double mins[3] = {b.xmin, b.ymin, b.zmin};
+            double maxs[3] = {b.xmax, b.ymax, b.zmax};
+            for (int a = 0; a < 3; ++a) {
+                // Infinite and empty boxes don't have a useful centre.
+                double c = (mins[a] + maxs[a]) / 2;
+                items[i].centre_[a] = std::isfinite(c) ? c : 0.0;
+            }
+            items[i].index_ = i;
+        }
+        return bvh_build(items, 0, items.size());
+    }
+};
+
 struct Strcat_Function : public Legacy_Function
 {
     static const char* name() { return "strcat"; }
@@ -1289,6 +1358,7 @@ builtin_namespace()
     FUNCTION(Mag_Function),
     FUNCTION(Count_Function),
     FUNCTION(Fields_Function),
+    FUNCTION(BVH_Tree_Function),
     FUNCTION(Strcat_Function),
     FUNCTION(Repr_Function),
     FUNCTION(Decode_Function),
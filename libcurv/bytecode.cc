@@ -0,0 +1,672 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/bytecode.h>
+
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/function.h>
+#include <libcurv/math.h>
+#include <libcurv/sc_compiler.h>
+#include <libcurv/system.h>
+#include <cmath>
+#include <mutex>
+
+namespace curv {
+
+#if defined(__GNUC__)
+  #define CURV_THREADED_DISPATCH 1
+#else
+  #define CURV_THREADED_DISPATCH 0
+#endif
+
+#if CURV_THREADED_DISPATCH
+// The dispatch address of each opcode.
+static const void* const* bytecode_labels();
+#endif
+
+// Thrown by the compiler if the code can't be represented, eg because
+// there are more than 65536 slots. The function body is then evaluated
+// by the tree walker.
+struct Bytecode_Overflow {};
+
+// Compile an Operation tree to Bytecode.
+//
+// Each expression is compiled into a slot. A reference to a local variable
+// is compiled into the variable's slot, without generating code. Other
+// expressions are evaluated into temporary slots, which are allocated in
+// stack order: the temporaries used by a subexpression are released once
+// the value of the parent expression has been computed.
+struct Bytecode_Compiler
+{
+    Bytecode& bc_;
+    slot_t next_temp_;
+
+    Bytecode_Compiler(Bytecode& bc, slot_t nslots)
+    :
+        bc_(bc),
+        next_temp_(nslots)
+    {}
+
+    uint16_t temp()
+    {
+        slot_t t = next_temp_++;
+        if (next_temp_ > bc_.nslots_) {
+            bc_.nslots_ = next_temp_;
+            if (bc_.nslots_ > 0xFFFF)
+                throw Bytecode_Overflow();
+        }
+        return uint16_t(t);
+    }
+    uint32_t add_op(const Operation& op)
+    {
+        bc_.ops_.push_back(share(op));
+        return uint32_t(bc_.ops_.size() - 1);
+    }
+    uint32_t constant(Value val)
+    {
+        bc_.constants_.push_back(val);
+        return uint32_t(bc_.constants_.size() - 1);
+    }
+    size_t emit(Bytecode::Opcode opc,
+        slot_t d = 0, slot_t a = 0, slot_t b = 0, uint32_t k = 0)
+    {
+        if (d > 0xFFFF || a > 0xFFFF || b > 0xFFFF)
+            throw Bytecode_Overflow();
+        bc_.code_.push_back({nullptr, opc,
+            uint16_t(d), uint16_t(a), uint16_t(b), k});
+        return bc_.code_.size() - 1;
+    }
+    uint32_t here() const { return uint32_t(bc_.code_.size()); }
+    void patch(size_t pc) { bc_.code_[pc].k_ = here(); }
+
+    // Compile 'op', returning the slot that contains its value.
+    slot_t expr(const Operation& e)
+    {
+        if (auto ref = dynamic_cast<const Local_Data_Ref*>(&e))
+            return ref->slot_;
+        slot_t d = temp();
+        expr_to(e, d);
+        return d;
+    }
+
+    // Compile 'op', storing its value in slot d.
+    void expr_to(const Operation& e, slot_t d)
+    {
+        slot_t mark = next_temp_;
+        if (auto c = dynamic_cast<const Constant*>(&e)) {
+            emit(Bytecode::op_constant, d, 0, 0, constant(c->value_));
+        }
+        else if (auto ref = dynamic_cast<const Local_Data_Ref*>(&e)) {
+            emit(Bytecode::op_move, d, ref->slot_);
+        }
+        else if (auto ref = dynamic_cast<const Nonlocal_Data_Ref*>(&e)) {
+            emit(Bytecode::op_nonlocal, d, 0, 0, ref->slot_);
+        }
+        else if (auto ref = dynamic_cast<const Module_Data_Ref*>(&e)) {
+            emit(Bytecode::op_module_ref, d, ref->slot_, 0, ref->index_);
+        }
+        else if (auto dot = dynamic_cast<const Dot_Expr*>(&e)) {
+            if (dot->selector_.id_ == nullptr)
+                emit(Bytecode::op_eval, d, 0, 0, add_op(e));
+            else {
+                slot_t a = expr(*dot->base_);
+                emit(Bytecode::op_dot, d, a, 0, add_op(e));
+            }
+        }
+        else if (auto neg = dynamic_cast<const Negative_Expr*>(&e)) {
+            slot_t a = expr(*neg->arg_);
+            emit(Bytecode::op_negate, d, a, 0, add_op(e));
+        }
+        else if (auto n = dynamic_cast<const Not_Expr*>(&e)) {
+            slot_t a = expr(*n->arg_);
+            emit(Bytecode::op_not, d, a, 0, add_op(e));
+        }
+        else if (auto x = dynamic_cast<const And_Expr*>(&e)) {
+            slot_t a = expr(*x->arg1_);
+            size_t br = emit(Bytecode::op_and, d, a, add_op(*x->arg1_));
+            next_temp_ = mark;
+            bool_to(*x->arg2_, d);
+            patch(br);
+        }
+        else if (auto x = dynamic_cast<const Or_Expr*>(&e)) {
+            slot_t a = expr(*x->arg1_);
+            size_t br = emit(Bytecode::op_or, d, a, add_op(*x->arg1_));
+            next_temp_ = mark;
+            bool_to(*x->arg2_, d);
+            patch(br);
+        }
+        else if (auto x = dynamic_cast<const If_Else_Op*>(&e)) {
+            slot_t a = expr(*x->arg1_);
+            size_t br = emit(Bytecode::op_if, d, a, add_op(e));
+            next_temp_ = mark;
+            expr_to(*x->arg2_, d);
+            size_t jmp = emit(Bytecode::op_jump);
+            patch(br);
+            expr_to(*x->arg3_, d);
+            patch(jmp);
+        }
+        else if (auto call = dynamic_cast<const Call_Expr*>(&e)) {
+            // Special case for indexing a list with a single index, a[i].
+            // The general case is handled by the op_index instruction.
+            auto list = dynamic_cast<const List_Expr*>(&*call->arg_);
+            if (list && list->size() == 1 && is_expr(*list->at(0))) {
+                slot_t a = expr(*call->func_);
+                slot_t b = expr(*list->at(0));
+                emit(Bytecode::op_index, d, a, b, add_op(e));
+            } else {
+                slot_t a = expr(*call->func_);
+                slot_t b = expr(*call->arg_);
+                emit(Bytecode::op_call, d, a, b, add_op(e));
+            }
+        }
+        else if (auto list = dynamic_cast<const List_Expr*>(&e)) {
+            bool simple = true;
+            for (auto& elem : *list)
+                simple = simple && is_expr(*elem);
+            if (simple) {
+                // allocate consecutive slots for the elements
+                slot_t base = next_temp_;
+                for (size_t i = 0; i < list->size(); ++i)
+                    temp();
+                for (size_t i = 0; i < list->size(); ++i)
+                    expr_to(*list->at(i), base + i);
+                emit(Bytecode::op_list, d, base, list->size());
+            } else
+                emit(Bytecode::op_eval, d, 0, 0, add_op(e));
+        }
+        else if (auto block = dynamic_cast<const Block_Op*>(&e)) {
+            statements(*block);
+            expr_to(*block->body_, d);
+        }
+        else if (auto x = dynamic_cast<const Do_Expr*>(&e)) {
+            emit(Bytecode::op_exec, 0, 0, 0, add_op(*x->actions_));
+            expr_to(*x->body_, d);
+        }
+        else if (!binary(e, d)) {
+            emit(Bytecode::op_eval, d, 0, 0, add_op(e));
+        }
+        next_temp_ = mark;
+    }
+
+    // Compile a boolean operand of && or ||, storing its value in slot d.
+    void bool_to(const Operation& e, slot_t d)
+    {
+        slot_t mark = next_temp_;
+        slot_t a = expr(e);
+        // Convert the value to a boolean, or report an error. The branch
+        // target is the next instruction.
+        emit(Bytecode::op_and, d, a, add_op(e), here()+1);
+        next_temp_ = mark;
+    }
+
+    template <class T>
+    static bool is(const Operation& e)
+    {
+        return dynamic_cast<const T*>(&e) != nullptr;
+    }
+
+    // Compile a binary operator, if 'e' is one.
+    bool binary(const Operation& e, slot_t d)
+    {
+        Bytecode::Opcode opc;
+        if (is<Add_Expr>(e)) opc = Bytecode::op_add;
+        else if (is<Subtract_Expr>(e)) opc = Bytecode::op_subtract;
+        else if (is<Multiply_Expr>(e)) opc = Bytecode::op_multiply;
+        else if (is<Divide_Expr>(e)) opc = Bytecode::op_divide;
+        else if (is<Power_Expr>(e)) opc = Bytecode::op_power;
+        else if (is<Equal_Expr>(e)) opc = Bytecode::op_equal;
+        else if (is<Not_Equal_Expr>(e)) opc = Bytecode::op_not_equal;
+        else if (is<Less_Expr>(e)) opc = Bytecode::op_less;
+        else if (is<Greater_Expr>(e)) opc = Bytecode::op_greater;
+        else if (is<Less_Or_Equal_Expr>(e))
+            opc = Bytecode::op_less_or_equal;
+        else if (is<Greater_Or_Equal_Expr>(e))
+            opc = Bytecode::op_greater_or_equal;
+        else
+            return false;
+        auto& x = static_cast<const Infix_Expr_Base&>(e);
+        slot_t a = expr(*x.arg1_);
+        slot_t b = expr(*x.arg2_);
+        emit(opc, d, a, b, add_op(e));
+        return true;
+    }
+
+    // Compile 'op' in tail position: return its value.
+    void tail(const Operation& e)
+    {
+        slot_t mark = next_temp_;
+        if (auto x = dynamic_cast<const If_Else_Op*>(&e)) {
+            slot_t d = temp();
+            slot_t a = expr(*x->arg1_);
+            size_t br = emit(Bytecode::op_if, d, a, add_op(e));
+            tail(*x->arg2_);
+            patch(br);
+            tail(*x->arg3_);
+        }
+        else if (auto call = dynamic_cast<const Call_Expr*>(&e)) {
+            slot_t a = expr(*call->func_);
+            slot_t b = expr(*call->arg_);
+            emit(Bytecode::op_tail_call, 0, a, b, add_op(e));
+        }
+        else if (auto block = dynamic_cast<const Block_Op*>(&e)) {
+            statements(*block);
+            tail(*block->body_);
+        }
+        else if (auto x = dynamic_cast<const Do_Expr*>(&e)) {
+            emit(Bytecode::op_exec, 0, 0, 0, add_op(*x->actions_));
+            tail(*x->body_);
+        }
+        else if (is_expr(e)) {
+            slot_t a = expr(e);
+            emit(Bytecode::op_return, 0, a);
+        }
+        else {
+            // Use Operation::tail_eval, which reports an error if this is
+            // not an expression.
+            emit(Bytecode::op_tail_eval, 0, 0, 0, add_op(e));
+        }
+        next_temp_ = mark;
+    }
+
+    // Compile the statements of a Block_Op.
+    void statements(const Block_Op& block)
+    {
+        auto& se = block.statements_;
+        if (se.module_slot_ != (slot_t)(-1)) {
+            emit(Bytecode::op_scope, 0, 0, 0, add_op(block));
+            return;
+        }
+        for (auto& action : se.actions_) {
+            auto setter = dynamic_cast<const Data_Setter*>(&*action);
+            if (setter && setter->module_slot_ == (slot_t)(-1)) {
+                slot_t mark = next_temp_;
+                slot_t a = expr(*setter->definiens_);
+                emit(Bytecode::op_define, 0, a, 0, add_op(*setter));
+                next_temp_ = mark;
+            } else
+                emit(Bytecode::op_exec, 0, 0, 0, add_op(*action));
+        }
+    }
+
+    // True if 'op' is an expression that is evaluated by 'eval', so that
+    // it generates exactly one value when executed as a statement.
+    static bool is_expr(const Operation& op)
+    {
+        return dynamic_cast<const Just_Expression*>(&op) != nullptr;
+    }
+};
+
+Bytecode::Bytecode(Shared<const Operation> body, slot_t nslots)
+:
+    Operation(body->syntax_),
+    source_(body),
+    nslots_(nslots)
+{
+    try {
+        Bytecode_Compiler c(*this, nslots);
+        c.tail(*body);
+    } catch (Bytecode_Overflow&) {
+        code_.clear();
+        constants_.clear();
+        ops_.clear();
+        nslots_ = nslots;
+        ops_.push_back(body);
+        code_.push_back({nullptr, op_tail_eval, 0, 0, 0, 0});
+    }
+#if CURV_THREADED_DISPATCH
+    const void* const* labels = bytecode_labels();
+    for (auto& instr : code_)
+        instr.label_ = labels[instr.op_];
+#endif
+}
+
+namespace {
+
+// The interpreter. Run the code on frame f. In eval mode (tail == nullptr),
+// return the result. Otherwise f is **tail, and a tail call replaces the frame
+// (so f must not be used afterwards). If code is nullptr, return the
+// table of dispatch addresses in *labels.
+Value
+interpret(
+    const Bytecode* code, Frame* fp, std::unique_ptr<Frame>* tail,
+    const void* const** labels)
+{
+#if CURV_THREADED_DISPATCH
+    static const void* const dispatch[Bytecode::num_opcodes] = {
+        &&L_op_constant, &&L_op_move, &&L_op_nonlocal, &&L_op_module_ref,
+        &&L_op_dot, &&L_op_eval, &&L_op_exec, &&L_op_scope, &&L_op_define,
+        &&L_op_negate, &&L_op_not,
+        &&L_op_add, &&L_op_subtract, &&L_op_multiply, &&L_op_divide,
+        &&L_op_power,
+        &&L_op_equal, &&L_op_not_equal, &&L_op_less, &&L_op_greater,
+        &&L_op_less_or_equal, &&L_op_greater_or_equal,
+        &&L_op_list, &&L_op_index, &&L_op_call, &&L_op_tail_call,
+        &&L_op_tail_eval, &&L_op_return, &&L_op_jump,
+        &&L_op_and, &&L_op_or, &&L_op_if
+    };
+    if (code == nullptr) {
+        *labels = dispatch;
+        return missing;
+    }
+    #define CASE(name) L_##name:
+    #define DISPATCH() goto *ip->label_
+#else
+    (void) labels;
+    #define CASE(name) case Bytecode::name:
+    #define DISPATCH() continue
+#endif
+    #define NEXT() { ++ip; DISPATCH(); }
+    #define JUMP(target) { ip = &begin[target]; DISPATCH(); }
+    #define CX At_Phrase(*ops[ip->k_]->syntax_, f)
+
+    Frame& f = *fp;
+    Value* slots = f.array_;
+    const Bytecode::Instr* begin = code->code_.data();
+    const Bytecode::Instr* ip = begin;
+    const Value* constants = code->constants_.data();
+    const Shared<const Operation>* ops = code->ops_.data();
+
+#if CURV_THREADED_DISPATCH
+    DISPATCH();
+    {
+#else
+    for (;;) switch (ip->op_) {
+#endif
+    CASE(op_constant)
+        slots[ip->d_] = constants[ip->k_];
+        NEXT();
+    CASE(op_move)
+        slots[ip->d_] = slots[ip->a_];
+        NEXT();
+    CASE(op_nonlocal)
+        slots[ip->d_] = f.nonlocals_->at(ip->k_);
+        NEXT();
+    CASE(op_module_ref)
+      {
+        Module& m = (Module&)slots[ip->a_].to_ref_unsafe();
+        assert(m.subtype_ == Ref_Value::sty_module);
+        slots[ip->d_] = m.at(ip->k_);
+        NEXT();
+      }
+    CASE(op_dot)
+      {
+        auto& dot = static_cast<const Dot_Expr&>(*ops[ip->k_]);
+        slots[ip->d_] = slots[ip->a_].at(dot.selector_.id_->symbol_,
+            At_Phrase(*dot.base_->syntax_, f));
+        NEXT();
+      }
+    CASE(op_eval)
+        slots[ip->d_] = ops[ip->k_]->eval(f);
+        NEXT();
+    CASE(op_exec)
+      {
+        Operation::Action_Executor aex;
+        ops[ip->k_]->exec(f, aex);
+        NEXT();
+      }
+    CASE(op_scope)
+        static_cast<const Block_Op&>(*ops[ip->k_]).statements_.exec(f);
+        NEXT();
+    CASE(op_define)
+      {
+        auto& setter = static_cast<const Data_Setter&>(*ops[ip->k_]);
+        setter.pattern_->exec(slots, slots[ip->a_],
+            At_Phrase(*setter.definiens_->syntax_, f), f);
+        NEXT();
+      }
+    CASE(op_negate)
+      {
+        Value& a = slots[ip->a_];
+        if (a.is_num())
+            slots[ip->d_] = Value{-a.to_num_unsafe()};
+        else
+            slots[ip->d_] = negate(a, CX);
+        NEXT();
+      }
+    CASE(op_not)
+      {
+        Value& a = slots[ip->a_];
+        if (a.is_bool())
+            slots[ip->d_] = Value{!a.to_bool_unsafe()};
+        else
+            slots[ip->d_] = eval_not(a, CX);
+        NEXT();
+      }
+
+    // A NaN result is a domain error, which is reported by the slow path.
+    #define ARITHMETIC(name, op, slow) \
+    CASE(name) \
+      { \
+        Value& a = slots[ip->a_]; \
+        Value& b = slots[ip->b_]; \
+        if (a.is_num() && b.is_num()) { \
+            double r = a.to_num_unsafe() op b.to_num_unsafe(); \
+            if (r == r) { \
+                slots[ip->d_] = Value{r}; \
+                NEXT(); \
+            } \
+        } \
+        slots[ip->d_] = slow(a, b, CX); \
+        NEXT(); \
+      }
+    ARITHMETIC(op_add, +, add)
+    ARITHMETIC(op_subtract, -, subtract)
+    ARITHMETIC(op_multiply, *, multiply)
+    ARITHMETIC(op_divide, /, divide)
+    #undef ARITHMETIC
+    CASE(op_power)
+      {
+        Value& a = slots[ip->a_];
+        Value& b = slots[ip->b_];
+        if (a.is_num() && b.is_num()) {
+            double r = pow(a.to_num_unsafe(), b.to_num_unsafe());
+            if (r == r) {
+                slots[ip->d_] = Value{r};
+                NEXT();
+            }
+        }
+        slots[ip->d_] = power(a, b, CX);
+        NEXT();
+      }
+    CASE(op_equal)
+        slots[ip->d_] = Value{slots[ip->a_].equal(slots[ip->b_], CX)};
+        NEXT();
+    CASE(op_not_equal)
+        slots[ip->d_] = Value{!slots[ip->a_].equal(slots[ip->b_], CX)};
+        NEXT();
+
+    // Only 2 comparisons are required to unbox two numbers and compare them.
+    #define RELATION(name, op, negop, opstr) \
+    CASE(name) \
+      { \
+        Value& a = slots[ip->a_]; \
+        Value& b = slots[ip->b_]; \
+        if (a.to_num_or_nan() op b.to_num_or_nan()) \
+            slots[ip->d_] = Value{true}; \
+        else if (a.to_num_or_nan() negop b.to_num_or_nan()) \
+            slots[ip->d_] = Value{false}; \
+        else \
+            throw Exception(CX, stringify(a, opstr, b, ": domain error")); \
+        NEXT(); \
+      }
+    RELATION(op_less, <, >=, " < ")
+    RELATION(op_greater, >, <=, " > ")
+    RELATION(op_less_or_equal, <=, >, " <= ")
+    RELATION(op_greater_or_equal, >=, <, " >= ")
+    #undef RELATION
+
+    CASE(op_list)
+      {
+        Shared<List> list = List::make(ip->b_);
+        for (unsigned i = 0; i < ip->b_; ++i)
+            (*list)[i] = slots[ip->a_ + i];
+        slots[ip->d_] = Value{list};
+        NEXT();
+      }
+    CASE(op_index)
+      {
+        Value& a = slots[ip->a_];
+        Value& b = slots[ip->b_];
+        if (a.is_ref() && b.is_num()) {
+            Ref_Value& r = a.to_ref_unsafe();
+            if (r.type_ == Ref_Value::ty_list) {
+                List& list = (List&)r;
+                double i = b.to_num_unsafe();
+                if (i >= 0 && i < list.size() && i == (unsigned)i) {
+                    slots[ip->d_] = list[(unsigned)i];
+                    NEXT();
+                }
+            }
+        }
+        Shared<List> index = List::make(1);
+        (*index)[0] = b;
+        slots[ip->d_] = call_func(a, Value{index}, ops[ip->k_]->syntax_, f);
+        NEXT();
+      }
+    CASE(op_call)
+        slots[ip->d_] = call_func(slots[ip->a_], slots[ip->b_],
+            ops[ip->k_]->syntax_, f);
+        NEXT();
+    CASE(op_tail_call)
+        if (tail) {
+            tail_call_func(slots[ip->a_], slots[ip->b_],
+                ops[ip->k_]->syntax_, *tail);
+            return missing;
+        }
+        return call_func(slots[ip->a_], slots[ip->b_],
+            ops[ip->k_]->syntax_, f);
+    CASE(op_tail_eval)
+        if (tail) {
+            ops[ip->k_]->tail_eval(*tail);
+            return missing;
+        }
+        return ops[ip->k_]->eval(f);
+    CASE(op_return)
+        if (tail) {
+            f.result_ = slots[ip->a_];
+            f.next_op_ = nullptr;
+            return missing;
+        }
+        return slots[ip->a_];
+    CASE(op_jump)
+        JUMP(ip->k_);
+    CASE(op_and)
+      {
+        bool b = slots[ip->a_].to_bool(At_Phrase(*ops[ip->b_]->syntax_, f));
+        slots[ip->d_] = Value{b};
+        if (!b) JUMP(ip->k_);
+        NEXT();
+      }
+    CASE(op_or)
+      {
+        bool b = slots[ip->a_].to_bool(At_Phrase(*ops[ip->b_]->syntax_, f));
+        slots[ip->d_] = Value{b};
+        if (b) JUMP(ip->k_);
+        NEXT();
+      }
+    CASE(op_if)
+      {
+        Value& a = slots[ip->a_];
+        if (a.is_bool()) {
+            if (a.to_bool_unsafe()) NEXT();
+            JUMP(ip->k_);
+        }
+        auto& ifelse = static_cast<const If_Else_Op&>(*ops[ip->b_]);
+        slots[ip->d_] = ifelse.reactive_eval(a, f);
+        const Bytecode::Instr& end = begin[ip->k_ - 1];
+        if (end.op_ == Bytecode::op_jump)
+            JUMP(end.k_);
+        if (tail) {
+            f.result_ = slots[ip->d_];
+            f.next_op_ = nullptr;
+            return missing;
+        }
+        return slots[ip->d_];
+      }
+    }
+    #undef CASE
+    #undef DISPATCH
+    #undef NEXT
+    #undef JUMP
+    #undef CX
+}
+
+} // namespace
+
+#if CURV_THREADED_DISPATCH
+static const void* const*
+bytecode_labels()
+{
+    static const void* const* labels = []{
+        const void* const* l = nullptr;
+        interpret(nullptr, nullptr, nullptr, &l);
+        return l;
+    }();
+    return labels;
+}
+#endif
+
+Value
+Bytecode::eval(Frame& f) const
+{
+    return interpret(this, &f, nullptr, nullptr);
+}
+
+void
+Bytecode::tail_eval(std::unique_ptr<Frame>& f) const
+{
+    interpret(this, &*f, &f, nullptr);
+}
+
+void
+Bytecode::exec(Frame& f, Executor& ex) const
+{
+    ex.push_value(eval(f), At_Phrase(*syntax_, f));
+}
+
+SC_Value
+Bytecode::sc_eval(SC_Frame& f) const
+{
+    return sc_eval_op(f, *source_);
+}
+
+static const char* opcode_names[Bytecode::num_opcodes] = {
+    "constant", "move", "nonlocal", "module_ref", "dot", "eval", "exec",
+    "scope", "define", "negate", "not",
+    "add", "subtract", "multiply", "divide", "power",
+    "equal", "not_equal", "less", "greater",
+    "less_or_equal", "greater_or_equal",
+    "list", "index", "call", "tail_call", "tail_eval", "return", "jump",
+    "and", "or", "if"
+};
+
+void
+Bytecode::dump(std::ostream& out) const
+{
+    out << "nslots " << nslots_ << "\n";
+    for (size_t i = 0; i < code_.size(); ++i) {
+        auto& in = code_[i];
+        out << i << ": " << opcode_names[in.op_]
+            << " d" << in.d_ << " a" << in.a_ << " b" << in.b_
+            << " k" << in.k_ << "\n";
+    }
+}
+
+void
+use_bytecode(Closure& c, Shared<Operation>& code)
+{
+    // The bytecode is cached in a Lambda_Expr, which may be shared by
+    // closures constructed concurrently (see Thread_Shared_Scope).
+    static std::mutex mutex;
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    if (is_thread_shared())
+        lock.lock();
+    if (code == nullptr)
+        code = make<Bytecode>(c.expr_, c.nslots_);
+    c.expr_ = code;
+    c.nslots_ = static_cast<const Bytecode&>(*code).nslots_;
+}
+
+} // namespace curv
@@ -0,0 +1,126 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#ifndef LIBCURV_BYTECODE_H
+#define LIBCURV_BYTECODE_H
+
+#include <libcurv/meaning.h>
+#include <cstdint>
+#include <vector>
+
+namespace curv {
+
+struct Closure;
+
+/// The body of a function, compiled to code for a register machine.
+///
+/// The registers are Frame slots. Local variables are accessed in place,
+/// and intermediate results are stored in temporary slots that follow the
+/// slots allocated by the analyser, so a Bytecode needs a larger call frame
+/// (nslots_) than the Operation tree it was compiled from.
+///
+/// Bytecode is an alternative executable representation of an Operation
+/// tree: it is used by the evaluator when System::use_bytecode_ is set.
+/// Operations that the compiler doesn't handle are embedded in the code,
+/// and evaluated by the tree walking interpreter. The Shape Compiler
+/// uses the original Operation tree.
+///
+/// The dispatch loop uses direct threaded code when compiled with gcc
+/// or clang (which support 'labels as values'), otherwise it uses a switch.
+///
+/// This is experimental, and opt-in. It is not yet faster than the tree
+/// walker overall: it wins on calls to scalar functions (the `map`
+/// benchmark in bench/eval.cc), is no faster on `fib` and tail recursion,
+/// and is slower on list arithmetic (the `array_op` benchmarks).
+struct Bytecode : public Operation
+{
+    enum Opcode : uint16_t
+    {
+        // f[d] = constants_[k]
+        op_constant,
+        // f[d] = f[a]
+        op_move,
+        // f[d] = nonlocals[k]
+        op_nonlocal,
+        // f[d] = (module f[a])[k]
+        op_module_ref,
+        // f[d] = (f[a]).(symbol in Dot_Expr ops_[k])
+        op_dot,
+        // f[d] = ops_[k]->eval(f)
+        op_eval,
+        // ops_[k]->exec(f): execute an action
+        op_exec,
+        // execute the statements of the Block_Op ops_[k]
+        op_scope,
+        // match f[a] against the pattern of the Data_Setter ops_[k]
+        op_define,
+        // f[d] = op f[a], using ops_[k] for error context
+        op_negate, op_not,
+        // f[d] = f[a] op f[b], using ops_[k] for error context
+        op_add, op_subtract, op_multiply, op_divide, op_power,
+        op_equal, op_not_equal, op_less, op_greater,
+        op_less_or_equal, op_greater_or_equal,
+        // f[d] = [f[a], ..., f[a+b-1]]
+        op_list,
+        // f[d] = f[a] [f[b]], using Call_Expr ops_[k]
+        op_index,
+        // f[d] = f[a] f[b], using Call_Expr ops_[k]
+        op_call,
+        // return f[a] f[b] as a tail call, using Call_Expr ops_[k]
+        op_tail_call,
+        // return ops_[k] evaluated by the tree walker, as a tail call
+        op_tail_eval,
+        // return f[a]
+        op_return,
+        // goto k
+        op_jump,
+        // f[d] = bool f[a]; if not f[d] goto k. ops_[b] is the error context.
+        op_and,
+        // f[d] = bool f[a]; if f[d] goto k. ops_[b] is the error context.
+        op_or,
+        // if f[a] is false goto k; ops_[b] is an If_Else_Op. If f[a] is
+        // a reactive value, then f[d] = the reactive result, and we goto
+        // the target of the jump at k-1 (the end of the If_Else_Op), or
+        // we return f[d] if the If_Else_Op is in tail position.
+        op_if
+    };
+    static constexpr int num_opcodes = op_if + 1;
+
+    struct Instr
+    {
+        const void* label_; // dispatch address, when using threaded code
+        Opcode op_;
+        uint16_t d_, a_, b_;
+        uint32_t k_;
+    };
+
+    std::vector<Instr> code_;
+    std::vector<Value> constants_;
+    std::vector<Shared<const Operation>> ops_;
+
+    // The Operation tree that this code was compiled from.
+    Shared<const Operation> source_;
+
+    // Size of the call frame: analyser slots plus temporaries.
+    slot_t nslots_;
+
+    // Compile the body of a function, whose call frame has 'nslots' slots.
+    Bytecode(Shared<const Operation> body, slot_t nslots);
+
+    virtual Value eval(Frame&) const override;
+    virtual void tail_eval(std::unique_ptr<Frame>&) const override;
+    virtual void exec(Frame&, Executor&) const override;
+    virtual SC_Value sc_eval(SC_Frame&) const override;
+
+    // Print a disassembly, for debugging.
+    void dump(std::ostream&) const;
+};
+
+// Replace the body of a Closure with bytecode. The bytecode is compiled on
+// first use, then cached in 'code', which is a member of the Lambda_Expr or
+// Lambda that the Closure was constructed from.
+void use_bytecode(Closure&, Shared<Operation>& code);
+
+} // namespace curv
+#endif // header guard
@@ -174,6 +174,35 @@ Recursive_Scope::analyse()
             (*d)[b.first] = b.second.slot_index_;
         executable_.module_dictionary_ = d;
     }
+
+    // The definitions may be executed in parallel if the scope is executed
+    // at most once per evaluation of its source file, and it contains no
+    // action statements, which must be executed in order.
+    if (action_phrases_.empty() && is_top_level()
+        && executable_.actions_.size() > 1)
+    {
+        if (!target_is_module_) {
+            // The frame slots initialized by each action.
+            executable_.action_slots_.resize(executable_.actions_.size());
+            for (auto b : dictionary_) {
+                executable_.action_slots_[units_[b.second.unit_index_].action_]
+                    .push_back(b.second.slot_index_);
+            }
+        }
+    } else
+        executable_.action_deps_.clear();
+}
+
+// True if the scope is nested only inside of other recursive scopes,
+// and not inside of a function or a loop.
+bool
+Recursive_Scope::is_top_level() const
+{
+    for (Environ* e = parent_; e->parent_ != nullptr; e = e->parent_) {
+        if (dynamic_cast<Recursive_Scope*>(e) == nullptr)
+            return false;
+    }
+    return true;
 }
 
 // Analyse the unitary definition `unit` that belongs to the scope,
@@ -243,8 +272,8 @@ Recursive_Scope::analyse_unit(Unit& unit, const Identifier* id)
             assert(scc_stack_.back() == &unit);
             scc_stack_.pop_back();
             unit.state_ = Unit::k_analysed;
-            executable_.actions_.push_back(
-                unit.def_->make_setter(executable_.module_slot_));
+            Unit* u = &unit;
+            add_setter(unit.def_->make_setter(executable_.module_slot_), 1, &u);
         } else {
             // Output a Function_Setter to initialize the slots for a group of
             // mutually recursive functions, or a single nonrecursive function.
@@ -254,8 +283,9 @@ Recursive_Scope::analyse_unit(Unit& unit, const Identifier* id)
                 ++ui;
             assert(scc_stack_[ui] == &unit);
 
-            executable_.actions_.push_back(
-                make_function_setter(scc_stack_.size()-ui, &scc_stack_[ui]));
+            size_t nunits = scc_stack_.size() - ui;
+            add_setter(make_function_setter(nunits, &scc_stack_[ui]),
+                nunits, &scc_stack_[ui]);
             Unit* u;
             do {
                 assert(scc_stack_.size() > 0);
@@ -268,6 +298,30 @@ Recursive_Scope::analyse_unit(Unit& unit, const Identifier* id)
     }
 }
 
+// Output an action that initializes the bindings of an SCC of units,
+// and record which earlier actions it depends on.
+void
+Recursive_Scope::add_setter(
+    Shared<const Operation> setter, size_t nunits, Unit** units)
+{
+    unsigned action = executable_.actions_.size();
+    executable_.actions_.push_back(setter);
+    for (size_t u = 0; u < nunits; ++u)
+        units[u]->action_ = action;
+    std::vector<unsigned> deps;
+    for (size_t u = 0; u < nunits; ++u) {
+        for (unsigned d : units[u]->deps_) {
+            unsigned a = units_[d].action_;
+            if (a != action
+                && std::find(deps.begin(), deps.end(), a) == deps.end())
+            {
+                deps.push_back(a);
+            }
+        }
+    }
+    executable_.action_deps_.push_back(std::move(deps));
+}
+
 Shared<Operation>
 Recursive_Scope::make_function_setter(size_t nunits, Unit** units)
 {
@@ -320,6 +374,8 @@ Recursive_Scope::single_lookup(const Identifier& id)
 {
     auto b = dictionary_.find(id.symbol_);
     if (b != dictionary_.end()) {
+        if (!analysis_stack_.empty())
+            analysis_stack_.back()->deps_.push_back(b->second.unit_index_);
         analyse_unit(units_[b->second.unit_index_], &id);
         if (target_is_module_) {
             return make<Module_Data_Ref>(
@@ -172,6 +172,10 @@ struct Recursive_Scope : public Scope
         int scc_ord_ = -1; // -1 until SCC assigned
         int scc_lowlink_ = -1;
         Symbol_Map<Shared<Operation>> nonlocals_ = {};
+        // the units referenced by this unit's definition
+        std::vector<unsigned> deps_ = {};
+        // index of the action that initializes this unit, once analysed
+        unsigned action_ = 0;
 
         Unit(Shared<Unitary_Definition> def) : def_(def) {}
 
@@ -232,6 +236,8 @@ struct Recursive_Scope : public Scope
 private:
     void analyse_unit(Unit&, const Identifier*);
     Shared<Operation> make_function_setter(size_t nunits, Unit** units);
+    void add_setter(Shared<const Operation>, size_t nunits, Unit** units);
+    bool is_top_level() const;
 };
 
 Shared<Module_Expr> analyse_module(Definition&, Environ&);
@@ -9,6 +9,7 @@
 #include <libcurv/import.h>
 #include <cstdlib>
 #include <iostream>
+#include <mutex>
 
 namespace curv {
 
@@ -88,13 +89,35 @@ void Dir_Record::print(std::ostream& out) const
     out << "}";
 }
 
+// Import a file that is a field of a directory record.
+static Value import_file(const Dir_Record::File& file, const Context& cx)
+{
+    Value val = file.importer_(file.path_, cx);
+    if (file.importer_ != curv_import && file.importer_ != dir_import)
+        record_import(cx.system(), file.path_);
+    return val;
+}
+
+namespace {
+// Fields are imported on first use, which modifies the Dir_Record. When
+// Values are shared between threads, this is done while holding a lock.
+// The mutex is recursive, since importing a file may load another field.
+std::recursive_mutex load_mutex;
+struct Load_Lock
+{
+    std::unique_lock<std::recursive_mutex> lock_{load_mutex, std::defer_lock};
+    Load_Lock() { if (is_thread_shared()) lock_.lock(); }
+};
+}
+
 Value Dir_Record::find_field(Symbol_Ref sym, const Context& cx) const
 {
     auto p = fields_.find(sym);
     if (p == fields_.end())
         return missing;
+    Load_Lock lock;
     if (p->second.value_.is_missing())
-        p->second.value_ = p->second.importer_(p->second.path_, cx);
+        p->second.value_ = import_file(p->second, cx);
     return p->second.value_;
 }
 
@@ -122,9 +145,10 @@ Dir_Record::ref_field(Symbol_Ref name, bool need_value, const Context& cx)
         throw Exception(cx, stringify(Value{share(*this)},
             " has no field named ", name));
     }
+    Load_Lock lock;
     if (p->second.value_.is_missing()) {
         if (need_value)
-            p->second.value_ = p->second.importer_(p->second.path_, cx);
+            p->second.value_ = import_file(p->second, cx);
     }
     return &p->second.value_;
 }
@@ -144,6 +168,7 @@ Dir_Record::Iter::Iter(const Dir_Record& rec)
     i_{rec.fields_.begin()}
 {
     if (i_ != rec_.fields_.end()) {
+        Load_Lock lock;
         key_ = i_->first;
         value_ = i_->second.value_;
     }
@@ -152,8 +177,9 @@ Dir_Record::Iter::Iter(const Dir_Record& rec)
 void Dir_Record::Iter::load_value(const Context& cx)
 {
     if (i_ != rec_.fields_.end()) {
+        Load_Lock lock;
         if (i_->second.value_.is_missing())
-            i_->second.value_ = i_->second.importer_(i_->second.path_, cx);
+            i_->second.value_ = import_file(i_->second, cx);
         value_ = i_->second.value_;
     }
 }
@@ -162,6 +188,7 @@ void Dir_Record::Iter::next()
 {
     ++i_;
     if (i_ != rec_.fields_.end()) {
+        Load_Lock lock;
         key_ = i_->first;
         value_ = i_->second.value_;
     } else
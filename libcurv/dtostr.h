@@ -51,5 +51,10 @@ constexpr int DTOSTR_BUFSIZE = 32;
 /// when read using strtod, reconstructs the original number exactly.
 void dtostr(double, char[DTOSTR_BUFSIZE], dfmt::style = dfmt::C);
 
+/// Format a float as the shortest decimal string that, when read using
+/// strtof, reconstructs the original number exactly. Eg, 0.1f prints as
+/// "0.1", not "0.10000000149011612". The format is otherwise like dtostr.
+void ftostr(float, char[DTOSTR_BUFSIZE], dfmt::style = dfmt::C);
+
 } // namespace curv
 #endif // header guard
@@ -3,6 +3,7 @@
 // See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
 
 #include <libcurv/meaning.h>
+#include <libcurv/bytecode.h>
 #include <libcurv/string.h>
 #include <libcurv/exception.h>
 #include <libcurv/function.h>
@@ -10,6 +11,7 @@
 #include <libcurv/record.h>
 #include <libcurv/module.h>
 #include <libcurv/context.h>
+#include <libcurv/system.h>
 #include <libcurv/array_op.h>
 #include <cmath>
 #include <libcurv/math.h>
@@ -126,29 +128,6 @@ Dot_Expr::eval(Frame& f) const
     return basev.at(id, At_Phrase(*base_->syntax_, f));
 }
 
-Value
-eval_not(Value x, const At_Syntax& cx)
-{
-    if (x.is_bool())
-        return {!x.to_bool_unsafe()};
-    if (auto xlist = x.dycast<List>()) {
-        Shared<List> result = List::make(xlist->size());
-        for (unsigned i = 0; i < xlist->size(); ++i)
-            (*result)[i] = eval_not((*xlist)[i], cx);
-        return {result};
-    }
-    auto re = x.dycast<Reactive_Value>();
-    if (re && re->sctype_ == SC_Type::Bool()) {
-        return {make<Reactive_Expression>(
-            SC_Type::Bool(),
-            make<Not_Expr>(
-                share(cx.syntax()),
-                make<Constant>(share(cx.syntax()), x)
-            ),
-            cx)};
-    }
-    throw Exception(cx, stringify("!",x,": domain error"));
-}
 Value
 Not_Expr::eval(Frame& f) const
 {
@@ -174,18 +153,7 @@ Positive_Expr::eval(Frame& f) const
 Value
 Negative_Expr::eval(Frame& f) const
 {
-    struct Scalar_Op {
-        static double call(double x) { return -x; }
-        Shared<Operation> make_expr(Shared<Operation> x) const
-        {
-            return make<Negative_Expr>(share(cx.syntax()), std::move(x));
-        }
-        static auto callstr(Value x) { return stringify("-",x); }
-        At_Phrase cx;
-        Scalar_Op(const Phrase& ph, Frame& f) : cx(ph,f) {}
-    };
-    static Unary_Numeric_Array_Op<Scalar_Op> array_op;
-    return array_op.op(Scalar_Op(*syntax_, f), arg_->eval(f));
+    return negate(arg_->eval(f), At_Phrase(*syntax_, f));
 }
 
 Value
@@ -198,25 +166,9 @@ Add_Expr::eval(Frame& f) const
 Value
 Subtract_Expr::eval(Frame& f) const
 {
-    struct Scalar_Op {
-        static double call(double x, double y) { return x - y; }
-        Shared<Operation> make_expr(
-            Shared<Operation> x, Shared<Operation> y) const
-        {
-            return make<Subtract_Expr>(share(cx.syntax()),
-                std::move(x), std::move(y));
-        }
-        static const char* name() { return "-"; }
-        static Shared<const String> callstr(Value x, Value y) {
-            return stringify(x," - ",y);
-        }
-        At_Phrase cx;
-        Scalar_Op(const Phrase& ph, Frame& fr) : cx(ph,fr) {}
-    };
-    static Binary_Numeric_Array_Op<Scalar_Op> array_op;
     Value a = arg1_->eval(f);
     Value b = arg2_->eval(f);
-    return array_op.op(Scalar_Op(*syntax_, f), a, b);
+    return subtract(a,b, At_Phrase(*syntax_, f));
 }
 Value
 Multiply_Expr::eval(Frame& f) const
@@ -228,25 +180,9 @@ Multiply_Expr::eval(Frame& f) const
 Value
 Divide_Expr::eval(Frame& f) const
 {
-    struct Scalar_Op {
-        static double call(double x, double y) { return x / y; }
-        Shared<Operation> make_expr(
-            Shared<Operation> x, Shared<Operation> y) const
-        {
-            return make<Divide_Expr>(share(cx.syntax()),
-                std::move(x), std::move(y));
-        }
-        static const char* name() { return "/"; }
-        static Shared<const String> callstr(Value x, Value y) {
-            return stringify(x," / ",y);
-        }
-        At_Phrase cx;
-        Scalar_Op(const Phrase& ph, Frame& fr) : cx(ph,fr) {}
-    };
-    static Binary_Numeric_Array_Op<Scalar_Op> array_op;
     Value a = arg1_->eval(f);
     Value b = arg2_->eval(f);
-    return array_op.op(Scalar_Op(*syntax_, f), a, b);
+    return divide(a,b, At_Phrase(*syntax_, f));
 }
 
 Value
@@ -293,21 +229,7 @@ If_Else_Op::eval(Frame& f) const
         else
             return arg3_->eval(f);
     }
-    auto re = cond.dycast<Reactive_Value>();
-    if (re && re->sctype_ == SC_Type::Bool()) {
-        Value a2 = arg2_->eval(f);
-        Value a3 = arg3_->eval(f);
-        return {make<Reactive_Expression>(
-            sc_type_join(sc_type_of(a2), sc_type_of(a3)),
-            make<If_Else_Op>(
-                share(*syntax_),
-                make<Constant>(share(*arg1_->syntax_), cond),
-                make<Constant>(share(*arg2_->syntax_), a2),
-                make<Constant>(share(*arg3_->syntax_), a3)
-            ),
-            At_Phrase(*syntax_, f))};
-    }
-    throw Exception(cx, stringify(cond, " is not a boolean"));
+    return reactive_eval(cond, f);
 }
 void
 If_Else_Op::tail_eval(std::unique_ptr<Frame>& f) const
@@ -321,11 +243,17 @@ If_Else_Op::tail_eval(std::unique_ptr<Frame>& f) const
             f->next_op_ = &*arg3_;
         return;
     }
+    f->result_ = reactive_eval(cond, *f);
+    f->next_op_ = nullptr;
+}
+Value
+If_Else_Op::reactive_eval(Value cond, Frame& f) const
+{
     auto re = cond.dycast<Reactive_Value>();
     if (re && re->sctype_ == SC_Type::Bool()) {
-        Value a2 = arg2_->eval(*f);
-        Value a3 = arg3_->eval(*f);
-        f->result_ = Value{make<Reactive_Expression>(
+        Value a2 = arg2_->eval(f);
+        Value a3 = arg3_->eval(f);
+        return {make<Reactive_Expression>(
             sc_type_join(sc_type_of(a2), sc_type_of(a3)),
             make<If_Else_Op>(
                 share(*syntax_),
@@ -333,11 +261,10 @@ If_Else_Op::tail_eval(std::unique_ptr<Frame>& f) const
                 make<Constant>(share(*arg2_->syntax_), a2),
                 make<Constant>(share(*arg3_->syntax_), a3)
             ),
-            At_Phrase(*syntax_, *f))};
-        f->next_op_ = nullptr;
-        return;
+            At_Phrase(*syntax_, f))};
     }
-    throw Exception(cx, stringify(cond, " is not a boolean"));
+    throw Exception(At_Phrase(*arg1_->syntax_, f),
+        stringify(cond, " is not a boolean"));
 }
 void
 If_Else_Op::exec(Frame& f, Executor& ex) const
@@ -418,23 +345,9 @@ Greater_Or_Equal_Expr::eval(Frame& f) const
 Value
 Power_Expr::eval(Frame& f) const
 {
-    struct Scalar_Op {
-        static double call(double x, double y) { return pow(x,y); }
-        Shared<Operation> make_expr(
-            Shared<Operation> x, Shared<Operation> y) const
-        {
-            return make<Power_Expr>(share(cx.syntax()),
-                std::move(x), std::move(y));
-        }
-        static const char* name() { return "^"; }
-        static Shared<const String> callstr(Value x, Value y) {
-            return stringify(x," ^ ",y);
-        }
-        At_Phrase cx;
-        Scalar_Op(const Phrase& ph, Frame& fr) : cx(ph, fr) {}
-    };
-    static Binary_Numeric_Array_Op<Scalar_Op> array_op;
-    return array_op.op(Scalar_Op(*syntax_, f), arg1_->eval(f), arg2_->eval(f));
+    Value a = arg1_->eval(f);
+    Value b = arg2_->eval(f);
+    return power(a,b, At_Phrase(*syntax_, f));
 }
 
 Value
@@ -546,7 +459,8 @@ call_func(Value func, Value arg, Shared<const Phrase> call_phrase, Frame& f)
           {
             Function* fun = (Function*)&funp;
             std::unique_ptr<Frame> f2 {
-                Frame::make(fun->nslots_, f.system_, &f, call_phrase, nullptr)
+                make_call_frame(
+                    fun->nslots_, f.system_, &f, call_phrase, nullptr)
             };
             f2->func_ = share(*fun);
             fun->tail_call(arg, f2);
@@ -595,9 +509,13 @@ tail_call_func(
         case Ref_Value::ty_function:
           {
             Function* fun = (Function*)&funp;
-            f = Frame::make(
-                fun->nslots_, f->system_, f->parent_frame_,
-                call_phrase, nullptr);
+            // Destroy the caller's frame before making the new one, so that
+            // the new frame reuses its space on the frame stack.
+            System& sys = f->system_;
+            Frame* parent = f->parent_frame_;
+            f = nullptr;
+            f = make_call_frame(
+                fun->nslots_, sys, parent, call_phrase, nullptr);
             f->func_ = share(*fun);
             fun->tail_call(arg, f);
             return;
@@ -644,8 +562,12 @@ Call_Expr::tail_eval(std::unique_ptr<Frame>& f) const
 Shared<List>
 List_Expr_Base::eval_list(Frame& f) const
 {
-    // TODO: if the # of elements generated is known at compile time,
-    // then the List could be constructed directly without using a std::vector.
+    if (fixed_size_) {
+        Shared<List> list = List::make(this->size());
+        for (size_t i = 0; i < this->size(); ++i)
+            (*list)[i] = (*this)[i]->eval(f);
+        return list;
+    }
     List_Builder lb;
     List_Executor lex(lb);
     for (size_t i = 0; i < this->size(); ++i)
@@ -703,6 +625,8 @@ Scope_Executable::eval_module(Frame& f) const
     Shared<Module> module =
         Module::make(module_dictionary_->size(), module_dictionary_);
     f[module_slot_] = {module};
+    if (exec_parallel(f))
+        return module;
     Operation::Action_Executor aex;
     for (auto action : actions_)
         action->exec(f, aex);
@@ -713,7 +637,7 @@ Scope_Executable::exec(Frame& f) const
 {
     if (module_slot_ != (slot_t)(-1)) {
         (void) eval_module(f);
-    } else {
+    } else if (!exec_parallel(f)) {
         Operation::Action_Executor aex;
         for (auto action : actions_) {
             action->exec(f, aex);
@@ -756,7 +680,7 @@ Dot_Locative::reference(Frame& f, bool need_value) const
 {
     Value* base = base_->reference(f,true);
     Shared<Record> base_rec = base->to<Record>(At_Phrase(*base_->syntax_, f));
-    if (base_rec->use_count > 1) {
+    if (load_use_count(*base_rec) > 1) {
         base_rec = base_rec->clone();
         *base = {base_rec};
     }
@@ -769,7 +693,7 @@ Indexed_Locative::reference(Frame& f, bool need_value) const
 {
     Value* base = base_->reference(f,true);
     Shared<List> base_list = base->to<List>(At_Phrase(*base_->syntax_, f));
-    if (base_list->use_count > 1) {
+    if (load_use_count(*base_list) > 1) {
         base_list = base_list->clone();
         *base = {base_list};
     }
@@ -862,6 +786,18 @@ For_Op::exec(Frame& f, Executor& ex) const
 {
     At_Phrase cx{*list_->syntax_, f};
     At_Index icx{0, cx};
+    if (range_) {
+        double first, step;
+        unsigned count = range_->eval_count(f, first, step);
+        for (unsigned i = 0; i < count; ++i) {
+            icx.index_ = i;
+            pattern_->exec(f.array_, Value{first + step*i}, icx, f);
+            if (cond_ && !cond_->eval(f).to_bool(At_Phrase{*cond_->syntax_,f}))
+                break;
+            body_->exec(f, ex);
+        }
+        return;
+    }
     auto list = list_->eval(f).to<List>(cx);
     for (size_t i = 0; i < list->size(); ++i) {
         icx.index_ = i;
@@ -875,15 +811,25 @@ For_Op::exec(Frame& f, Executor& ex) const
 Value
 Range_Expr::eval(Frame& f) const
 {
-    List_Builder lb;
+    double first, step;
+    unsigned count = eval_count(f, first, step);
+    Shared<List> list = List::make(count);
+    for (unsigned i = 0; i < count; ++i)
+        (*list)[i] = Value{first + step*i};
+    return {list};
+}
+
+unsigned
+Range_Expr::eval_count(Frame& f, double& first, double& step) const
+{
     Value firstv = arg1_->eval(f);
-    double first = firstv.to_num_or_nan();
+    first = firstv.to_num_or_nan();
 
     Value lastv = arg2_->eval(f);
     double last = lastv.to_num_or_nan();
 
     Value stepv;
-    double step = 1.0;
+    step = 1.0;
     if (arg3_) {
         stepv = arg3_->eval(f);
         step = stepv.to_num_or_nan();
@@ -894,20 +840,15 @@ Range_Expr::eval(Frame& f) const
     // Note: countd could be infinity. It could be too large to fit in an
     // integer. It could be a float integer too large to increment (for large
     // float i, i==i+1). So we impose a limit on the count.
-    if (countd < 1'000'000'000.0) {
-        unsigned count = (unsigned) countd;
-        for (unsigned i = 0; i < count; ++i)
-            lb.push_back(Value{first + step*i});
-    } else {
-        const char* err =
-            (countd == countd ? "too many elements in range" : "domain error");
-        const char* dots = (half_open_ ? " ..< " : " .. ");
-        throw Exception(At_Phrase(*syntax_, f),
-            arg3_
-                ? stringify(firstv,dots,lastv," by ",stepv,": ", err)
-                : stringify(firstv,dots,lastv,": ", err));
-    }
-    return {lb.get_list()};
+    if (countd < 1'000'000'000.0)
+        return (unsigned) countd;
+    const char* err =
+        (countd == countd ? "too many elements in range" : "domain error");
+    const char* dots = (half_open_ ? " ..< " : " .. ");
+    throw Exception(At_Phrase(*syntax_, f),
+        arg3_
+            ? stringify(firstv,dots,lastv," by ",stepv,": ", err)
+            : stringify(firstv,dots,lastv,": ", err));
 }
 
 Value
@@ -920,6 +861,8 @@ Lambda_Expr::eval(Frame& f) const
         nslots_);
     c->name_ = name_;
     c->argpos_ = argpos_;
+    if (f.system_.use_bytecode_)
+        use_bytecode(*c, code_);
     return Value{c};
 }
 
@@ -1010,8 +953,12 @@ Function_Setter_Base::exec(Frame& f, Executor&) const
         slots = &m->at(0);
     }
     Shared<Module> nonlocals = nonlocals_->eval_module(f);
-    for (auto& e : *this)
-        slots[e.slot_] = {make<Closure>(*e.lambda_, *nonlocals)};
+    for (auto& e : *this) {
+        auto c = make<Closure>(*e.lambda_, *nonlocals);
+        if (f.system_.use_bytecode_)
+            use_bytecode(*c, e.lambda_->code_);
+        slots[e.slot_] = {c};
+    }
 }
 
 void
@@ -1053,7 +1000,7 @@ Parametric_Expr::eval(Frame& f) const
         throw Exception(cx, "internal error in Parametric_Expr");
     Shared<const Phrase> call_phrase = syntax_; // TODO?
     std::unique_ptr<Frame> f2 {
-        Frame::make(closure->nslots_, f.system_, &f, call_phrase, nullptr)
+        make_call_frame(closure->nslots_, f.system_, &f, call_phrase, nullptr)
     };
     auto default_arg = record_pattern_default_value(*closure->pattern_,*f2);
     Value res = closure->call({default_arg}, *f2);
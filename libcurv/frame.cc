@@ -6,6 +6,7 @@
 
 #include <libcurv/function.h>
 #include <libcurv/phrase.h>
+#include <algorithm>
 
 namespace curv {
 
@@ -18,4 +19,137 @@ Frame_Base::Frame_Base(
     nonlocals_(nl)
 {}
 
+namespace {
+
+// Each frame is preceded by a header, which records how it was allocated.
+// The header size preserves the 16 byte alignment of the frame.
+struct alignas(16) Frame_Header
+{
+    enum State : unsigned { heap, live, released };
+
+    // For a frame on the frame stack, the previous frame on the stack.
+    Frame_Header* prev_;
+    State state_;
+};
+
+// A stack of frames, allocated from a linked list of large chunks.
+// Frames are usually released in LIFO order, which pops the stack.
+// A frame released out of order is marked as released, and the memory
+// is reclaimed when the frames above it are popped.
+struct Frame_Stack
+{
+    static constexpr size_t chunk_size = 64 * 1024;
+
+    struct alignas(16) Chunk
+    {
+        Chunk* prev_;
+        char* saved_top_; // top_ of the previous chunk
+        size_t size_;
+
+        char* data() { return (char*)(this + 1); }
+        char* end() { return (char*)this + size_; }
+    };
+
+    Chunk* chunk_ = nullptr;
+    // The most recently emptied chunk is kept, so that a sequence of calls
+    // and returns across a chunk boundary doesn't call malloc and free.
+    Chunk* spare_ = nullptr;
+    char* top_ = nullptr;
+    Frame_Header* last_ = nullptr;
+
+    ~Frame_Stack()
+    {
+        while (chunk_ != nullptr) {
+            Chunk* c = chunk_;
+            chunk_ = c->prev_;
+            free(c);
+        }
+        free(spare_);
+    }
+
+    void* allocate(size_t size)
+    {
+        size_t total = sizeof(Frame_Header) + (size + 15) / 16 * 16;
+        if (chunk_ == nullptr || size_t(chunk_->end() - top_) < total)
+            push_chunk(total);
+        auto h = (Frame_Header*)top_;
+        h->prev_ = last_;
+        h->state_ = Frame_Header::live;
+        last_ = h;
+        top_ += total;
+        return h + 1;
+    }
+
+    void push_chunk(size_t total)
+    {
+        size_t size = std::max(chunk_size, sizeof(Chunk) + total);
+        Chunk* c;
+        if (spare_ != nullptr && spare_->size_ >= size) {
+            c = spare_;
+            spare_ = nullptr;
+        } else {
+            c = (Chunk*)malloc(size);
+            if (c == nullptr)
+                throw std::bad_alloc();
+            c->size_ = size;
+        }
+        c->prev_ = chunk_;
+        c->saved_top_ = top_;
+        chunk_ = c;
+        top_ = c->data();
+    }
+
+    void release(Frame_Header* h) noexcept
+    {
+        h->state_ = Frame_Header::released;
+        while (last_ != nullptr && last_->state_ == Frame_Header::released) {
+            Frame_Header* top = last_;
+            last_ = top->prev_;
+            top_ = (char*)top;
+            if (top_ == chunk_->data()) {
+                Chunk* c = chunk_;
+                chunk_ = c->prev_;
+                top_ = c->saved_top_;
+                free(spare_);
+                spare_ = c;
+            }
+        }
+    }
+};
+
+thread_local Frame_Stack frame_stack;
+
+} // namespace
+
+void*
+Frame_Allocator::allocate(size_t size) noexcept
+{
+    auto h = (Frame_Header*)malloc(sizeof(Frame_Header) + size);
+    if (h == nullptr)
+        return nullptr;
+    h->prev_ = nullptr;
+    h->state_ = Frame_Header::heap;
+    return h + 1;
+}
+
+void
+Frame_Allocator::deallocate(void* p) noexcept
+{
+    auto h = (Frame_Header*)p - 1;
+    if (h->state_ == Frame_Header::heap)
+        free(h);
+    else
+        frame_stack.release(h);
+}
+
+std::unique_ptr<Frame>
+make_call_frame(
+    slot_t nslots, System& sys, Frame* parent, Shared<const Phrase> call_phrase,
+    Module* nonlocals)
+{
+    return Frame::make_using(
+        [](size_t size)->void* { return frame_stack.allocate(size); },
+        nslots, sys, parent, std::move(call_phrase), nonlocals);
+}
+
 } // namespaces
@@ -27,7 +27,16 @@ struct System;
 /// A program (source file) has a frame for evaluating the top level
 /// program expression.
 /// Calls to builtin and user-defined functions have call frames.
-using Frame = Tail_Array<Frame_Base>;
+///
+/// Function call frames are created and destroyed in LIFO order, so they are
+/// allocated from a per-thread stack of memory chunks (see make_call_frame),
+/// and a function call doesn't call malloc. Other frames are heap allocated.
+struct Frame_Allocator
+{
+    static void* allocate(size_t) noexcept;
+    static void deallocate(void*) noexcept;
+};
+using Frame = Tail_Array<Frame_Base, Frame_Allocator>;
 
 struct Frame_Base
 {
@@ -90,5 +99,17 @@ struct Frame_Base
 
 Value tail_eval_frame(std::unique_ptr<Frame>);
 
+/// Make a function call frame, allocated on the current thread's frame stack.
+///
+/// The frame must be destroyed by the same thread, before (or shortly after)
+/// any call frames created after it. A frame destroyed out of order isn't
+/// reused until the frames above it are destroyed.
+/// Use Frame::make for frames that escape: a frame that can outlive the
+/// frames created after it (like a program frame, or a frame owned by a
+/// Shape_Program), or that can be destroyed by a different thread.
+std::unique_ptr<Frame> make_call_frame(
+    slot_t nslots, System&, Frame* parent, Shared<const Phrase> call_phrase,
+    Module* nonlocals);
+
 } // namespace curv
 #endif // header guard
@@ -3,6 +3,7 @@
 // See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
 
 #include <libcurv/function.h>
+#include <libcurv/bytecode.h>
 #include <libcurv/exception.h>
 #include <libcurv/context.h>
 #include <libcurv/sc_compiler.h>
@@ -148,6 +149,21 @@ Legacy_Function::sc_call_legacy(SC_Frame& f) const
         "this function is not supported");
 }
 
+Closure::Closure(
+    Lambda& lambda,
+    const Module& nonlocals)
+:
+    Function(lambda.nslots_),
+    pattern_(lambda.pattern_),
+    expr_(lambda.expr_),
+    nonlocals_(share(const_cast<Module&>(nonlocals)))
+{
+    name_ = lambda.name_;
+    argpos_ = lambda.argpos_;
+    if (lambda.code_ != nullptr)
+        use_bytecode(*this, lambda.code_);
+}
+
 Value
 Closure::call(Value arg, Frame& f)
 {
@@ -186,13 +202,27 @@ Closure::try_tail_call(Value arg, std::unique_ptr<Frame>& f)
 SC_Value
 Closure::sc_call_expr(Operation& arg, Shared<const Phrase> cp, SC_Frame& f) const
 {
+    // If the argument is a variable, reuse the result of an earlier call
+    // with the same argument.
+    SC_Value argval, result;
+    bool cacheable = sc_eval_var(f, arg, argval);
+    Call_Key key;
+    if (cacheable) {
+        key = Call_Key{&*expr_, &*nonlocals_, argval.index};
+        if (f.sc_.find_call(key, result))
+            return result;
+    }
+
     // create a frame to call this closure
     auto f2 = SC_Frame::make(nslots_, f.sc_, nullptr, &f, cp);
     f2->nonlocals_ = &*nonlocals_;
     // match pattern against argument, store formal parameters in frame
     pattern_->sc_exec(arg, f, *f2);
     // evaluation function body, return result.
-    return sc_eval_op(*f2, *expr_);
+    result = sc_eval_op(*f2, *expr_);
+    if (cacheable)
+        f.sc_.add_call(key, Value{share(*this)}, result);
+    return result;
 }
 
 void
@@ -78,6 +78,11 @@ Shared<const Function> cast_to_function(Value, const Context&);
 Value call_func(
     Value func, Value arg, Shared<const Phrase> call_phrase, Frame& f);
 
+// Call a function in tail position: the call frame replaces 'f'.
+void tail_call_func(
+    Value func, Value arg,
+    Shared<const Phrase> call_phrase, std::unique_ptr<Frame>& f);
+
 /// A legacy function value. Only used for builtin functions.
 /// Deprecated. Builtin functions should be derived from Function.
 /// Legacy functions with 0, 1 and 2 arguments are called like this:
@@ -133,6 +138,9 @@ struct Lambda : public Ref_Value
     // and `name_` is the name of the base function.
     int argpos_ = 0;
 
+    // Bytecode for expr_, compiled on demand. See use_bytecode().
+    Shared<Operation> code_ = nullptr;
+
     Lambda(
         Shared<const Pattern> pattern,
         Shared<Operation> expr,
@@ -168,18 +176,11 @@ struct Closure : public Function
         nonlocals_(std::move(nonlocals))
     {}
 
+    // If the Lambda has been compiled to bytecode, then the Closure
+    // uses the bytecode.
     Closure(
         Lambda& lambda,
-        const Module& nonlocals)
-    :
-        Function(lambda.nslots_),
-        pattern_(lambda.pattern_),
-        expr_(lambda.expr_),
-        nonlocals_(share(const_cast<Module&>(nonlocals)))
-    {
-        name_ = lambda.name_;
-        argpos_ = lambda.argpos_;
-    }
+        const Module& nonlocals);
 
     virtual Value call(Value, Frame&) override;
     virtual void tail_call(Value, std::unique_ptr<Frame>&) override;
@@ -5,6 +5,7 @@
 #include <libcurv/geom/builtin.h>
 
 #include <libcurv/geom/cpp_program.h>
+#include <libcurv/geom/vm_program.h>
 
 #include <libcurv/analyser.h>
 #include <libcurv/context.h>
@@ -33,6 +34,21 @@ run_cpp_test(const Context& cx, Shared<const Function> func)
             "assertion failed in C++; see ",cpp.path_));
     }
 }
+// Run a unit test by compiling it for the in-process VM.
+void
+run_vm_test(const Context& cx, Shared<const Function> func)
+{
+    VM_Program vm{cx.system()};
+    vm.define_function("test", SC_Type::Bool(), SC_Type::Bool(), func, cx);
+    vm.compile(cx);
+    auto& test = vm.get_function("test");
+    auto regs = test.make_registers();
+    float arg = 1.0f;
+    float result = 0.0f;
+    test.call(&arg, &result, regs.data());
+    if (result == 0.0f)
+        throw Exception(cx, "assertion failed in VM");
+}
 struct SC_Test_Action : public Operation
 {
     Shared<Operation> arg_;
@@ -59,6 +75,7 @@ struct SC_Test_Action : public Operation
                 .to_bool(test_cx);
             if (!test_result)
                 throw Exception(test_cx, "assertion failed in interpreter");
+            run_vm_test(test_cx, func);
             run_cpp_test(test_cx, func);
         });
     }
@@ -74,8 +91,11 @@ struct SC_Test_Metafunction : public Metafunction
 
 void add_builtins(System_Impl& sys)
 {
-    sys.std_namespace_[make_symbol("sc_test")] =
+    // The same object is used by each System, so that the std library
+    // snapshots made by System_Impl::load_library can be shared.
+    static Shared<const Builtin> sc_test =
         make<Builtin_Meaning<SC_Test_Metafunction>>();
+    sys.std_namespace_[make_symbol("sc_test")] = sc_test;
 }
 
 }} // namespaces
@@ -10,9 +10,8 @@
 
 namespace curv { namespace geom {
 
-Compiled_Shape::Compiled_Shape(Shape_Program& rshape)
-:
-    cpp_{rshape.system_}
+Compiled_Shape::Compiled_Shape(
+    const Shape_Program& rshape, Jit_Backend backend, bool fused)
 {
     is_2d_ = rshape.is_2d_;
     is_3d_ = rshape.is_3d_;
@@ -20,13 +19,90 @@ Compiled_Shape::Compiled_Shape(Shape_Program& rshape)
 
     At_System cx{rshape.system_};
 
-    cpp_.define_function("dist", SC_Type::Vec(4), SC_Type::Num(),
+    if (backend == Jit_Backend::vm) {
+        vm_ = std::make_unique<VM_Program>(rshape.system_);
+        vm_->define_function("dist", SC_Type::Vec(4), SC_Type::Num(),
+            rshape.dist_fun_, cx);
+        vm_->define_function("colour", SC_Type::Vec(4), SC_Type::Vec(3),
+            rshape.colour_fun_, cx);
+        if (fused) {
+            vm_->define_fused_function("dist_colour", SC_Type::Vec(4),
+                SC_Type::Vec(4), {rshape.colour_fun_, rshape.dist_fun_}, cx);
+        }
+        vm_->compile(cx);
+        vm_dist_ = &vm_->get_function("dist");
+        vm_colour_ = &vm_->get_function("colour");
+        if (fused)
+            vm_dist_colour_ = &vm_->get_function("dist_colour");
+        return;
+    }
+
+    cpp_ = std::make_unique<Cpp_Program>(rshape.system_);
+    cpp_->define_function("dist", SC_Type::Vec(4), SC_Type::Num(),
+        rshape.dist_fun_, cx);
+    cpp_->define_batch_function("dist_batch", SC_Type::Vec(4), SC_Type::Num(),
         rshape.dist_fun_, cx);
-    cpp_.define_function("colour", SC_Type::Vec(4), SC_Type::Vec(3),
+    cpp_->define_function("colour", SC_Type::Vec(4), SC_Type::Vec(3),
         rshape.colour_fun_, cx);
-    cpp_.compile(cx);
-    dist_ = (Cpp_Dist_Func) cpp_.get_function("dist");
-    colour_ = (Cpp_Colour_Func) cpp_.get_function("colour");
+    if (fused) {
+        cpp_->define_fused_function("dist_colour", SC_Type::Vec(4),
+            SC_Type::Vec(4), {rshape.colour_fun_, rshape.dist_fun_}, cx);
+    }
+    cpp_->compile(cx);
+    dist_ = (Cpp_Dist_Func) cpp_->get_function("dist");
+    dist_batch_ = (Cpp_Dist_Batch_Func) cpp_->get_function("dist_batch");
+    colour_ = (Cpp_Colour_Func) cpp_->get_function("colour");
+    if (fused) {
+        dist_colour_ =
+            (Cpp_Dist_Colour_Func) cpp_->get_function("dist_colour");
+    }
+}
+
+// The VM functions are thread safe, provided each thread has its own
+// register file. Each thread reuses one register file per function, so that
+// a call doesn't allocate memory, or copy the constants.
+double
+Compiled_Shape::vm_dist(double x, double y, double z, double t)
+{
+    float* regs = vm_dist_->thread_registers();
+    float in[4] = {float(x), float(y), float(z), float(t)};
+    float out;
+    vm_dist_->call(in, &out, regs);
+    return out;
+}
+
+void
+Compiled_Shape::vm_dist_batch(unsigned n,
+    const float* x, const float* y, const float* z, const float* t,
+    float* out)
+{
+    float* regs = vm_dist_->thread_registers();
+    for (unsigned i = 0; i < n; ++i) {
+        float in[4] = {x[i], y[i], z[i], t[i]};
+        vm_dist_->call(in, &out[i], regs);
+    }
+}
+
+Vec3
+Compiled_Shape::vm_colour(double x, double y, double z, double t)
+{
+    float* regs = vm_colour_->thread_registers();
+    float in[4] = {float(x), float(y), float(z), float(t)};
+    float out[3];
+    vm_colour_->call(in, out, regs);
+    return Vec3{out[0], out[1], out[2]};
+}
+
+double
+Compiled_Shape::vm_dist_colour(double x, double y, double z, double t,
+    Vec3& colour)
+{
+    float* regs = vm_dist_colour_->thread_registers();
+    float in[4] = {float(x), float(y), float(z), float(t)};
+    float out[4];
+    vm_dist_colour_->call(in, out, regs);
+    colour = Vec3{out[0], out[1], out[2]};
+    return out[3];
 }
 
 void
@@ -38,6 +114,8 @@ export_cpp(Shape_Program& shape, std::ostream& out)
     out << Cpp_Program::standard_header;
     sc.define_function("dist", SC_Type::Vec(4), SC_Type::Num(),
         shape.dist_fun_, cx);
+    sc.define_batch_function("dist_batch", SC_Type::Vec(4), SC_Type::Num(),
+        shape.dist_fun_, cx);
     sc.define_function("colour", SC_Type::Vec(4), SC_Type::Vec(3),
         shape.colour_fun_, cx);
 }
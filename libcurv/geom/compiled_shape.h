@@ -6,7 +6,9 @@
 #define LIBCURV_GEOM_COMPILED_SHAPE_H
 
 #include <libcurv/geom/cpp_program.h>
+#include <libcurv/geom/vm_program.h>
 #include <libcurv/shape.h>
+#include <memory>
 #include <ostream>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
@@ -15,31 +17,79 @@ namespace curv { namespace geom {
 
 extern "C" {
     typedef void (*Cpp_Dist_Func)(const glm::vec4* in, float* out);
+    typedef void (*Cpp_Dist_Batch_Func)(unsigned n,
+        const float* x, const float* y, const float* z, const float* t,
+        float* out);
     typedef void (*Cpp_Colour_Func)(const glm::vec4* in, glm::vec3* out);
+    typedef void (*Cpp_Dist_Colour_Func)(const glm::vec4* in, glm::vec4* out);
 }
 
+// How a Compiled_Shape is compiled. 'cpp' generates C++ and runs the C++
+// compiler, which produces the fastest code but takes seconds. 'vm' compiles
+// in-process in milliseconds, without needing a C++ compiler.
+enum class Jit_Backend { cpp, vm };
+
 struct Compiled_Shape final : public Shape
 {
-    Cpp_Program cpp_;
-    Cpp_Dist_Func dist_;
-    Cpp_Colour_Func colour_;
+    std::unique_ptr<Cpp_Program> cpp_;
+    Cpp_Dist_Func dist_ = nullptr;
+    Cpp_Dist_Batch_Func dist_batch_ = nullptr;
+    Cpp_Colour_Func colour_ = nullptr;
+    Cpp_Dist_Colour_Func dist_colour_ = nullptr;
+
+    std::unique_ptr<VM_Program> vm_;
+    const VM_Function* vm_dist_ = nullptr;
+    const VM_Function* vm_colour_ = nullptr;
+    const VM_Function* vm_dist_colour_ = nullptr;
 
-    Compiled_Shape(Shape_Program&);
+    // The fused dist_colour function is only compiled if 'fused' is true.
+    // Otherwise, dist_colour() calls dist() and colour(). The renderers
+    // don't ask for it, since they only evaluate colour where it is visible.
+    Compiled_Shape(const Shape_Program&, Jit_Backend = Jit_Backend::cpp,
+        bool fused = false);
 
     virtual double dist(double x, double y, double z, double t) override
     {
+        if (vm_) return vm_dist(x, y, z, t);
         glm::vec4 in{x,y,z,t};
         float out;
         dist_(&in, &out);
         return out;
     }
+    virtual void dist_batch(unsigned n,
+        const float* x, const float* y, const float* z, const float* t,
+        float* out) override
+    {
+        if (vm_) return vm_dist_batch(n, x, y, z, t, out);
+        dist_batch_(n, x, y, z, t, out);
+    }
     virtual Vec3 colour(double x, double y, double z, double t) override
     {
+        if (vm_) return vm_colour(x, y, z, t);
         glm::vec4 in{x,y,z,t};
         glm::vec3 out;
         colour_(&in, &out);
         return Vec3{out.x,out.y,out.z};
     }
+    virtual double dist_colour(double x, double y, double z, double t,
+        Vec3& colour) override
+    {
+        if (vm_dist_colour_) return vm_dist_colour(x, y, z, t, colour);
+        if (!dist_colour_) return Shape::dist_colour(x, y, z, t, colour);
+        glm::vec4 in{x,y,z,t};
+        glm::vec4 out;
+        dist_colour_(&in, &out);
+        colour = Vec3{out.x,out.y,out.z};
+        return out.w;
+    }
+
+private:
+    double vm_dist(double x, double y, double z, double t);
+    void vm_dist_batch(unsigned n,
+        const float* x, const float* y, const float* z, const float* t,
+        float* out);
+    Vec3 vm_colour(double x, double y, double z, double t);
+    double vm_dist_colour(double x, double y, double z, double t, Vec3&);
 };
 
 void export_cpp(Shape_Program& shape, std::ostream& out);
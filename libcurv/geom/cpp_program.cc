@@ -4,6 +4,7 @@
 
 #include <libcurv/geom/cpp_program.h>
 
+#include <libcurv/geom/jit_cache.h>
 #include <libcurv/geom/tempfile.h>
 #include <libcurv/context.h>
 #include <libcurv/exception.h>
@@ -11,6 +12,7 @@ extern "C" {
 #include <dlfcn.h>
 }
 #include <iostream>
+#include <iterator>
 
 namespace curv { namespace geom {
 
@@ -52,8 +54,34 @@ Cpp_Program::compile(const Context& cx)
 {
     file_.close();
 
-    // compile C++ to optimized object code
-    auto cc_cmd = stringify("c++ -fpic -O3 -c ", path_.c_str());
+    // -fno-math-errno lets the compiler vectorize calls to sqrt and friends,
+    // and -march=native lets it use the widest SIMD registers available
+    // (for the batched entry points defined by define_batch_function).
+    std::string cc_flags = "-fpic -O3 -fno-math-errno"
+      #ifndef __APPLE__
+        " -march=native"
+      #endif
+        ;
+    const char link_flags[] = "-shared";
+
+    // If the same source was compiled before, reuse the shared object.
+    Jit_Cache cache;
+    std::string key;
+    if (cache.enabled()) {
+        std::ifstream in(path_.c_str());
+        std::string source{std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>()};
+        key = Jit_Cache::key(source, cc_flags + " " + link_flags);
+        auto so = cache.lookup(key);
+        if (!so.empty()) {
+            dll_ = dlopen(so.c_str(), RTLD_NOW|RTLD_LOCAL);
+            if (dll_ != nullptr)
+                return;
+        }
+    }
+
+    // compile C++ to optimized object code.
+    auto cc_cmd = stringify("c++ ", cc_flags, " -c ", path_.c_str());
     //auto cc_cmd = stringify("c++ -fpic -c -g ", path_.c_str());
     if (system(cc_cmd->c_str()) != 0) {
         preserve_tempfile();
@@ -63,9 +91,12 @@ Cpp_Program::compile(const Context& cx)
     // create shared object
     auto obj_name = register_tempfile(tempfile_id_,".o");
     auto so_name = register_tempfile(tempfile_id_,".so");
-    auto link_cmd = stringify("c++ -shared -o ", so_name.c_str(), " ", obj_name.c_str());
+    auto link_cmd = stringify("c++ ", link_flags, " -o ", so_name.c_str(),
+        " ", obj_name.c_str());
     if (system(link_cmd->c_str()) != 0)
         throw Exception(cx, "c++ link failed");
+    if (cache.enabled())
+        cache.insert(key, so_name);
 
     // load shared object
     // TODO: so_name should contain a / character to prevent PATH search.
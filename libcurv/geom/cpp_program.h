@@ -32,6 +32,19 @@ struct Cpp_Program
     {
         sc_.define_function(name, param_type, result_type, func, cx);
     }
+    inline void define_batch_function(
+        const char* name, SC_Type param_type, SC_Type result_type,
+        Shared<const Function> func, const Context& cx)
+    {
+        sc_.define_batch_function(name, param_type, result_type, func, cx);
+    }
+    inline void define_fused_function(
+        const char* name, SC_Type param_type, SC_Type result_type,
+        std::vector<Shared<const Function>> funcs, const Context& cx)
+    {
+        sc_.define_fused_function(name, param_type, result_type,
+            std::move(funcs), cx);
+    }
     void compile(const Context& cx);
     void* get_function(const char* name);
     void preserve_tempfile();
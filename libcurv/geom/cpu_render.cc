@@ -0,0 +1,420 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/geom/cpu_render.h>
+
+#include <libcurv/shape.h>
+
+#include <glm/common.hpp>
+#include <glm/exponential.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace curv { namespace geom {
+
+using glm::dvec2;
+using glm::dvec3;
+
+// A C++ translation of the fragment shader generated by export_frag_2d and
+// export_frag_3d. The method names follow the GLSL function names.
+//
+// The image is rendered in square tiles, which are independent of one
+// another, so that they can be distributed across threads. In 3D, the rays
+// of a tile are marched together, so that the distance function is called
+// using Shape::dist_batch, which is vectorized for a Compiled_Shape.
+struct CPU_Renderer
+{
+    static constexpr int tile_size = 16;
+    struct Worker;
+
+    Shape& shape_;
+    const Render_Opts& opts_;
+    glm::ivec2 size_;
+    dvec2 resolution_;
+    double time_;
+
+    // 2D: map a pixel coordinate to shape space.
+    dvec2 offset_;
+    double scale_ = 1.0;
+
+    // 3D: camera position and orientation (see look_at in the shader).
+    dvec3 eye_, uu_, vv_, ww_;
+
+    CPU_Renderer(Shape&, const Render_Opts&, glm::ivec2 size, double time);
+
+    int ntiles_x() const { return (size_.x + tile_size - 1) / tile_size; }
+    int ntiles_y() const { return (size_.y + tile_size - 1) / tile_size; }
+};
+
+// The state of one rendering thread: scratch space for a batch of rays.
+struct CPU_Renderer::Worker
+{
+    CPU_Renderer& r_;
+    Shape& shape_;
+    const Render_Opts& opts_;
+
+    // A batch of points at which to evaluate dist, as structure of arrays,
+    // and the rays that they belong to.
+    std::vector<float> x_, y_, z_, time_, dist_;
+    std::vector<unsigned> active_;
+
+    Worker(CPU_Renderer& r) : r_(r), shape_(r.shape_), opts_(r.opts_) {}
+
+    void render_tile(int tile, unsigned char* pixels);
+    dvec3 render_2d(dvec2 xy, double time);
+    dvec3 render_3d(dvec3 ro, dvec3 rd, double t, dvec3 c, double time);
+    void cast_rays(dvec3 ro, unsigned n, const dvec3* rd, double time,
+        double* t, dvec3* colour);
+    dvec3 calc_normal(dvec3 pos, double time);
+    double calc_ao(dvec3 pos, dvec3 nor, double time);
+    dvec3 lighting(dvec3 pos, dvec3 nor, dvec3 rd, dvec3 col, double occ);
+    dvec3 pew(dvec3 point, dvec3 normal, dvec3 rd, dvec3 colour, double time);
+
+    double dist(dvec3 p, double time)
+    {
+        return shape_.dist(p.x, p.y, p.z, time);
+    }
+};
+
+CPU_Renderer::CPU_Renderer(
+    Shape& shape, const Render_Opts& opts, glm::ivec2 size, double time)
+:
+    shape_(shape),
+    opts_(opts),
+    size_(size),
+    resolution_(double(size.x), double(size.y)),
+    time_(time)
+{
+    BBox bbox = shape.bbox_;
+    if (shape.is_2d_) {
+        if (bbox.empty2() || bbox.infinite2()) {
+            bbox.xmin = bbox.ymin = -10.0;
+            bbox.xmax = bbox.ymax = +10.0;
+        }
+        dvec2 bsize(bbox.xmax - bbox.xmin, bbox.ymax - bbox.ymin);
+        dvec2 scale2 = bsize / resolution_;
+        offset_ = dvec2(bbox.xmin, bbox.ymin);
+        if (scale2.x > scale2.y) {
+            scale_ = scale2.x;
+            offset_.y -= (resolution_.y*scale_ - bsize.y)/2.0;
+        } else {
+            scale_ = scale2.y;
+            offset_.x -= (resolution_.x*scale_ - bsize.x)/2.0;
+        }
+    } else {
+        if (bbox.empty3() || bbox.infinite3()) {
+            bbox.xmin = bbox.ymin = bbox.zmin = -10.0;
+            bbox.xmax = bbox.ymax = bbox.zmax = +10.0;
+        }
+        dvec3 bmin(bbox.xmin, bbox.ymin, bbox.zmin);
+        dvec3 bmax(bbox.xmax, bbox.ymax, bbox.zmax);
+        dvec3 origin = (bmin + bmax) / 2.0;
+        dvec3 radius = (bmax - bmin) / 2.0;
+        double r = std::max(radius.x, std::max(radius.y, radius.z)) / 1.3;
+
+        // The viewer's initial camera position (see Viewer::reset_view),
+        // converted from OpenGL to Curv coordinates.
+        eye_ = dvec3(2.598076, -4.5, 3.0)*r + origin;
+        dvec3 centre = origin;
+        dvec3 up(-0.25, 0.433013, 0.866025);
+        ww_ = glm::normalize(centre - eye_);
+        uu_ = glm::normalize(glm::cross(ww_, up));
+        vv_ = glm::normalize(glm::cross(uu_, ww_));
+    }
+}
+
+// Convert a linear RGB component to an 8 bit sRGB component.
+static unsigned char
+srgb_byte(double c)
+{
+    if (!(c > 0.0)) return 0;
+    if (c >= 1.0) return 255;
+    return (unsigned char) std::round(std::pow(c, 0.454545454545454545)*255.0);
+}
+
+void
+CPU_Renderer::Worker::render_tile(int tile, unsigned char* pixels)
+{
+    const int x0 = tile % r_.ntiles_x() * tile_size;
+    const int y0 = tile / r_.ntiles_x() * tile_size;
+    const int x1 = std::min(x0 + tile_size, r_.size_.x);
+    const int y1 = std::min(y0 + tile_size, r_.size_.y);
+    const unsigned npixels = unsigned((x1 - x0) * (y1 - y0));
+    const dvec2 res = r_.resolution_;
+    const int aa = opts_.aa_;
+    const int taa = opts_.taa_;
+
+    dvec3 col[tile_size*tile_size];
+    dvec3 rd[tile_size*tile_size];
+    double depth[tile_size*tile_size];
+    dvec3 colour[tile_size*tile_size];
+    for (unsigned i = 0; i < npixels; ++i)
+        col[i] = dvec3(0.0);
+
+    for (int m = 0; m < aa; ++m)
+    for (int n = 0; n < aa; ++n) {
+        dvec2 o(0.0);
+        if (aa > 1)
+            o = dvec2(double(m)/aa - 0.5, double(n)/aa - 0.5);
+        for (int t = 0; t < taa; ++t) {
+            double time = r_.time_ + double(t)/double(taa)*opts_.fdur_;
+            unsigned i = 0;
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    dvec2 frag_coord = dvec2(x + 0.5, y + 0.5) + o;
+                    if (shape_.is_2d_) {
+                        col[i++] += render_2d(frag_coord, time);
+                    } else {
+                        dvec2 p = 2.0 * frag_coord / res - dvec2(1.0);
+                        p.x *= res.x/res.y;
+                        rd[i++] = glm::normalize(
+                            r_.uu_*p.x + r_.vv_*p.y + r_.ww_*2.5);
+                    }
+                }
+            }
+            if (!shape_.is_2d_) {
+                cast_rays(r_.eye_, npixels, rd, time, depth, colour);
+                for (i = 0; i < npixels; ++i) {
+                    col[i] += render_3d(
+                        r_.eye_, rd[i], depth[i], colour[i], time);
+                }
+            }
+        }
+    }
+
+    unsigned i = 0;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            dvec3 c = col[i++] / double(aa*aa*taa);
+            unsigned char* pix = &pixels[(y*r_.size_.x + x)*4];
+            pix[0] = srgb_byte(c.x);
+            pix[1] = srgb_byte(c.y);
+            pix[2] = srgb_byte(c.z);
+            pix[3] = 255;
+        }
+    }
+}
+
+dvec3
+CPU_Renderer::Worker::render_2d(dvec2 xy, double time)
+{
+    dvec2 p = xy*r_.scale_ + r_.offset_;
+    double d = shape_.dist(p.x, p.y, 0.0, time);
+    if (d > 0.0)
+        return opts_.bg_;
+    return shape_.colour(p.x, p.y, 0.0, time);
+}
+
+// Ray marching, for n rays with a common origin. ro is the ray origin,
+// rd[i] is a ray direction (unit vector). Sets t[i] to the distance that we
+// marched, and colour[i] to the colour of the distance field at the point
+// we ended up at, or (-1,-1,-1) if no object was hit.
+//
+// The rays that are still marching take one step together, with one call
+// to dist_batch.
+void
+CPU_Renderer::Worker::cast_rays(dvec3 ro, unsigned n, const dvec3* rd,
+    double time, double* t, dvec3* colour)
+{
+    const double tmax = opts_.ray_max_depth_;
+    active_.resize(n);
+    for (unsigned i = 0; i < n; ++i) {
+        active_[i] = i;
+        t[i] = 0.0;
+        colour[i] = dvec3(-1.0);
+    }
+    for (int iter = 0; iter < opts_.ray_max_iter_ && !active_.empty(); ++iter)
+    {
+        unsigned m = unsigned(active_.size());
+        x_.resize(m);
+        y_.resize(m);
+        z_.resize(m);
+        time_.assign(m, float(time));
+        dist_.resize(m);
+        for (unsigned k = 0; k < m; ++k) {
+            unsigned i = active_[k];
+            dvec3 p = ro + rd[i]*t[i];
+            x_[k] = float(p.x);
+            y_[k] = float(p.y);
+            z_[k] = float(p.z);
+        }
+        shape_.dist_batch(m,
+            x_.data(), y_.data(), z_.data(), time_.data(), dist_.data());
+        unsigned nactive = 0;
+        for (unsigned k = 0; k < m; ++k) {
+            unsigned i = active_[k];
+            double precis = 0.0005*t[i];
+            if (dist_[k] < precis) {
+                colour[i] = shape_.colour(x_[k], y_[k], z_[k], time);
+                continue;
+            }
+            t[i] += dist_[k];
+            if (!(t[i] > tmax))
+                active_[nactive++] = i;
+        }
+        active_.resize(nactive);
+    }
+}
+
+dvec3
+CPU_Renderer::Worker::calc_normal(dvec3 pos, double time)
+{
+    const double e = 0.5773*0.0005;
+    const dvec3 xyy(e,-e,-e), yyx(-e,-e,e), yxy(-e,e,-e), xxx(e,e,e);
+    return glm::normalize(xyy*dist(pos + xyy, time)
+                        + yyx*dist(pos + yyx, time)
+                        + yxy*dist(pos + yxy, time)
+                        + xxx*dist(pos + xxx, time));
+}
+
+double
+CPU_Renderer::Worker::calc_ao(dvec3 pos, dvec3 nor, double time)
+{
+    double occ = 0.0;
+    double sca = 1.0;
+    for (int i = 0; i < 5; ++i) {
+        double hr = 0.01 + 0.12*double(i)/4.0;
+        double dd = dist(nor*hr + pos, time);
+        occ += -(dd-hr)*sca;
+        sca *= 0.95;
+    }
+    return glm::clamp(1.0 - 3.0*occ, 0.0, 1.0);
+}
+
+// The lighting model shared by the standard shader and the default sf1
+// shader, which doesn't compute ambient occlusion (occ == 1).
+dvec3
+CPU_Renderer::Worker::lighting(
+    dvec3 pos, dvec3 nor, dvec3 rd, dvec3 col, double occ)
+{
+    dvec3 ref = glm::reflect(rd, nor);
+    dvec3 lig = glm::normalize(dvec3(-0.4, 0.6, 0.7));
+    double amb = glm::clamp(0.5 + 0.5*nor.z, 0.0, 1.0);
+    double dif = glm::clamp(glm::dot(nor, lig), 0.0, 1.0);
+    double bac =
+        glm::clamp(glm::dot(nor, glm::normalize(dvec3(-lig.x,lig.y,0.0))),
+            0.0, 1.0)
+        * glm::clamp(1.0 - pos.z, 0.0, 1.0);
+    double dom = glm::smoothstep(-0.1, 0.1, ref.z);
+    double fre = std::pow(glm::clamp(1.0 + glm::dot(nor,rd), 0.0, 1.0), 2.0);
+    double spe = std::pow(glm::clamp(glm::dot(ref,lig), 0.0, 1.0), 16.0);
+
+    dvec3 lin(0.0);
+    lin += 1.30*dif*dvec3(1.00,0.80,0.55);
+    lin += 2.00*spe*dvec3(1.00,0.90,0.70)*dif;
+    lin += 0.40*amb*dvec3(0.40,0.60,1.00)*occ;
+    lin += 0.50*dom*dvec3(0.40,0.60,1.00)*occ;
+    lin += 0.50*bac*dvec3(0.35,0.35,0.35)*occ;
+    lin += 0.25*fre*dvec3(1.00,1.00,1.00)*occ;
+    dvec3 iqcol = col*lin;
+
+    return glm::mix(col, iqcol, 0.5);
+}
+
+// The #pew shader, written by Philipp Emanuel Weidmann (@p-e-w on github).
+// Phong reflection model, with shadows cast by 3 lights.
+dvec3
+CPU_Renderer::Worker::pew(
+    dvec3 point, dvec3 normal, dvec3 rd, dvec3 colour, double time)
+{
+    struct Light { dvec3 position, specular, diffuse, ambient; };
+    static const Light lights[3] = {
+        {dvec3(-10.0, -100.0,  100.0), dvec3(1.5), dvec3(1.5), dvec3(0.25)},
+        {dvec3(  0.0,  100.0,  100.0), dvec3(2.0), dvec3(2.0), dvec3(0.25)},
+        {dvec3( 20.0,  100.0, -100.0), dvec3(1.5), dvec3(1.5), dvec3(0.5)},
+    };
+    const dvec3 specular_reflectivity(1.5);
+    const dvec3 diffuse_reflectivity(1.2);
+    const dvec3 ambient_reflectivity(0.5);
+    const double shininess = 15.0;
+
+    dvec3 viewer_direction = -rd;
+    dvec3 illumination(0.0);
+    for (auto& light : lights) {
+        illumination += ambient_reflectivity * light.ambient;
+        dvec3 light_direction = glm::normalize(light.position - point);
+        double t;
+        dvec3 shadow;
+        cast_rays(point, 1, &light_direction, time, &t, &shadow);
+        if (shadow.x < 0.0) {
+            // No part of the shape lies between the surface point
+            // and the light source.
+            dvec3 reflection_direction = -glm::reflect(light_direction, normal);
+            double diffuse_term = glm::dot(light_direction, normal);
+            if (diffuse_term > 0.0) {
+                illumination +=
+                    diffuse_reflectivity * diffuse_term * light.diffuse;
+                double specular_term =
+                    glm::dot(reflection_direction, viewer_direction);
+                if (specular_term > 0.0) {
+                    illumination += specular_reflectivity
+                        * std::pow(specular_term, shininess)
+                        * light.specular;
+                }
+            }
+        }
+    }
+    return glm::mix(colour, glm::clamp(colour*illumination, 0.0, 1.0), 0.5);
+}
+
+// Shade a pixel, given the result (t,c) of marching the ray (ro,rd).
+dvec3
+CPU_Renderer::Worker::render_3d(
+    dvec3 ro, dvec3 rd, double t, dvec3 c, double time)
+{
+    if (c.x < 0.0)
+        return opts_.bg_;
+    dvec3 pos = ro + t*rd;
+    dvec3 nor = calc_normal(pos, time);
+    dvec3 col;
+    switch (opts_.shader_) {
+    case Render_Opts::Shader::pew:
+        return pew(pos, nor, rd, c, time);
+    case Render_Opts::Shader::sf1:
+        col = lighting(pos, nor, rd, c, 1.0);
+        break;
+    default:
+        col = lighting(pos, nor, rd, c, calc_ao(pos, nor, time));
+        break;
+    }
+    return glm::clamp(col, 0.0, 1.0);
+}
+
+void
+cpu_render(
+    Shape& shape, const Render_Opts& opts, glm::ivec2 size, double time,
+    unsigned nthreads, unsigned char* pixels)
+{
+    CPU_Renderer renderer(shape, opts, size, time);
+    const int ntiles = renderer.ntiles_x() * renderer.ntiles_y();
+    nthreads = std::max(1u, std::min(nthreads, unsigned(ntiles)));
+    if (nthreads == 1) {
+        CPU_Renderer::Worker worker(renderer);
+        for (int tile = 0; tile < ntiles; ++tile)
+            worker.render_tile(tile, pixels);
+        return;
+    }
+    std::atomic<int> next_tile{0};
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < nthreads; ++i) {
+        workers.emplace_back([&]() -> void {
+            CPU_Renderer::Worker worker(renderer);
+            for (;;) {
+                int tile = next_tile++;
+                if (tile >= ntiles) break;
+                worker.render_tile(tile, pixels);
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+}} // namespace
@@ -0,0 +1,32 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#ifndef LIBCURV_GEOM_CPU_RENDER_H
+#define LIBCURV_GEOM_CPU_RENDER_H
+
+#include <libcurv/render.h>
+#include <glm/vec2.hpp>
+
+namespace curv {
+struct Shape;
+
+namespace geom {
+
+// Render an image of a shape on the CPU, without OpenGL. The result is the
+// image drawn by the fragment shader from export_frag(), as seen from the
+// viewer's initial camera position, at the given animation time.
+//
+// `pixels` receives size.x*size.y RGBA pixels, 4 bytes per pixel, with the
+// bottom row first (the layout returned by glReadPixels).
+//
+// The image is divided into tiles, which are claimed by `nthreads` worker
+// threads. Using more than 1 thread requires a thread safe shape (a
+// Compiled_Shape). A custom sf1 shader function is not supported: the
+// default sf1 shader is used instead.
+void cpu_render(
+    Shape& shape, const Render_Opts& opts, glm::ivec2 size, double time,
+    unsigned nthreads, unsigned char* pixels);
+
+}} // namespace
+#endif // header guard
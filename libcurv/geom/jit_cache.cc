@@ -0,0 +1,187 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/geom/jit_cache.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+extern "C" {
+#include <unistd.h>
+}
+
+namespace curv { namespace geom {
+
+namespace fs = Filesystem;
+using boost::system::error_code;
+
+static fs::path
+default_cache_dir()
+{
+    const char* dir = getenv("CURV_CACHE_DIR");
+    if (dir != nullptr) {
+        if (*dir == '\0') return {};
+        return fs::path(dir) / "jit";
+    }
+    dir = getenv("XDG_CACHE_HOME");
+    if (dir != nullptr && *dir != '\0')
+        return fs::path(dir) / "curv" / "jit";
+    dir = getenv("HOME");
+    if (dir != nullptr && *dir != '\0')
+        return fs::path(dir) / ".cache" / "curv" / "jit";
+    return {};
+}
+
+Jit_Cache::Jit_Cache()
+:
+    dir_{default_cache_dir()},
+    max_bytes_{default_max_bytes}
+{
+}
+
+Jit_Cache::Jit_Cache(fs::path dir, std::uintmax_t max_bytes)
+:
+    dir_{std::move(dir)},
+    max_bytes_{max_bytes}
+{
+}
+
+const std::string&
+cpp_compiler_version()
+{
+    static const std::string version = []{
+        std::string out;
+        FILE* p = popen("c++ --version 2>/dev/null", "r");
+        if (p != nullptr) {
+            char buf[256];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), p)) > 0)
+                out.append(buf, n);
+            pclose(p);
+        }
+        return out;
+    }();
+    return version;
+}
+
+// Two independent 64 bit FNV-1a style hashes, giving a 128 bit key.
+// This is not a cryptographic hash: the cache directory is private to
+// the user, so we only need to guard against accidental collisions.
+struct Key_Hash
+{
+    uint64_t h1_ = 0xcbf29ce484222325u;
+    uint64_t h2_ = 0x84222325cbf29ce4u;
+    void add(const std::string& s)
+    {
+        for (unsigned char c : s) {
+            h1_ = (h1_ ^ c) * 0x100000001b3u;
+            h2_ = (h2_ ^ c) * 0x100000001b3u;
+            h2_ ^= h2_ >> 29;
+        }
+        // Separate the fields, so that ("ab","c") != ("a","bc").
+        h1_ = (h1_ ^ s.size()) * 0x100000001b3u;
+        h2_ = (h2_ ^ s.size()) * 0x100000001b3u;
+    }
+};
+
+std::string
+Jit_Cache::key(const std::string& source, const std::string& flags)
+{
+    Key_Hash h;
+    h.add(source);
+    h.add(flags);
+    h.add(cpp_compiler_version());
+    // -march=native code is specific to the host CPU, and a home directory
+    // may be shared by several hosts.
+    char host[256] = {};
+    gethostname(host, sizeof(host)-1);
+    h.add(host);
+    char buf[33];
+    snprintf(buf, sizeof(buf), "%016llx%016llx",
+        (unsigned long long) h.h1_, (unsigned long long) h.h2_);
+    return buf;
+}
+
+fs::path
+Jit_Cache::lookup(const std::string& key) const
+{
+    if (!enabled()) return {};
+    fs::path so = dir_ / (key + ".so");
+    error_code ec;
+    if (!fs::is_regular_file(so, ec))
+        return {};
+    fs::last_write_time(so, std::time(nullptr), ec);
+    return so;
+}
+
+void
+Jit_Cache::insert(const std::string& key, const fs::path& so) const
+{
+    if (!enabled()) return;
+    error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) return;
+
+    // Copy to a name that is unique to this process, then rename, so that
+    // other processes never observe a partially written shared object.
+    fs::path tmp = dir_ / (key + ".so." + std::to_string(getpid()) + ".tmp");
+    fs::copy_file(so, tmp, fs::copy_option::overwrite_if_exists, ec);
+    if (!ec)
+        fs::rename(tmp, dir_ / (key + ".so"), ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    evict();
+}
+
+void
+Jit_Cache::evict() const
+{
+    if (!enabled()) return;
+    struct Entry
+    {
+        fs::path path_;
+        std::time_t mtime_;
+        std::uintmax_t size_;
+    };
+    std::vector<Entry> entries;
+    std::uintmax_t total = 0;
+    std::time_t now = std::time(nullptr);
+
+    error_code ec;
+    fs::directory_iterator i(dir_, ec), end;
+    for (; !ec && i != end; i.increment(ec)) {
+        fs::path path = i->path();
+        error_code ec2;
+        std::time_t mtime = fs::last_write_time(path, ec2);
+        if (ec2) continue;
+        if (path.extension() == ".tmp") {
+            // Left behind by a process that crashed during insert().
+            if (now - mtime > 60*60)
+                fs::remove(path, ec2);
+            continue;
+        }
+        if (path.extension() != ".so") continue;
+        std::uintmax_t size = fs::file_size(path, ec2);
+        if (ec2) continue;
+        entries.push_back({path, mtime, size});
+        total += size;
+    }
+    if (total <= max_bytes_) return;
+
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.mtime_ < b.mtime_; });
+    for (auto& e : entries) {
+        if (total <= max_bytes_) break;
+        error_code ec2;
+        // Another process may have evicted this entry already.
+        fs::remove(e.path_, ec2);
+        total -= e.size_;
+    }
+}
+
+}} // namespace
@@ -0,0 +1,65 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#ifndef LIBCURV_GEOM_JIT_CACHE_H
+#define LIBCURV_GEOM_JIT_CACHE_H
+
+#include <libcurv/filesystem.h>
+#include <cstdint>
+#include <string>
+
+namespace curv { namespace geom {
+
+// A persistent cache of shared objects produced by Cpp_Program::compile,
+// shared by all curv processes run by the same user. Each entry is a file
+// named <key>.so, where the key is a hash of the C++ source code, the
+// compiler flags, the compiler version string, and the host name.
+//
+// Multiple processes may use the cache concurrently. New entries are
+// written to a private temporary file, then atomically renamed into place.
+// Eviction (least recently used first) may delete a file that another
+// process is about to dlopen: that process then recompiles. Deleting a file
+// that is already loaded is harmless on POSIX systems.
+//
+// The cache directory is $CURV_CACHE_DIR/jit, or $XDG_CACHE_HOME/curv/jit,
+// or $HOME/.cache/curv/jit. Setting CURV_CACHE_DIR to the empty string
+// disables the cache.
+struct Jit_Cache
+{
+    // Total size of the cached shared objects, after eviction.
+    static constexpr std::uintmax_t default_max_bytes = 256 * 1024 * 1024;
+
+    Filesystem::path dir_;
+    std::uintmax_t max_bytes_;
+
+    // Use the default cache directory.
+    Jit_Cache();
+    // Use the specified directory. An empty path disables the cache.
+    Jit_Cache(Filesystem::path dir, std::uintmax_t max_bytes);
+
+    bool enabled() const { return !dir_.empty(); }
+
+    // Compute a cache key for the given C++ source and compiler flags.
+    static std::string key(const std::string& source, const std::string& flags);
+
+    // Return the path of the shared object for 'key', or an empty path
+    // if there is none. A hit updates the entry's modification time, which
+    // is used as the access time for LRU eviction.
+    Filesystem::path lookup(const std::string& key) const;
+
+    // Copy 'so' into the cache under 'key', then evict old entries.
+    // Failures are ignored: the cache is an optimization.
+    void insert(const std::string& key, const Filesystem::path& so) const;
+
+    // Delete least recently used entries until the total size of the cache
+    // is at most max_bytes_. Also delete stale temporary files.
+    void evict() const;
+};
+
+// Identifies the C++ compiler invoked by Cpp_Program (output of
+// `c++ --version`). Computed once per process.
+const std::string& cpp_compiler_version();
+
+}} // namespace
+#endif // include guard
@@ -0,0 +1,345 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/geom/mesh.h>
+
+#include <libcurv/dtostr.h>
+#include <libcurv/function.h>
+#include <libcurv/shape.h>
+#include <glm/geometric.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace curv { namespace geom {
+
+// Data is accumulated in a large block, which is written to the ostream
+// when it fills up. This avoids the cost of a virtual streambuf call and of
+// std::ostream formatting for each value, which dominates the time taken to
+// write a large mesh using `out << x`.
+struct Output_Buffer
+{
+    static constexpr size_t block_size = 1 << 20;
+
+    std::ostream& out_;
+    std::unique_ptr<char[]> buf_{new char[block_size]};
+    char* ptr_ = buf_.get();
+    char* end_ = buf_.get() + block_size;
+
+    explicit Output_Buffer(std::ostream& out) : out_(out) {}
+    ~Output_Buffer() { flush(); }
+
+    void flush()
+    {
+        out_.write(buf_.get(), ptr_ - buf_.get());
+        ptr_ = buf_.get();
+    }
+    // Ensure there is room for `n` more bytes, where n <= block_size.
+    void reserve(size_t n)
+    {
+        if (size_t(end_ - ptr_) < n)
+            flush();
+    }
+
+    void put(char c)
+    {
+        reserve(1);
+        *ptr_++ = c;
+    }
+    void put(const char* s)
+    {
+        size_t n = strlen(s);
+        if (n > block_size) {
+            flush();
+            out_.write(s, n);
+        } else {
+            reserve(n);
+            memcpy(ptr_, s, n);
+            ptr_ += n;
+        }
+    }
+    void put_float(float x, dfmt::style style)
+    {
+        reserve(DTOSTR_BUFSIZE);
+        ftostr(x, ptr_, style);
+        ptr_ += strlen(ptr_);
+    }
+    void put_vec3(glm::vec3 v, dfmt::style style)
+    {
+        put_float(v.x, style);
+        put(' ');
+        put_float(v.y, style);
+        put(' ');
+        put_float(v.z, style);
+    }
+    void put_uint(unsigned n)
+    {
+        char digits[10];
+        int i = 0;
+        do {
+            digits[i++] = char('0' + n % 10);
+            n /= 10;
+        } while (n != 0);
+        reserve(i);
+        while (i > 0)
+            *ptr_++ = digits[--i];
+    }
+
+    // Binary data is little endian, independent of the host byte order.
+    void put_u16(uint16_t n)
+    {
+        reserve(2);
+        *ptr_++ = char(n);
+        *ptr_++ = char(n >> 8);
+    }
+    void put_u32(uint32_t n)
+    {
+        reserve(4);
+        *ptr_++ = char(n);
+        *ptr_++ = char(n >> 8);
+        *ptr_++ = char(n >> 16);
+        *ptr_++ = char(n >> 24);
+    }
+    void put_f32(float x)
+    {
+        uint32_t n;
+        memcpy(&n, &x, 4);
+        put_u32(n);
+    }
+};
+
+namespace {
+
+// Call f(i0,i1,i2) for each triangle, after splitting quads.
+template <class F>
+void each_triangle(const Mesh& mesh, F f)
+{
+    for (auto& t : mesh.triangles_)
+        f(t[0], t[1], t[2]);
+    for (auto& q : mesh.quads_) {
+        f(q[0], q[1], q[2]);
+        f(q[0], q[2], q[3]);
+    }
+}
+
+// The unit normal of a triangle, or 0 if the triangle is degenerate.
+glm::vec3 facet_normal(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+{
+    glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+    float len = glm::length(n);
+    return len > 0.0f ? n / len : glm::vec3(0.0f);
+}
+
+glm::vec3 linear_RGB_to_sRGB(Vec3 c)
+{
+    constexpr double k = 0.4545;
+    return glm::vec3(pow(c.x, k), pow(c.y, k), pow(c.z, k));
+}
+
+} // namespace
+
+Mesh_Stream::Mesh_Stream(Format format, std::ostream& out, size_t ntriangles)
+:
+    format_(format),
+    buf_(new Output_Buffer(out)),
+    start_(out.tellp()),
+    header_ntriangles_(ntriangles)
+{
+    switch (format_) {
+    case Format::ascii_stl:
+        buf_->put("solid curv\n");
+        break;
+    case Format::binary_stl:
+      {
+        // An 80 byte header (which mustn't begin with "solid"), the number
+        // of triangles, then 50 bytes per triangle.
+        char header[80] = "Curv binary STL";
+        for (char c : header)
+            buf_->put(c);
+        buf_->put_u32(uint32_t(ntriangles));
+        break;
+      }
+    case Format::obj:
+        break;
+    }
+}
+
+Mesh_Stream::~Mesh_Stream()
+{
+}
+
+void Mesh_Stream::write(const Mesh& piece, const std::vector<unsigned>& ids)
+{
+    Output_Buffer& buf = *buf_;
+    auto& pts = piece.points_;
+    switch (format_) {
+    case Format::ascii_stl:
+        each_triangle(piece, [&](unsigned i0, unsigned i1, unsigned i2)->void {
+            buf.put("facet normal ");
+            buf.put_vec3(facet_normal(pts[i0], pts[i1], pts[i2]), dfmt::C);
+            buf.put("\n outer loop\n");
+            for (unsigned i : {i0, i1, i2}) {
+                buf.put("  vertex ");
+                buf.put_vec3(pts[i], dfmt::C);
+                buf.put('\n');
+            }
+            buf.put(" endloop\nendfacet\n");
+        });
+        npoints_ += unsigned(pts.size());
+        break;
+    case Format::binary_stl:
+        each_triangle(piece, [&](unsigned i0, unsigned i1, unsigned i2)->void {
+            glm::vec3 n = facet_normal(pts[i0], pts[i1], pts[i2]);
+            for (glm::vec3 v : {n, pts[i0], pts[i1], pts[i2]}) {
+                buf.put_f32(v.x);
+                buf.put_f32(v.y);
+                buf.put_f32(v.z);
+            }
+            buf.put_u16(0); // attribute byte count
+        });
+        npoints_ += unsigned(pts.size());
+        break;
+    case Format::obj:
+      {
+        // OBJ vertex indexes are 1-based.
+        unsigned base = npoints_ + 1;
+        for (unsigned i = 0; i < pts.size(); ++i) {
+            if (!ids.empty() && ids[i] != npoints_)
+                continue;
+            buf.put("v ");
+            buf.put_vec3(pts[i], dfmt::C);
+            buf.put('\n');
+            ++npoints_;
+        }
+        auto id = [&](unsigned i)->unsigned {
+            return ids.empty() ? base + i : ids[i] + 1;
+        };
+        for (auto& t : piece.triangles_) {
+            buf.put('f');
+            for (int i = 0; i < 3; ++i) {
+                buf.put(' ');
+                buf.put_uint(id(t[i]));
+            }
+            buf.put('\n');
+        }
+        for (auto& q : piece.quads_) {
+            buf.put('f');
+            for (int i = 0; i < 4; ++i) {
+                buf.put(' ');
+                buf.put_uint(id(q[i]));
+            }
+            buf.put('\n');
+        }
+        break;
+      }
+    }
+    ntriangles_ += piece.ntriangles();
+}
+
+void Mesh_Stream::finish()
+{
+    switch (format_) {
+    case Format::ascii_stl:
+        buf_->put("endsolid curv\n");
+        buf_->flush();
+        break;
+    case Format::binary_stl:
+        buf_->flush();
+        if (ntriangles_ != header_ntriangles_) {
+            std::ostream& out = buf_->out_;
+            out.seekp(start_ + std::streamoff(80));
+            buf_->put_u32(uint32_t(ntriangles_));
+            buf_->flush();
+            out.seekp(0, std::ios_base::end);
+        }
+        break;
+    case Format::obj:
+        buf_->flush();
+        break;
+    }
+}
+
+void write_stl(const Mesh& mesh, bool binary, std::ostream& out)
+{
+    Mesh_Stream stream(
+        binary ? Mesh_Stream::Format::binary_stl
+               : Mesh_Stream::Format::ascii_stl,
+        out, mesh.ntriangles());
+    stream.write(mesh, {});
+    stream.finish();
+}
+
+void write_obj(const Mesh& mesh, std::ostream& out)
+{
+    Mesh_Stream stream(Mesh_Stream::Format::obj, out);
+    stream.write(mesh, {});
+    stream.finish();
+}
+
+void write_x3d(const Mesh& mesh, Shape& shape, Mesh_Colouring colouring,
+    std::ostream& out)
+{
+    Output_Buffer buf(out);
+    auto& pts = mesh.points_;
+    buf.put(
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!DOCTYPE X3D PUBLIC \"ISO//Web3D//DTD X3D 3.1//EN\" \"http://www.web3d.org/specifications/x3d-3.1.dtd\">\n"
+    "<X3D profile=\"Interchange\" version=\"3.1\" xsd:noNamespaceSchemaLocation=\"http://www.web3d.org/specifications/x3d-3.1.xsd\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+    " <head>\n"
+    "  <meta content=\"Curv, https://github.com/doug-moen/curv\" name=\"generator\"/>\n"
+    " </head>\n"
+    " <Scene>\n"
+    "  <Shape>\n"
+    "   <IndexedFaceSet colorPerVertex=\"");
+    buf.put(colouring == Mesh_Colouring::vertex ? "true" : "false");
+    buf.put("\" coordIndex=\"");
+    bool first = true;
+    each_triangle(mesh, [&](unsigned i0, unsigned i1, unsigned i2)->void {
+        if (!first) buf.put(' ');
+        first = false;
+        for (unsigned i : {i0, i1, i2}) {
+            buf.put_uint(i);
+            buf.put(' ');
+        }
+        buf.put("-1");
+    });
+    buf.put(
+    "\">\n"
+    "    <Coordinate point=\"");
+    first = true;
+    for (auto& pt : pts) {
+        if (!first) buf.put(' ');
+        first = false;
+        buf.put_vec3(pt, dfmt::XML);
+    }
+    buf.put(
+    "\"/>\n"
+    "    <Color color=\"");
+    switch (colouring) {
+    case Mesh_Colouring::face:
+        each_triangle(mesh, [&](unsigned i0, unsigned i1, unsigned i2)->void {
+            glm::vec3 c = (pts[i0] + pts[i1] + pts[i2]) / 3.0f;
+            buf.put(' ');
+            buf.put_vec3(linear_RGB_to_sRGB(shape.colour(c.x, c.y, c.z, 0.0)),
+                dfmt::XML);
+        });
+        break;
+    case Mesh_Colouring::vertex:
+        for (auto& pt : pts) {
+            buf.put(' ');
+            buf.put_vec3(linear_RGB_to_sRGB(shape.colour(pt.x,pt.y,pt.z,0.0)),
+                dfmt::XML);
+        }
+        break;
+    }
+    buf.put(
+    "\"/>\n"
+    "   </IndexedFaceSet>\n"
+    "  </Shape>\n"
+    " </Scene>\n"
+    "</X3D>\n");
+}
+
+}} // namespace
@@ -0,0 +1,84 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#ifndef LIBCURV_GEOM_MESH_H
+#define LIBCURV_GEOM_MESH_H
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace curv {
+struct Shape;
+
+namespace geom {
+struct Output_Buffer;
+
+// A polygon mesh, as produced by a mesher. Each face is a triangle or a
+// quad, given as indexes into `points_`, with the vertices listed in
+// counterclockwise order as seen from outside the mesh.
+struct Mesh
+{
+    std::vector<glm::vec3> points_;
+    std::vector<glm::uvec3> triangles_;
+    std::vector<glm::uvec4> quads_;
+
+    // The number of triangles, with each quad split into 2 triangles.
+    size_t ntriangles() const { return triangles_.size() + 2*quads_.size(); }
+};
+
+// Mesh file writers.
+//
+// Output is formatted into a large buffer, which is passed to the ostream
+// in one call each time it fills up. Numbers are printed using ftostr: the
+// shortest string that reads back as the same float.
+
+// Write an STL file. A binary STL file is about 1/4 the size of an ASCII
+// STL file, and is much faster to write and to read.
+void write_stl(const Mesh&, bool binary, std::ostream&);
+
+// Write an OBJ file, in which quads are preserved.
+void write_obj(const Mesh&, std::ostream&);
+
+// Writes an STL or OBJ file one piece at a time, so that a mesh too large
+// to hold in memory can be written as it is generated.
+//
+// The points of a piece are identified by `ids`: ids[i] is the index of
+// piece.points_[i] in the whole mesh. Points are numbered in the order that
+// they are first written, so a point is new if its id equals the number of
+// points written so far, otherwise it was written as part of an earlier
+// piece. An empty `ids` means that all of the piece's points are new.
+//
+// A binary STL file begins with the triangle count. If `ntriangles` isn't
+// the final count, then `finish()` seeks back to the start of the file to
+// fill it in, which requires a seekable stream.
+struct Mesh_Stream
+{
+    enum class Format { ascii_stl, binary_stl, obj };
+
+    Mesh_Stream(Format, std::ostream&, size_t ntriangles = 0);
+    ~Mesh_Stream();
+
+    void write(const Mesh& piece, const std::vector<unsigned>& ids);
+    // Write the end of the file.
+    void finish();
+
+    Format format_;
+    std::unique_ptr<Output_Buffer> buf_;
+    std::ostream::pos_type start_;
+    size_t header_ntriangles_;
+    unsigned npoints_ = 0;
+    size_t ntriangles_ = 0;
+};
+
+// Write an X3D file, coloured using the `colour` function of `shape`.
+// With `face` colouring, each triangle has the colour of its centroid.
+// With `vertex` colouring, colours are interpolated between the vertices.
+enum class Mesh_Colouring { face, vertex };
+void write_x3d(const Mesh&, Shape& shape, Mesh_Colouring, std::ostream&);
+
+}} // namespace
+#endif // header guard
@@ -4,6 +4,7 @@
 
 #include <libcurv/geom/png.h>
 
+#include <libcurv/geom/cpu_render.h>
 #include <libcurv/shape.h>
 #include <libcurv/viewer/viewer.h>
 #include <libcurv/context.h>
@@ -12,10 +13,16 @@
 
 #include <libcurv/viewer/texture.h>
 
+#include <atomic>
 #include <cerrno>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 namespace curv { namespace geom {
 
@@ -54,12 +61,56 @@ write_png_rgb(
     }
 }
 
+static void
+check_cpu_opts(const Image_Export& p, System& sys)
+{
+    if (p.shader_ == Render_Opts::Shader::sf1 && p.sf1_) {
+        throw Exception(At_System(sys),
+            "-O renderer=#cpu doesn't support a custom sf1 shader");
+    }
+}
+
+// Render the image on the CPU, without opening a window.
+static void
+export_png_cpu(
+    const Shape_Program& shape,
+    const Image_Export& p,
+    Output_File& ofile)
+{
+    check_cpu_opts(p, ofile.system_);
+    using clock = std::chrono::steady_clock;
+    auto compile_start = clock::now();
+    Compiled_Shape cshape(shape, p.jit_);
+    std::unique_ptr<unsigned char[]> pixels(
+        new unsigned char[p.size.x*p.size.y*4]);
+    auto render_start = clock::now();
+    cpu_render(cshape, p, p.size, p.fstart_, p.threads_, pixels.get());
+    auto render_end = clock::now();
+
+    if (p.verbose_) {
+        std::chrono::duration<double> compile_time =
+            render_start - compile_start;
+        std::chrono::duration<double> render_time =
+            render_end - render_start;
+        double npixels = double(p.size.x) * double(p.size.y);
+        std::cerr << "shape compile time: " << compile_time.count() << "s\n"
+            << "image render time: " << render_time.count() << "s ("
+            << npixels / render_time.count() << " pixels/s, "
+            << p.threads_ << " threads)\n";
+    }
+    write_png_rgb(ofile.path().c_str(), pixels.get(), p.size.x, p.size.y,
+        ofile.system_);
+}
+
 void
 export_png(
     const Shape_Program& shape,
     const Image_Export& p,
     Output_File& ofile)
 {
+    if (p.renderer_ == Image_Export::Renderer::cpu)
+        return export_png_cpu(shape, p, ofile);
+
     glm::dvec2 shape_size = shape.bbox_.size2();
     glm::dvec2 image_coverage = glm::dvec2(p.size) * p.pixel_size;
     glm::dvec2 overpaint = image_coverage - shape_size;
@@ -133,4 +184,239 @@ export_png(
         ofile.system_);
 }
 
+// Serializes the creation of temporary files by Output_File, whose names
+// are not unique across threads.
+static std::mutex tempfile_mutex;
+
+// Write an RGBA image (bottom row first) to a PNG file. Thread safe.
+static void
+write_png_file(
+    const Filesystem::path& path, unsigned char* pixels, glm::ivec2 size,
+    System& sys)
+{
+    Output_File ofile{sys};
+    ofile.set_path(path);
+    std::unique_lock<std::mutex> lock(tempfile_mutex);
+    Filesystem::path tmp = ofile.path();
+    lock.unlock();
+    write_png_rgb(tmp.c_str(), pixels, size.x, size.y, sys);
+    ofile.commit();
+}
+
+// A pool of threads that encode and write PNG files, so that encoding
+// overlaps with rendering. The queue is bounded, so that a renderer which
+// is faster than the encoders doesn't use unbounded memory.
+struct PNG_Writer
+{
+    struct Job
+    {
+        Filesystem::path path_;
+        std::unique_ptr<unsigned char[]> pixels_;
+    };
+
+    System& system_;
+    glm::ivec2 size_;
+    size_t max_queue_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Job> queue_;
+    bool closed_ = false;
+    std::exception_ptr error_ = nullptr;
+    std::vector<std::thread> threads_;
+
+    PNG_Writer(System& sys, glm::ivec2 size, unsigned nthreads)
+    :
+        system_(sys), size_(size), max_queue_(2*nthreads)
+    {
+        for (unsigned i = 0; i < nthreads; ++i)
+            threads_.emplace_back([this]() -> void { run(); });
+    }
+    ~PNG_Writer() { close(); }
+
+    // Queue an image to be written. Blocks while the queue is full.
+    void write(Filesystem::path path, std::unique_ptr<unsigned char[]> pixels)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&]{ return queue_.size() < max_queue_; });
+        queue_.push_back(Job{std::move(path), std::move(pixels)});
+        lock.unlock();
+        changed_.notify_all();
+    }
+
+    // Wait until all of the queued images are written. If writing an image
+    // failed, rethrow the first exception.
+    void finish()
+    {
+        close();
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+private:
+    void run()
+    {
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&]{ return closed_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            changed_.notify_all();
+            try {
+                write_png_file(job.path_, job.pixels_.get(), size_, system_);
+            } catch (...) {
+                lock.lock();
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+    }
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        changed_.notify_all();
+        for (auto& t : threads_) {
+            if (t.joinable()) t.join();
+        }
+    }
+};
+
+// Render the frames on the GPU. One hidden window is used for all of the
+// frames. Each frame is read back into a pixel buffer object, which is
+// mapped into CPU memory after the next frame has been drawn, so that the
+// transfer overlaps with rendering.
+static void
+export_png_frames_gpu(
+    const Shape_Program& shape,
+    const Image_Export& p,
+    const std::vector<Filesystem::path>& paths)
+{
+    const unsigned count = unsigned(paths.size());
+    const size_t nbytes = size_t(p.size.x) * size_t(p.size.y) * 4;
+    Render_Opts opts{ p };
+
+    viewer::Viewer v;
+    v.window_size_.x = p.size.x;
+    v.window_size_.y = p.size.y;
+    v.headless_ = true;
+    v.config_.verbose_ = p.verbose_;
+    v.set_shape_no_hud(shape, opts);
+    v.open();
+
+    PNG_Writer writer(shape.system_, p.size, p.threads_);
+    GLuint pbo[2];
+    glGenBuffers(2, pbo);
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, nbytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Copy frame i out of its pixel buffer, and queue it for encoding.
+    auto collect = [&](unsigned i) -> void {
+        std::unique_ptr<unsigned char[]> pixels(new unsigned char[nbytes]);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i % 2]);
+        auto data = (const unsigned char*)
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, nbytes, GL_MAP_READ_BIT);
+        if (data != nullptr)
+            memcpy(pixels.get(), data, nbytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (data == nullptr) {
+            throw Exception(At_System(shape.system_),
+                "PNG export: can't read pixels from the GPU");
+        }
+        writer.write(paths[i], std::move(pixels));
+    };
+
+    for (unsigned i = 0; i < count; ++i) {
+        // Draw each frame twice: see the comment in export_png.
+        double time = p.fstart_ + i * p.fdur_;
+        v.current_time_ = time;
+        v.draw_frame();
+        v.current_time_ = time;
+        v.draw_frame();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i % 2]);
+        glReadPixels(0, 0, p.size.x, p.size.y,
+            GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (i > 0)
+            collect(i - 1);
+    }
+    collect(count - 1);
+    glDeleteBuffers(2, pbo);
+    v.close();
+    writer.finish();
+}
+
+// Render the frames on the CPU. The shape is compiled once, then frames
+// are rendered concurrently, one per thread. Each thread encodes the frames
+// that it renders.
+static void
+export_png_frames_cpu(
+    const Shape_Program& shape,
+    const Image_Export& p,
+    const std::vector<Filesystem::path>& paths)
+{
+    check_cpu_opts(p, shape.system_);
+    Compiled_Shape cshape(shape, p.jit_);
+
+    const unsigned count = unsigned(paths.size());
+    const unsigned nworkers = std::max(1u, std::min(p.threads_, count));
+    const unsigned frame_threads = std::max(1u, p.threads_ / nworkers);
+    std::atomic<unsigned> next_frame{0};
+    std::mutex error_mutex;
+    std::exception_ptr error = nullptr;
+    auto work = [&]() -> void {
+        std::unique_ptr<unsigned char[]> pixels(
+            new unsigned char[p.size.x*p.size.y*4]);
+        for (;;) {
+            unsigned i = next_frame++;
+            if (i >= count) break;
+            try {
+                cpu_render(cshape, p, p.size, p.fstart_ + i * p.fdur_,
+                    frame_threads, pixels.get());
+                write_png_file(paths[i], pixels.get(), p.size, shape.system_);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next_frame = count;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < nworkers; ++i)
+        workers.emplace_back(work);
+    for (auto& w : workers)
+        w.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void
+export_png_frames(
+    const Shape_Program& shape,
+    const Image_Export& p,
+    const std::vector<Filesystem::path>& paths)
+{
+    if (paths.empty())
+        return;
+    auto start_time = std::chrono::steady_clock::now();
+    if (p.renderer_ == Image_Export::Renderer::cpu)
+        export_png_frames_cpu(shape, p, paths);
+    else
+        export_png_frames_gpu(shape, p, paths);
+    if (p.verbose_) {
+        std::chrono::duration<double> export_time =
+            std::chrono::steady_clock::now() - start_time;
+        std::cerr << paths.size() << " frames exported in "
+            << export_time.count() << "s ("
+            << paths.size() / export_time.count() << " frames/s)\n";
+    }
+}
+
 }} // namespace
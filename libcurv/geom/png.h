@@ -5,8 +5,11 @@
 #ifndef LIBCURV_GEOM_PNG_H
 #define LIBCURV_GEOM_PNG_H
 
+#include <libcurv/geom/compiled_shape.h>
+#include <libcurv/filesystem.h>
 #include <libcurv/render.h>
 #include <glm/vec2.hpp>
+#include <vector>
 
 namespace curv {
 struct Output_File;
@@ -22,9 +25,26 @@ struct Image_Export : public Render_Opts
     double pixel_size;  // Size of a square pixel, in shape space.
     double fstart_ = 0.0;  // Frame start time, in seconds, for animations.
     bool verbose_ = false;
+
+    // 'gpu' renders using OpenGL in a hidden window. 'cpu' renders using
+    // JIT compiled dist and colour functions (see cpu_render.h), and doesn't
+    // need a GPU or a display.
+    enum class Renderer { gpu, cpu };
+    Renderer renderer_ = Renderer::gpu;
+    Jit_Backend jit_ = Jit_Backend::cpp; // used by the cpu renderer
+    unsigned threads_ = 1; // used by the cpu renderer, and to encode frames
 };
 
 void export_png(const Shape_Program&, const Image_Export&, Output_File&);
 
+// Export an animation as a sequence of PNG files. Frame i is rendered at
+// time fstart_ + i*fdur_, and is written to paths[i]. The GPU renderer uses
+// one window for all of the frames, and overlaps reading back each frame
+// with drawing the next one, while threads_ threads encode the PNG files.
+// The CPU renderer renders up to threads_ frames concurrently.
+void export_png_frames(
+    const Shape_Program&, const Image_Export&,
+    const std::vector<Filesystem::path>& paths);
+
 }} // namespace
 #endif // header guard
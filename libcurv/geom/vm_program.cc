@@ -0,0 +1,1079 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/geom/vm_program.h>
+
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace curv { namespace geom {
+
+using Op = VM_Function::Op;
+using Instr = VM_Function::Instr;
+
+static inline uint32_t
+ubits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+static inline float
+fbits(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void
+execute(const Instr* code, size_t size, float* r)
+{
+    for (size_t pc = 0; pc < size; ) {
+        const Instr* i = &code[pc++];
+        unsigned n = i->n_;
+        float* d = r + i->d_;
+        const float* a = r + i->a_;
+        const float* b = r + i->b_;
+        const float* c = r + i->c_;
+        unsigned sa = i->sa_, sb = i->sb_, sc = i->sc_;
+      #define UNARY(expr) \
+        for (unsigned k = 0; k < n; ++k) { \
+            float x = a[k*sa]; (void)x; d[k] = (expr); \
+        } \
+        break;
+      #define BINARY(expr) \
+        for (unsigned k = 0; k < n; ++k) { \
+            float x = a[k*sa], y = b[k*sb]; d[k] = (expr); \
+        } \
+        break;
+      #define UBINARY(expr) \
+        for (unsigned k = 0; k < n; ++k) { \
+            uint32_t x = ubits(a[k*sa]), y = ubits(b[k*sb]); \
+            d[k] = fbits(expr); \
+        } \
+        break;
+        switch (i->op_) {
+        case Op::mov:        UNARY(x)
+        case Op::neg:        UNARY(-x)
+        case Op::add:        BINARY(x + y)
+        case Op::sub:        BINARY(x - y)
+        case Op::mul:        BINARY(x * y)
+        case Op::div:        BINARY(x / y)
+        case Op::pow:        BINARY(std::pow(x, y))
+        case Op::min:        BINARY(y < x ? y : x)
+        case Op::max:        BINARY(x < y ? y : x)
+        case Op::atan2:      BINARY(std::atan2(x, y))
+        case Op::sqrt:       UNARY(std::sqrt(x))
+        case Op::log:        UNARY(std::log(x))
+        case Op::abs:        UNARY(std::fabs(x))
+        case Op::floor:      UNARY(std::floor(x))
+        case Op::ceil:       UNARY(std::ceil(x))
+        case Op::trunc:      UNARY(std::trunc(x))
+        case Op::round_even: UNARY(std::nearbyint(x))
+        case Op::fract:      UNARY(x - std::floor(x))
+        case Op::sin:        UNARY(std::sin(x))
+        case Op::cos:        UNARY(std::cos(x))
+        case Op::tan:        UNARY(std::tan(x))
+        case Op::asin:       UNARY(std::asin(x))
+        case Op::acos:       UNARY(std::acos(x))
+        case Op::atan:       UNARY(std::atan(x))
+        case Op::sinh:       UNARY(std::sinh(x))
+        case Op::cosh:       UNARY(std::cosh(x))
+        case Op::tanh:       UNARY(std::tanh(x))
+        case Op::asinh:      UNARY(std::asinh(x))
+        case Op::acosh:      UNARY(std::acosh(x))
+        case Op::atanh:      UNARY(std::atanh(x))
+        case Op::lt:         BINARY(float(x < y))
+        case Op::gt:         BINARY(float(x > y))
+        case Op::le:         BINARY(float(x <= y))
+        case Op::ge:         BINARY(float(x >= y))
+        case Op::not_equal:  BINARY(float(x != y))
+        case Op::not_:       UNARY(float(x == 0.0f))
+        case Op::and_:       BINARY(float(x != 0.0f && y != 0.0f))
+        case Op::or_:        BINARY(float(x != 0.0f || y != 0.0f))
+        case Op::select:
+            for (unsigned k = 0; k < n; ++k)
+                d[k] = a[k*sa] != 0.0f ? b[k*sb] : c[k*sc];
+            break;
+        case Op::uadd:       UBINARY(x + y)
+        case Op::umul:       UBINARY(x * y)
+        case Op::band:       UBINARY(x & y)
+        case Op::bor:        UBINARY(x | y)
+        case Op::bxor:       UBINARY(x ^ y)
+        case Op::bnot:
+            for (unsigned k = 0; k < n; ++k)
+                d[k] = fbits(~ubits(a[k*sa]));
+            break;
+        case Op::shl:
+        case Op::shr:
+            for (unsigned k = 0; k < n; ++k) {
+                uint32_t x = ubits(a[k*sa]);
+                float y = b[k*sb];
+                uint32_t z = 0;
+                if (y >= 0.0f && y < 32.0f)
+                    z = i->op_ == Op::shl ? x << int(y) : x >> int(y);
+                d[k] = fbits(z);
+            }
+            break;
+        case Op::equal:
+        case Op::unequal:
+          {
+            bool eq = true;
+            for (unsigned k = 0; k < n; ++k)
+                eq = eq && a[k] == b[k];
+            d[0] = float(i->op_ == Op::equal ? eq : !eq);
+            break;
+          }
+        case Op::uequal:
+        case Op::uunequal:
+          {
+            bool eq = memcmp(a, b, n * sizeof(float)) == 0;
+            d[0] = float(i->op_ == Op::uequal ? eq : !eq);
+            break;
+          }
+        case Op::dot:
+          {
+            float sum = 0.0f;
+            for (unsigned k = 0; k < n; ++k)
+                sum += a[k] * b[k];
+            d[0] = sum;
+            break;
+          }
+        case Op::length:
+          {
+            float sum = 0.0f;
+            for (unsigned k = 0; k < n; ++k)
+                sum += a[k] * a[k];
+            d[0] = std::sqrt(sum);
+            break;
+          }
+        case Op::index:
+          {
+            // Out of range indexes are undefined behaviour in C++ and GLSL.
+            // We clamp them, so that we don't access outside the registers.
+            float fi = b[0];
+            uint32_t len = i->c_;
+            uint32_t ix = fi >= 1.0f
+                ? (fi < float(len) ? uint32_t(fi) : len - 1)
+                : 0;
+            memcpy(d, a + ix*n, n * sizeof(float));
+            break;
+          }
+        case Op::jump:
+            pc = i->d_;
+            break;
+        case Op::jump_if_false:
+            if (a[0] == 0.0f)
+                pc = i->d_;
+            break;
+        case Op::jump_if_true:
+            if (a[0] != 0.0f)
+                pc = i->d_;
+            break;
+        }
+      #undef UNARY
+      #undef BINARY
+      #undef UBINARY
+    }
+}
+
+void
+VM_Function::run(float* regs) const
+{
+    execute(code_.data(), code_.size(), regs);
+}
+
+void
+VM_Function::call(const float* in, float* out, float* regs) const
+{
+    memcpy(regs + in_, in, nin_ * sizeof(float));
+    run(regs);
+    memcpy(out, regs + out_, nout_ * sizeof(float));
+}
+
+// The register files of the current thread. A shape calls several
+// functions in turn (dist, colour, ...), so a few are kept, each labelled
+// with the serial number of the function that last used it. Serial numbers,
+// unlike addresses, aren't reused when a VM_Program is destroyed.
+namespace {
+struct Register_Cache
+{
+    static constexpr unsigned size = 4;
+    uint64_t serial_[size] = {};
+    std::vector<float> regs_[size];
+    unsigned next_ = 0;
+};
+thread_local Register_Cache register_cache;
+std::atomic<uint64_t> next_serial{1};
+} // namespace
+
+float*
+VM_Function::thread_registers() const
+{
+    auto& rc = register_cache;
+    for (unsigned i = 0; i < Register_Cache::size; ++i) {
+        if (rc.serial_[i] == serial_)
+            return rc.regs_[i].data();
+    }
+    unsigned i = rc.next_;
+    rc.next_ = (i + 1) % Register_Cache::size;
+    rc.serial_[i] = serial_;
+    rc.regs_[i] = init_;
+    return rc.regs_[i].data();
+}
+
+namespace {
+
+enum class Kind { num, boolean, uint };
+
+// A value stored in the register file.
+struct Operand
+{
+    uint32_t reg_ = 0;
+    unsigned n_ = 1;        // number of components per element
+    unsigned len_ = 0;      // number of elements if an array, else 0
+    Kind kind_ = Kind::num;
+    bool temp_ = false;     // result of an operation, not yet named
+    bool literal_ = false;  // a numeric literal, with value value_
+    float value_ = 0.0f;
+
+    unsigned size() const { return len_ ? n_ * len_ : n_; }
+};
+
+struct Token
+{
+    enum Type { end, ident, number, string, punct, body_marker } type_;
+    std::string text_;
+};
+
+static bool
+lookup_type(const std::string& name, unsigned& n, Kind& kind)
+{
+    static const struct { const char* name; unsigned n; Kind kind; }
+    types[] = {
+        {"float", 1, Kind::num}, {"vec2", 2, Kind::num},
+        {"vec3", 3, Kind::num}, {"vec4", 4, Kind::num},
+        {"bool", 1, Kind::boolean}, {"bvec2", 2, Kind::boolean},
+        {"bvec3", 3, Kind::boolean}, {"bvec4", 4, Kind::boolean},
+        {"uint", 1, Kind::uint}, {"uvec2", 2, Kind::uint},
+        {"uvec3", 3, Kind::uint}, {"uvec4", 4, Kind::uint},
+    };
+    for (auto& ty : types) {
+        if (name == ty.name) {
+            n = ty.n;
+            kind = ty.kind;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse the C++ code generated by SC_Compiler, and lower it to VM code.
+struct VM_Compiler
+{
+    const Context& cx_;
+    std::vector<Token> toks_;
+    size_t pos_ = 0;
+
+    VM_Function* fn_ = nullptr;
+    size_t body_pc_ = 0;
+    bool in_body_ = false;
+    std::vector<bool> read_only_;
+    std::map<std::string, Operand> vars_;
+    std::map<uint32_t, uint32_t> literals_;
+    std::vector<std::vector<size_t>> breaks_;
+
+    VM_Compiler(const std::string& src, const Context& cx)
+    :
+        cx_(cx)
+    {
+        tokenize(src);
+    }
+
+    template <typename... Args>
+    [[noreturn]] void error(Args&&... args)
+    {
+        throw Exception(cx_, stringify("VM compiler: ", args...));
+    }
+
+    void tokenize(const std::string& src)
+    {
+        const char* p = src.c_str();
+        for (;;) {
+            while (isspace(*p)) ++p;
+            if (*p == '\0') break;
+            const char* start = p;
+            if (p[0] == '/' && p[1] == '*') {
+                const char* e = strstr(p+2, "*/");
+                if (e == nullptr) error("unterminated comment");
+                p = e + 2;
+                if (std::string(start, p) == "/* body */")
+                    toks_.push_back({Token::body_marker, {}});
+                continue;
+            }
+            if (isalpha(*p) || *p == '_') {
+                while (isalnum(*p) || *p == '_') ++p;
+                toks_.push_back({Token::ident, {start, p}});
+            } else if (isdigit(*p) || (*p == '.' && isdigit(p[1]))) {
+                while (isalnum(*p) || *p == '.'
+                    || ((*p == '+' || *p == '-')
+                        && (p[-1] == 'e' || p[-1] == 'E')))
+                    ++p;
+                toks_.push_back({Token::number, {start, p}});
+            } else if (*p == '"') {
+                ++p;
+                while (*p != '"' && *p != '\0') ++p;
+                if (*p == '\0') error("unterminated string");
+                ++p;
+                toks_.push_back({Token::string, {start, p}});
+            } else {
+                static const char* const two[] = {
+                    "==", "!=", "<=", ">=", "&&", "||", "+=", "<<", ">>"
+                };
+                size_t len = 1;
+                for (auto t : two)
+                    if (p[0] == t[0] && p[1] == t[1]) len = 2;
+                p += len;
+                toks_.push_back({Token::punct, {start, p}});
+            }
+        }
+        toks_.push_back({Token::end, {}});
+    }
+
+    const Token& peek(size_t i = 0) const
+    {
+        return toks_[std::min(pos_ + i, toks_.size() - 1)];
+    }
+    bool at(const char* s) const
+    {
+        auto& t = peek();
+        return (t.type_ == Token::punct || t.type_ == Token::ident)
+            && t.text_ == s;
+    }
+    bool accept(const char* s)
+    {
+        if (at(s)) { ++pos_; return true; }
+        return false;
+    }
+    void expect(const char* s)
+    {
+        if (!accept(s))
+            error("expected '", s, "', got '", peek().text_, "'");
+    }
+    std::string ident()
+    {
+        if (peek().type_ != Token::ident)
+            error("expected identifier, got '", peek().text_, "'");
+        return toks_[pos_++].text_;
+    }
+
+    // Registers and code generation.
+    //
+    // Registers are never reused. Literals, and the registers written by the
+    // constants section (the code before the /* body */ marker), are
+    // read-only in the body. VM_Function::thread_registers() relies on this:
+    // it reuses a register file from one call to the next without restoring
+    // init_. The parameter and result registers are rewritten by each call.
+    uint32_t alloc(unsigned n)
+    {
+        uint32_t r = fn_->init_.size();
+        fn_->init_.resize(r + n, 0.0f);
+        return r;
+    }
+    Operand temp(unsigned n, Kind kind)
+    {
+        Operand t;
+        t.reg_ = alloc(n);
+        t.n_ = n;
+        t.kind_ = kind;
+        t.temp_ = true;
+        return t;
+    }
+    Operand literal(float value, Kind kind)
+    {
+        uint32_t bits = ubits(value);
+        auto i = literals_.find(bits);
+        Operand lit;
+        if (i != literals_.end())
+            lit.reg_ = i->second;
+        else {
+            lit.reg_ = alloc(1);
+            fn_->init_[lit.reg_] = value;
+            read_only_.resize(fn_->init_.size(), false);
+            read_only_[lit.reg_] = true;
+            literals_[bits] = lit.reg_;
+        }
+        lit.kind_ = kind;
+        lit.literal_ = true;
+        lit.value_ = value;
+        return lit;
+    }
+    size_t emit(Op op, unsigned n, uint32_t d,
+        const Operand& a = {}, const Operand& b = {}, const Operand& c = {})
+    {
+        assert(!in_body_ || op >= Op::jump
+            || d >= read_only_.size() || !read_only_[d]);
+        Instr i;
+        i.op_ = op;
+        i.n_ = n;
+        i.d_ = d;
+        i.a_ = a.reg_;
+        i.b_ = b.reg_;
+        i.c_ = c.reg_;
+        i.sa_ = a.n_ == 1 && n > 1 ? 0 : 1;
+        i.sb_ = b.n_ == 1 && n > 1 ? 0 : 1;
+        i.sc_ = c.n_ == 1 && n > 1 ? 0 : 1;
+        fn_->code_.push_back(i);
+        return fn_->code_.size() - 1;
+    }
+    size_t emit_jump(Op op, const Operand& cond = {})
+    {
+        return emit(op, 1, 0, cond);
+    }
+    void patch(size_t jump)
+    {
+        fn_->code_[jump].d_ = fn_->code_.size();
+    }
+    void mov(uint32_t d, const Operand& src, unsigned n)
+    {
+        emit(Op::mov, n, d, src);
+    }
+
+    void check_vector(const Operand& x)
+    {
+        if (x.len_ != 0) error("array used as a vector");
+    }
+    // Result size of a component-wise operation, with scalar broadcasting.
+    unsigned cw_size(std::initializer_list<const Operand*> args)
+    {
+        unsigned n = 1;
+        for (auto a : args) {
+            check_vector(*a);
+            if (a->n_ == 1) continue;
+            if (n != 1 && a->n_ != n) error("vector size mismatch");
+            n = a->n_;
+        }
+        return n;
+    }
+    Operand unary(Op op, Operand a, Kind kind)
+    {
+        unsigned n = cw_size({&a});
+        auto r = temp(n, kind);
+        emit(op, n, r.reg_, a);
+        return r;
+    }
+    Operand binary(Op op, Operand a, Operand b, Kind kind)
+    {
+        unsigned n = cw_size({&a, &b});
+        auto r = temp(n, kind);
+        emit(op, n, r.reg_, a, b);
+        return r;
+    }
+    Operand reduce(Op op, Operand a, Operand b, Kind kind)
+    {
+        check_vector(a);
+        check_vector(b);
+        if (a.n_ != b.n_) error("vector size mismatch");
+        auto r = temp(1, kind);
+        emit(op, a.n_, r.reg_, a, b);
+        return r;
+    }
+
+    bool parse_type(unsigned& n, Kind& kind)
+    {
+        auto& t = peek();
+        if (t.type_ != Token::ident) return false;
+        if (lookup_type(t.text_, n, kind)) {
+            ++pos_;
+            return true;
+        }
+        if (t.text_.compare(0, 3, "mat") == 0)
+            error("type ", t.text_, " is not supported");
+        return false;
+    }
+
+    // Expressions, in order of increasing precedence.
+    Operand expr()
+    {
+        auto cond = logical_or();
+        if (!accept("?")) return cond;
+        auto a = expr();
+        expect(":");
+        auto b = expr();
+        if (cond.n_ != 1) error("condition is not a scalar");
+        unsigned n = cw_size({&a, &b});
+        auto r = temp(n, a.kind_);
+        emit(Op::select, n, r.reg_, cond, a, b);
+        return r;
+    }
+    Operand logical_or()
+    {
+        auto a = logical_and();
+        while (accept("||"))
+            a = binary(Op::or_, a, logical_and(), Kind::boolean);
+        return a;
+    }
+    Operand logical_and()
+    {
+        auto a = bit_or();
+        while (accept("&&"))
+            a = binary(Op::and_, a, bit_or(), Kind::boolean);
+        return a;
+    }
+    Operand bit_or()
+    {
+        auto a = bit_xor();
+        while (accept("|"))
+            a = binary(Op::bor, a, bit_xor(), Kind::uint);
+        return a;
+    }
+    Operand bit_xor()
+    {
+        auto a = bit_and();
+        while (accept("^"))
+            a = binary(Op::bxor, a, bit_and(), Kind::uint);
+        return a;
+    }
+    Operand bit_and()
+    {
+        auto a = equality();
+        while (accept("&"))
+            a = binary(Op::band, a, equality(), Kind::uint);
+        return a;
+    }
+    Operand equality()
+    {
+        auto a = relational();
+        for (;;) {
+            bool eq;
+            if (accept("==")) eq = true;
+            else if (accept("!=")) eq = false;
+            else return a;
+            auto b = relational();
+            if (a.kind_ == Kind::uint)
+                a = reduce(eq ? Op::uequal : Op::uunequal, a, b,
+                    Kind::boolean);
+            else
+                a = reduce(eq ? Op::equal : Op::unequal, a, b,
+                    Kind::boolean);
+        }
+    }
+    Operand relational()
+    {
+        auto a = shift();
+        for (;;) {
+            Op op;
+            if (accept("<")) op = Op::lt;
+            else if (accept(">")) op = Op::gt;
+            else if (accept("<=")) op = Op::le;
+            else if (accept(">=")) op = Op::ge;
+            else return a;
+            a = binary(op, a, shift(), Kind::boolean);
+        }
+    }
+    Operand shift()
+    {
+        auto a = additive();
+        for (;;) {
+            Op op;
+            if (accept("<<")) op = Op::shl;
+            else if (accept(">>")) op = Op::shr;
+            else return a;
+            a = binary(op, a, additive(), Kind::uint);
+        }
+    }
+    Operand additive()
+    {
+        auto a = multiplicative();
+        for (;;) {
+            if (accept("+"))
+                a = binary(a.kind_ == Kind::uint ? Op::uadd : Op::add,
+                    a, multiplicative(), a.kind_);
+            else if (accept("-"))
+                a = binary(Op::sub, a, multiplicative(), Kind::num);
+            else
+                return a;
+        }
+    }
+    Operand multiplicative()
+    {
+        auto a = prefix();
+        for (;;) {
+            if (accept("*"))
+                a = binary(a.kind_ == Kind::uint ? Op::umul : Op::mul,
+                    a, prefix(), a.kind_);
+            else if (accept("/"))
+                a = binary(Op::div, a, prefix(), Kind::num);
+            else
+                return a;
+        }
+    }
+    Operand prefix()
+    {
+        if (accept("-")) {
+            auto a = prefix();
+            if (a.literal_)
+                return literal(-a.value_, a.kind_);
+            return unary(Op::neg, a, Kind::num);
+        }
+        if (accept("!"))
+            return unary(Op::not_, prefix(), Kind::boolean);
+        if (accept("~"))
+            return unary(Op::bnot, prefix(), Kind::uint);
+        return postfix();
+    }
+    Operand postfix()
+    {
+        auto a = primary();
+        for (;;) {
+            if (accept(".")) {
+                auto sw = ident();
+                static const char letters[] = "xyzw";
+                const char* p = strchr(letters, sw[0]);
+                if (sw.size() != 1 || p == nullptr)
+                    error("unsupported swizzle .", sw);
+                a = component(a, unsigned(p - letters));
+            } else if (accept("[")) {
+                auto ix = expr();
+                expect("]");
+                a = index(a, ix);
+            } else
+                return a;
+        }
+    }
+    Operand component(Operand a, unsigned i)
+    {
+        check_vector(a);
+        if (i >= a.n_) error("vector index out of range");
+        Operand r = a;
+        r.reg_ += i;
+        r.n_ = 1;
+        r.temp_ = false;
+        r.literal_ = false;
+        return r;
+    }
+    Operand index(Operand a, Operand ix)
+    {
+        unsigned n = a.len_ ? a.n_ : 1;
+        unsigned len = a.len_ ? a.len_ : a.n_;
+        if (ix.literal_) {
+            if (!(ix.value_ >= 0.0f && ix.value_ < float(len)))
+                error("index out of range");
+            Operand r = a;
+            r.reg_ += unsigned(ix.value_) * n;
+            r.n_ = n;
+            r.len_ = 0;
+            r.temp_ = false;
+            r.literal_ = false;
+            return r;
+        }
+        auto r = temp(n, a.kind_);
+        Instr i;
+        i.op_ = Op::index;
+        i.n_ = n;
+        i.sa_ = i.sb_ = i.sc_ = 1;
+        i.d_ = r.reg_;
+        i.a_ = a.reg_;
+        i.b_ = ix.reg_;
+        i.c_ = len;
+        fn_->code_.push_back(i);
+        return r;
+    }
+    Operand primary()
+    {
+        auto& t = peek();
+        if (t.type_ == Token::number) {
+            ++pos_;
+            const char* s = t.text_.c_str();
+            char* end;
+            if (t.text_.back() == 'u') {
+                unsigned long u = strtoul(s, &end, 10);
+                if (*end != 'u') error("bad number ", t.text_);
+                return literal(fbits(uint32_t(u)), Kind::uint);
+            }
+            double d = strtod(s, &end);
+            if (*end != '\0') error("bad number ", t.text_);
+            return literal(float(d), Kind::num);
+        }
+        if (accept("(")) {
+            auto a = expr();
+            expect(")");
+            return a;
+        }
+        if (accept("true")) return literal(1.0f, Kind::boolean);
+        if (accept("false")) return literal(0.0f, Kind::boolean);
+        auto name = ident();
+        if (accept("(")) {
+            std::vector<Operand> args;
+            if (!accept(")")) {
+                do args.push_back(expr()); while (accept(","));
+                expect(")");
+            }
+            return call(name, args);
+        }
+        auto v = vars_.find(name);
+        if (v == vars_.end())
+            error("unknown identifier ", name);
+        return v->second;
+    }
+
+    Operand call(const std::string& name, std::vector<Operand>& args)
+    {
+        static const struct { const char* name; Op op; } unary_ops[] = {
+            {"sqrt", Op::sqrt}, {"log", Op::log}, {"abs", Op::abs},
+            {"floor", Op::floor}, {"ceil", Op::ceil}, {"trunc", Op::trunc},
+            {"roundEven", Op::round_even}, {"fract", Op::fract},
+            {"sin", Op::sin}, {"cos", Op::cos}, {"tan", Op::tan},
+            {"asin", Op::asin}, {"acos", Op::acos}, {"atan", Op::atan},
+            {"sinh", Op::sinh}, {"cosh", Op::cosh}, {"tanh", Op::tanh},
+            {"asinh", Op::asinh}, {"acosh", Op::acosh}, {"atanh", Op::atanh},
+        };
+        auto nargs = [&](size_t n) {
+            if (args.size() != n)
+                error(name, ": wrong number of arguments");
+        };
+
+        // type conversions and constructors
+        unsigned n;
+        Kind kind;
+        if (lookup_type(name, n, kind)) {
+            if (n == 1) {
+                nargs(1);
+                // float(bool) and bool(float) are no-ops, because a bool
+                // is stored as 0 or 1.
+                if (kind == Kind::uint || args[0].kind_ == Kind::uint)
+                    error(name, ": unsupported conversion");
+                Operand r = args[0];
+                r.kind_ = kind;
+                return r;
+            }
+            unsigned total = 0;
+            for (auto& a : args) {
+                check_vector(a);
+                total += a.n_;
+            }
+            if (args.size() == 1 && args[0].n_ == 1)
+                total = n;
+            if (total != n) error(name, ": wrong number of components");
+            auto r = temp(n, kind);
+            unsigned i = 0;
+            for (auto& a : args) {
+                unsigned an = args.size() == 1 ? n : a.n_;
+                emit(Op::mov, an, r.reg_ + i, a);
+                i += an;
+            }
+            return r;
+        }
+        if (name == "int") {
+            nargs(1);
+            return unary(Op::trunc, args[0], Kind::num);
+        }
+        for (auto& u : unary_ops) {
+            if (name == u.name) {
+                if (name == "atan" && args.size() == 2)
+                    return binary(Op::atan2, args[0], args[1], Kind::num);
+                nargs(1);
+                return unary(u.op, args[0], Kind::num);
+            }
+        }
+        if (name == "pow" || name == "min" || name == "max") {
+            nargs(2);
+            Op op = name == "pow" ? Op::pow
+                  : name == "min" ? Op::min : Op::max;
+            return binary(op, args[0], args[1], Kind::num);
+        }
+        if (name == "dot") {
+            nargs(2);
+            return reduce(Op::dot, args[0], args[1], Kind::num);
+        }
+        if (name == "length") {
+            nargs(1);
+            return reduce(Op::length, args[0], args[0], Kind::num);
+        }
+        if (name == "notEqual") {
+            nargs(2);
+            return binary(Op::not_equal, args[0], args[1], Kind::boolean);
+        }
+        if (name == "uintBitsToFloat" || name == "floatBitsToUint") {
+            nargs(1);
+            Operand r = args[0];
+            r.kind_ = name[0] == 'u' ? Kind::num : Kind::uint;
+            return r;
+        }
+        error("unsupported function ", name);
+    }
+
+    // Statements.
+    void block()
+    {
+        while (!accept("}"))
+            statement();
+    }
+    void statement()
+    {
+        if (peek().type_ == Token::body_marker) {
+            ++pos_;
+            body_pc_ = fn_->code_.size();
+            in_body_ = true;
+            read_only_.assign(fn_->init_.size(), true);
+            for (unsigned i = 0; i < fn_->nin_; ++i)
+                read_only_[fn_->in_ + i] = false;
+            for (unsigned i = 0; i < fn_->nout_; ++i)
+                read_only_[fn_->out_ + i] = false;
+            return;
+        }
+        if (accept("if")) {
+            expect("(");
+            auto cond = expr();
+            expect(")");
+            if (accept("break")) {
+                expect(";");
+                if (breaks_.empty()) error("break outside of loop");
+                breaks_.back().push_back(emit_jump(Op::jump_if_true, cond));
+                return;
+            }
+            expect("{");
+            auto jf = emit_jump(Op::jump_if_false, cond);
+            block();
+            if (accept("else")) {
+                expect("{");
+                auto j = emit_jump(Op::jump);
+                patch(jf);
+                block();
+                patch(j);
+            } else
+                patch(jf);
+            return;
+        }
+        if (accept("while")) {
+            expect("(");
+            size_t top = fn_->code_.size();
+            auto cond = expr();
+            expect(")");
+            expect("{");
+            breaks_.emplace_back();
+            if (!cond.literal_ || cond.value_ == 0.0f)
+                breaks_.back().push_back(emit_jump(Op::jump_if_false, cond));
+            loop_body(top);
+            return;
+        }
+        if (accept("for")) {
+            expect("(");
+            declaration();
+            size_t top = fn_->code_.size();
+            auto cond = expr();
+            expect(";");
+            auto var = ident();
+            expect("+=");
+            auto step = expr();
+            expect(")");
+            expect("{");
+            breaks_.emplace_back();
+            breaks_.back().push_back(emit_jump(Op::jump_if_false, cond));
+            block();
+            auto& v = vars_.at(var);
+            emit(Op::add, v.n_, v.reg_, v, step);
+            emit(Op::jump, 1, top);
+            for (auto j : breaks_.back())
+                patch(j);
+            breaks_.pop_back();
+            return;
+        }
+        if (accept("break")) {
+            expect(";");
+            if (breaks_.empty()) error("break outside of loop");
+            breaks_.back().push_back(emit_jump(Op::jump));
+            return;
+        }
+        if (accept("*")) {
+            expect("result");
+            expect("=");
+            auto val = expr();
+            expect(";");
+            if (val.size() != fn_->nout_) error("wrong result type");
+            mov(fn_->out_, val, fn_->nout_);
+            return;
+        }
+        if (peek().type_ == Token::ident && peek(1).type_ == Token::ident) {
+            declaration();
+            return;
+        }
+        // assignment
+        auto lhs = postfix();
+        expect("=");
+        auto val = expr();
+        expect(";");
+        if (val.size() != lhs.size()) error("type mismatch in assignment");
+        mov(lhs.reg_, val, lhs.size());
+    }
+    void loop_body(size_t top)
+    {
+        block();
+        emit(Op::jump, 1, top);
+        for (auto j : breaks_.back())
+            patch(j);
+        breaks_.pop_back();
+    }
+    // T name = expr; or T name[] = {expr,...}; or T name;
+    void declaration()
+    {
+        unsigned n;
+        Kind kind;
+        if (!parse_type(n, kind))
+            error("unknown type ", peek().text_);
+        auto name = ident();
+        if (accept(";")) {
+            // assigned later, in each arm of a conditional
+            Operand var;
+            var.reg_ = alloc(n);
+            var.n_ = n;
+            var.kind_ = kind;
+            vars_[name] = var;
+            return;
+        }
+        if (accept("[")) {
+            expect("]");
+            expect("=");
+            expect("{");
+            std::vector<Operand> elems;
+            do elems.push_back(expr()); while (accept(","));
+            expect("}");
+            expect(";");
+            Operand arr;
+            arr.reg_ = alloc(n * elems.size());
+            arr.n_ = n;
+            arr.len_ = elems.size();
+            arr.kind_ = kind;
+            for (size_t i = 0; i < elems.size(); ++i) {
+                if (elems[i].size() != n) error("bad array element");
+                mov(arr.reg_ + i*n, elems[i], n);
+            }
+            vars_[name] = arr;
+            return;
+        }
+        expect("=");
+        if (accept("*")) {
+            // the function parameter: use it in place
+            auto param = ident();
+            if (param != "param0") error("unknown parameter ", param);
+            if (n != fn_->nin_) error("wrong parameter type");
+            Operand in;
+            in.reg_ = fn_->in_;
+            in.n_ = n;
+            in.kind_ = kind;
+            vars_[name] = in;
+            expect(";");
+            return;
+        }
+        auto val = expr();
+        expect(";");
+        check_vector(val);
+        if (val.n_ != n) error("type mismatch in definition of ",name);
+        if (val.temp_) {
+            // The result of an operation becomes the variable.
+            val.temp_ = false;
+            val.kind_ = kind;
+            vars_[name] = val;
+            return;
+        }
+        Operand var;
+        var.reg_ = alloc(n);
+        var.n_ = n;
+        var.kind_ = kind;
+        mov(var.reg_, val, n);
+        vars_[name] = var;
+    }
+
+    // extern "C" void name(const T* param0, T* result) { ... }
+    void function(std::string& name, VM_Function& fn)
+    {
+        fn_ = &fn;
+        body_pc_ = 0;
+        in_body_ = false;
+        read_only_.clear();
+        vars_.clear();
+        literals_.clear();
+
+        expect("extern");
+        if (peek().type_ != Token::string) error("expected \"C\"");
+        ++pos_;
+        expect("void");
+        name = ident();
+        expect("(");
+        unsigned n;
+        Kind kind;
+        expect("const");
+        if (!parse_type(n, kind)) error("bad parameter type");
+        expect("*");
+        expect("param0");
+        fn.nin_ = n;
+        fn.in_ = alloc(n);
+        expect(",");
+        if (!parse_type(n, kind)) error("bad result type");
+        expect("*");
+        expect("result");
+        expect(")");
+        fn.nout_ = n;
+        fn.out_ = alloc(n);
+        expect("{");
+        block();
+
+        // The code before the /* body */ marker computes constants.
+        // Run it now, then remove it.
+        auto& code = fn.code_;
+        execute(code.data(), body_pc_, fn.init_.data());
+        code.erase(code.begin(), code.begin() + body_pc_);
+        for (auto& i : code) {
+            if (i.op_ == Op::jump || i.op_ == Op::jump_if_false
+                || i.op_ == Op::jump_if_true)
+            {
+                i.d_ -= body_pc_;
+            }
+        }
+        fn_ = nullptr;
+    }
+};
+
+} // namespace
+
+VM_Program::VM_Program(System& sys)
+:
+    system_{sys},
+    source_{},
+    sc_{source_, SC_Target::cpp, sys}
+{
+}
+
+void
+VM_Program::compile(const Context& cx)
+{
+    VM_Compiler c(source_.str(), cx);
+    while (c.peek().type_ != Token::end) {
+        std::string name;
+        VM_Function fn;
+        c.function(name, fn);
+        fn.serial_ = next_serial++;
+        functions_[name] = std::move(fn);
+    }
+}
+
+const VM_Function&
+VM_Program::get_function(const char* name)
+{
+    auto f = functions_.find(name);
+    if (f == functions_.end()) {
+        throw Exception(At_System{system_},
+            stringify("can't load function ",name));
+    }
+    return f->second;
+}
+
+}} // namespace
@@ -0,0 +1,112 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#ifndef LIBCURV_GEOM_VM_PROGRAM_H
+#define LIBCURV_GEOM_VM_PROGRAM_H
+
+#include <libcurv/sc_compiler.h>
+#include <libcurv/system.h>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace curv { namespace geom {
+
+// A function compiled to code for a register machine. All values are stored
+// in a flat array of float registers: a vec3 occupies 3 consecutive registers,
+// and a bool is stored as 0 or 1.
+//
+// A VM_Function is immutable once compiled, and may be called concurrently
+// from multiple threads, provided each thread has its own register file.
+struct VM_Function
+{
+    enum class Op : uint8_t
+    {
+        // component-wise operations on n components
+        mov, neg, add, sub, mul, div, pow, min, max, atan2,
+        sqrt, log, abs, floor, ceil, trunc, round_even, fract,
+        sin, cos, tan, asin, acos, atan, sinh, cosh, tanh,
+        asinh, acosh, atanh,
+        lt, gt, le, ge, not_equal, not_, and_, or_, select,
+
+        // component-wise operations on Bool32 values (uint bit patterns)
+        uadd, umul, band, bor, bxor, bnot, shl, shr,
+
+        // operations on an n component vector with a scalar result
+        equal, unequal, uequal, uunequal, dot, length,
+
+        // d[0..n] = a[clamp(int(b[0]),0,c-1)*n ...]
+        index,
+
+        // control flow: d is the target instruction
+        jump, jump_if_false, jump_if_true
+    };
+    struct Instr
+    {
+        Op op_;
+        uint8_t n_;
+        // Operand strides: 1 for a vector, 0 to broadcast a scalar.
+        uint8_t sa_, sb_, sc_;
+        uint32_t d_, a_, b_, c_;
+    };
+
+    std::vector<Instr> code_;
+    // The initial contents of the register file. Constants are evaluated
+    // at compile time, and stored here.
+    std::vector<float> init_;
+    uint32_t in_ = 0, out_ = 0;   // register offsets of parameter and result
+    unsigned nin_ = 0, nout_ = 0; // number of floats in parameter and result
+    uint64_t serial_ = 0;         // unique among the functions ever compiled
+
+    // Make a register file for calling this function.
+    std::vector<float> make_registers() const { return init_; }
+
+    // A register file owned by the current thread, which is reused by each
+    // call to this function on this thread. The code never writes the
+    // constant registers, so init_ is only copied when the thread's register
+    // file was last used by a different function.
+    float* thread_registers() const;
+
+    // Call the function, using a register file from make_registers().
+    void call(const float* in, float* out, float* regs) const;
+
+    // Execute the code on a register file from make_registers().
+    void run(float* regs) const;
+};
+
+// An in-process alternative to Cpp_Program, which doesn't need a C++
+// compiler. SubCurv functions are compiled by SC_Compiler to C++ (an SSA
+// subset of C++ using GLSL vector types), which is then parsed and lowered
+// to VM_Function code. Compilation takes milliseconds.
+//
+// Uniform variables and matrix types are not supported.
+struct VM_Program
+{
+    System& system_;
+    std::stringstream source_;
+    SC_Compiler sc_;
+    std::map<std::string, VM_Function> functions_;
+
+    VM_Program(System&);
+    inline void define_function(
+        const char* name, SC_Type param_type, SC_Type result_type,
+        Shared<const Function> func, const Context& cx)
+    {
+        sc_.define_function(name, param_type, result_type, func, cx);
+    }
+    inline void define_fused_function(
+        const char* name, SC_Type param_type, SC_Type result_type,
+        std::vector<Shared<const Function>> funcs, const Context& cx)
+    {
+        sc_.define_fused_function(name, param_type, result_type,
+            std::move(funcs), cx);
+    }
+    void compile(const Context& cx);
+    const VM_Function& get_function(const char* name);
+};
+
+}} // namespace
+#endif // include guard
@@ -9,10 +9,82 @@
 #include <libcurv/exception.h>
 #include <libcurv/program.h>
 #include <libcurv/system.h>
+#include <algorithm>
 #include <cstdlib>
+#include <fstream>
+#include <iterator>
 
 namespace curv {
 
+namespace {
+
+// FNV-1a hash of a byte string.
+uint64_t hash_bytes(const char* p, size_t n)
+{
+    uint64_t h = 14695981039346656037u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)p[i];
+        h *= 1099511628211u;
+    }
+    return h;
+}
+
+// Record that 'files' were imported, in the dependency list of each Curv
+// source file that is currently being imported.
+void record_files(System& sys, const System::File_Hashes& files)
+{
+    std::lock_guard<std::mutex> lock(sys.import_mutex_);
+    for (auto deps : sys.import_state().import_deps_) {
+        for (auto& f : files) {
+            if (std::find(deps->begin(), deps->end(), f) == deps->end())
+                deps->push_back(f);
+        }
+    }
+}
+
+} // namespace
+
+uint64_t hash_file(const Filesystem::path& path)
+{
+    boost::system::error_code errcode;
+    if (Filesystem::is_directory(path, errcode)) {
+        std::vector<std::string> names;
+        for (auto& e : Filesystem::directory_iterator(path, errcode))
+            names.push_back(e.path().filename().string());
+        std::sort(names.begin(), names.end());
+        std::string data;
+        for (auto& n : names)
+            data += n + '/';
+        return hash_bytes(data.data(), data.size());
+    }
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+        return 0;
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+    return hash_bytes(data.data(), data.size());
+}
+
+bool files_unchanged(const System::File_Hashes& files)
+{
+    for (auto& f : files) {
+        if (hash_file(f.first) != f.second)
+            return false;
+    }
+    return true;
+}
+
+void record_import(System& sys, const Filesystem::path& path)
+{
+    if (!sys.import_state().import_deps_.empty()) {
+        boost::system::error_code errcode;
+        auto file = Filesystem::canonical(path, errcode);
+        if (errcode)
+            file = path;
+        record_files(sys, {{file, hash_file(file)}});
+    }
+}
+
 Value import(const Filesystem::path& path, const Context& cx)
 {
     System& sys{cx.system()};
@@ -31,9 +103,12 @@ Value import(const Filesystem::path& path, const Context& cx)
 
     // Import file based on extension
     auto importp = sys.importers_.find(ext);
-    if (importp != sys.importers_.end())
-        return (*importp->second)(path, cx);
-    else {
+    if (importp != sys.importers_.end()) {
+        Value val = (*importp->second)(path, cx);
+        if (importp->second != curv_import)
+            record_import(sys, path);
+        return val;
+    } else {
         // If extension not recognized, it defaults to a Curv program.
         return curv_import(path, cx);
     }
@@ -43,20 +118,64 @@ Value curv_import(const Filesystem::path& path, const Context& cx)
 {
     System& sys{cx.system()};
     auto source = make<File_Source>(make_string(path.c_str()), cx);
-    Program prog{std::move(source), sys,
-        Program_Opts().file_frame(cx.frame())};
     auto filekey = Filesystem::canonical(path);
-    auto& active_files = sys.active_files_;
+    auto& istate = sys.import_state();
+    auto& active_files = istate.active_files_;
     if (active_files.find(filekey) != active_files.end())
         throw Exception{cx,
             stringify("illegal recursive reference to file ",path)};
+
+    // Look in the import cache. The first entry in 'files_' is the file
+    // itself, whose contents we have just read.
+    uint64_t hash = hash_bytes(source->begin(), source->size());
+    {
+        std::unique_lock<std::mutex> lock(sys.import_mutex_);
+        auto cached = sys.import_cache_.find(filekey);
+        if (cached != sys.import_cache_.end()) {
+            auto files = cached->second.files_;
+            Value val = cached->second.value_;
+            if (files[0].second == hash) {
+                // Hashing the imported files doesn't need the lock.
+                lock.unlock();
+                if (files_unchanged({files.begin()+1, files.end()})) {
+                    lock.lock();
+                    ++sys.import_hits_;
+                    lock.unlock();
+                    record_files(sys, files);
+                    return val;
+                }
+                lock.lock();
+            }
+            sys.import_cache_.erase(filekey);
+        }
+        ++sys.import_misses_;
+    }
+
+    Program prog{std::move(source), sys,
+        Program_Opts().file_frame(cx.frame())};
+    System::File_Hashes files{{filekey, hash}};
     Active_File af(active_files, filekey);
-    prog.compile();
-    return prog.eval();
+    istate.import_deps_.push_back(&files);
+    Value val;
+    try {
+        prog.compile();
+        val = prog.eval();
+    } catch (...) {
+        istate.import_deps_.pop_back();
+        throw;
+    }
+    istate.import_deps_.pop_back();
+    {
+        std::lock_guard<std::mutex> lock(sys.import_mutex_);
+        sys.import_cache_[filekey] = {files, val};
+    }
+    record_files(sys, files);
+    return val;
 }
 
 Value dir_import(const Filesystem::path& dir, const Context& cx)
 {
+    record_import(cx.system(), dir);
     return {make<Dir_Record>(dir, cx)};
 }
 
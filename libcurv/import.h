@@ -6,6 +6,7 @@
 #define LIBCURV_IMPORT_H
 
 #include <libcurv/filesystem.h>
+#include <libcurv/system.h>
 #include <libcurv/value.h>
 
 namespace curv {
@@ -25,5 +26,39 @@ Value curv_import(const Filesystem::path& path, const Context& cx);
 // Import a directory as a record value, using "directory syntax".
 Value dir_import(const Filesystem::path&, const Context&);
 
+// Record that a file or directory was imported, in the dependencies of each
+// file that is currently being imported (see System::Import_State). This is
+// done by curv_import and dir_import; other importers are covered by the
+// callers of System::importers_.
+void record_import(System&, const Filesystem::path&);
+
+// Hash of the contents of a file, or 0 if it can't be read.
+// The contents of a directory is its list of filenames.
+uint64_t hash_file(const Filesystem::path&);
+
+// True if each file still has the content hash that was recorded for it.
+bool files_unchanged(const System::File_Hashes&);
+
+// While this object exists, the files imported by the current thread are
+// recorded in 'deps', with the hashes of their contents at the time they
+// were read. Used by live mode, which compares these hashes with the files
+// after evaluation, to catch edits made while the program was evaluated.
+struct Record_Imports
+{
+    System& system_;
+    Record_Imports(System& sys, System::File_Hashes& deps)
+    :
+        system_(sys)
+    {
+        sys.import_state().import_deps_.push_back(&deps);
+    }
+    ~Record_Imports()
+    {
+        system_.import_state().import_deps_.pop_back();
+    }
+    Record_Imports(const Record_Imports&) = delete;
+    Record_Imports& operator=(const Record_Imports&) = delete;
+};
+
 }
 #endif
@@ -5,10 +5,13 @@
 #include <libcurv/json.h>
 
 #include <libcurv/dtostr.h>
+#include <libcurv/exception.h>
 #include <libcurv/list.h>
 #include <libcurv/record.h>
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 namespace curv {
 
@@ -108,4 +111,180 @@ void write_json_value(Value val, std::ostream& out)
     }
 }
 
+namespace {
+
+// A recursive descent JSON parser.
+struct JSON_Reader
+{
+    const char* p_;
+    const Context& cx_;
+
+    [[noreturn]] void error(const char* msg)
+    {
+        throw Exception(cx_, stringify("JSON: ", msg));
+    }
+    void skip_space()
+    {
+        while (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')
+            ++p_;
+    }
+    bool match(const char* word)
+    {
+        size_t n = strlen(word);
+        if (strncmp(p_, word, n) != 0)
+            return false;
+        p_ += n;
+        return true;
+    }
+    void expect(char c)
+    {
+        skip_space();
+        if (*p_ != c)
+            error(stringify("expected '",c,"'")->c_str());
+        ++p_;
+    }
+    unsigned hex4()
+    {
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *p_++;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code += c - '0';
+            else if (c >= 'a' && c <= 'f') code += c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code += c - 'A' + 10;
+            else error("bad \\u escape");
+        }
+        return code;
+    }
+    static void put_utf8(unsigned code, std::string& out)
+    {
+        if (code < 0x80)
+            out += char(code);
+        else if (code < 0x800) {
+            out += char(0xC0 | (code >> 6));
+            out += char(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += char(0xE0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        } else {
+            out += char(0xF0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3F));
+            out += char(0x80 | ((code >> 6) & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+    }
+    std::string string()
+    {
+        expect('"');
+        std::string out;
+        for (;;) {
+            char c = *p_++;
+            if (c == '"')
+                return out;
+            if (c == '\0')
+                error("unterminated string");
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            switch (c = *p_++) {
+            case '"': case '\\': case '/': out += c; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+              {
+                unsigned code = hex4();
+                if (code >= 0xD800 && code < 0xDC00 && match("\\u")) {
+                    unsigned lo = hex4();
+                    code = 0x10000 + ((code - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                put_utf8(code, out);
+                break;
+              }
+            default:
+                error("bad escape sequence in string");
+            }
+        }
+    }
+    Value value()
+    {
+        skip_space();
+        switch (*p_) {
+        case '"':
+          {
+            auto str = string();
+            return {make_string(str)};
+          }
+        case '[':
+          {
+            ++p_;
+            List_Builder lb;
+            skip_space();
+            if (*p_ == ']') {
+                ++p_;
+                return {lb.get_list()};
+            }
+            for (;;) {
+                lb.push_back(value());
+                skip_space();
+                if (*p_ == ']') {
+                    ++p_;
+                    return {lb.get_list()};
+                }
+                expect(',');
+            }
+          }
+        case '{':
+          {
+            ++p_;
+            auto rec = make<DRecord>();
+            skip_space();
+            if (*p_ == '}') {
+                ++p_;
+                return {rec};
+            }
+            for (;;) {
+                skip_space();
+                auto name = string();
+                expect(':');
+                rec->fields_[make_symbol(name)] = value();
+                skip_space();
+                if (*p_ == '}') {
+                    ++p_;
+                    return {rec};
+                }
+                expect(',');
+            }
+          }
+        default:
+            if (match("true")) return {true};
+            if (match("false")) return {false};
+            if (match("null")) return make_symbol("null").to_value();
+            if (*p_ == '-' || (*p_ >= '0' && *p_ <= '9')) {
+                char* end;
+                double n = strtod(p_, &end);
+                p_ = end;
+                return {n};
+            }
+            error("syntax error");
+        }
+    }
+};
+
+} // namespace
+
+Value read_json_value(const char* str, const Context& cx)
+{
+    JSON_Reader r{str, cx};
+    Value val = r.value();
+    r.skip_space();
+    if (*r.p_ != '\0')
+        r.error("unexpected characters after value");
+    return val;
+}
+
 } // namespace curv
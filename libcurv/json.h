@@ -10,8 +10,14 @@
 
 namespace curv {
 
+struct Context;
+
 void write_json_string(const char*, std::ostream&);
 void write_json_value(Value, std::ostream&);
 
+// Parse a JSON text, and convert it to a Curv value. JSON null is #null,
+// objects are records. Syntax errors are reported using the Context.
+Value read_json_value(const char* str, const Context&);
+
 } // namespace curv
 #endif // header guard
@@ -41,10 +41,23 @@ auto List_Base::equal(const List_Base& list, const Context& cx) const
     return true;
 }
 
+void List_Builder::grow()
+{
+    if (list_ == nullptr)
+        list_ = List::make(4);
+    else
+        List::resize(list_, 2 * list_->size());
+}
+
 auto List_Builder::get_list()
 -> Shared<List>
 {
-    return List::make_elements(*this);
+    if (list_ == nullptr)
+        return List::make(0);
+    if (size_ < list_->size())
+        List::resize(list_, size_);
+    size_ = 0;
+    return {std::move(list_)};
 }
 
 Shared<List> List_Base::clone() const
@@ -8,6 +8,7 @@
 #include <libcurv/value.h>
 #include <libcurv/tail_array.h>
 #include <libcurv/array_mixin.h>
+#include <memory>
 #include <vector>
 
 namespace curv {
@@ -50,12 +51,29 @@ inline Shared<List> make_list(size_t size)
 }
 
 /// Factory class for building a curv::List.
-struct List_Builder : public std::vector<Value>
+///
+/// The elements are stored in a List, which grows geometrically, and which
+/// becomes the result of get_list() (after trimming any unused capacity),
+/// so the elements aren't copied into a new List at the end.
+struct List_Builder
 {
-    // An optimized version of this class would use a curv::List
-    // as the internal buffer.
+    void push_back(Value val)
+    {
+        if (list_ == nullptr || size_ == list_->size())
+            grow();
+        (*list_)[size_++] = std::move(val);
+    }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
 
+    // Return the list, and leave the builder empty.
     Shared<List> get_list();
+
+private:
+    std::unique_ptr<List> list_;
+    size_t size_ = 0;
+
+    void grow();
 };
 
 } // namespace curv
@@ -6,6 +6,7 @@
 #include <libcurv/context.h>
 #include <libcurv/array_op.h>
 #include <libcurv/reactive.h>
+#include <cmath>
 
 namespace curv {
 
@@ -82,6 +83,108 @@ Value multiply(Value a, Value b, const At_Syntax& cx)
     return array_op.op(Scalar_Op(cx), a, b);
 }
 
+Value subtract(Value a, Value b, const At_Syntax& cx)
+{
+    struct Scalar_Op {
+        static double call(double x, double y) { return x - y; }
+        Shared<Operation> make_expr(
+            Shared<Operation> x, Shared<Operation> y) const
+        {
+            return make<Subtract_Expr>(share(cx.syntax()),
+                std::move(x), std::move(y));
+        }
+        static const char* name() { return "-"; }
+        static Shared<const String> callstr(Value x, Value y) {
+            return stringify(x," - ",y);
+        }
+        const At_Syntax& cx;
+        Scalar_Op(const At_Syntax& as) : cx(as) {}
+    };
+    static Binary_Numeric_Array_Op<Scalar_Op> array_op;
+    return array_op.op(Scalar_Op(cx), a, b);
+}
+
+Value divide(Value a, Value b, const At_Syntax& cx)
+{
+    struct Scalar_Op {
+        static double call(double x, double y) { return x / y; }
+        Shared<Operation> make_expr(
+            Shared<Operation> x, Shared<Operation> y) const
+        {
+            return make<Divide_Expr>(share(cx.syntax()),
+                std::move(x), std::move(y));
+        }
+        static const char* name() { return "/"; }
+        static Shared<const String> callstr(Value x, Value y) {
+            return stringify(x," / ",y);
+        }
+        const At_Syntax& cx;
+        Scalar_Op(const At_Syntax& as) : cx(as) {}
+    };
+    static Binary_Numeric_Array_Op<Scalar_Op> array_op;
+    return array_op.op(Scalar_Op(cx), a, b);
+}
+
+Value power(Value a, Value b, const At_Syntax& cx)
+{
+    struct Scalar_Op {
+        static double call(double x, double y) { return pow(x,y); }
+        Shared<Operation> make_expr(
+            Shared<Operation> x, Shared<Operation> y) const
+        {
+            return make<Power_Expr>(share(cx.syntax()),
+                std::move(x), std::move(y));
+        }
+        static const char* name() { return "^"; }
+        static Shared<const String> callstr(Value x, Value y) {
+            return stringify(x," ^ ",y);
+        }
+        const At_Syntax& cx;
+        Scalar_Op(const At_Syntax& as) : cx(as) {}
+    };
+    static Binary_Numeric_Array_Op<Scalar_Op> array_op;
+    return array_op.op(Scalar_Op(cx), a, b);
+}
+
+Value negate(Value a, const At_Syntax& cx)
+{
+    struct Scalar_Op {
+        static double call(double x) { return -x; }
+        Shared<Operation> make_expr(Shared<Operation> x) const
+        {
+            return make<Negative_Expr>(share(cx.syntax()), std::move(x));
+        }
+        static auto callstr(Value x) { return stringify("-",x); }
+        const At_Syntax& cx;
+        Scalar_Op(const At_Syntax& as) : cx(as) {}
+    };
+    static Unary_Numeric_Array_Op<Scalar_Op> array_op;
+    return array_op.op(Scalar_Op(cx), a);
+}
+
+Value eval_not(Value x, const At_Syntax& cx)
+{
+    if (x.is_bool())
+        return {!x.to_bool_unsafe()};
+    if (auto xlist = x.dycast<List>()) {
+        Shared<List> result = List::make(xlist->size());
+        for (unsigned i = 0; i < xlist->size(); ++i)
+            (*result)[i] = eval_not((*xlist)[i], cx);
+        return {result};
+    }
+    auto re = x.dycast<Reactive_Value>();
+    if (re && re->sctype_ == SC_Type::Bool()) {
+        return {make<Reactive_Expression>(
+            SC_Type::Bool(),
+            make<Not_Expr>(
+                share(cx.syntax()),
+                make<Constant>(share(cx.syntax()), x)
+            ),
+            cx)};
+    }
+    throw Exception(cx, stringify("!",x,": domain error"));
+}
+
 // Generalized dot product that includes vector dot product and matrix product.
 // Same as Mathematica Dot[A,B]. Like APL A+.×B, Python numpy.dot(A,B)
 //  dot(a,b) =
@@ -103,6 +206,19 @@ Value dot(Value a, Value b, const At_Syntax& cx)
         if (av->size() != bv->size())
             throw Exception(cx, stringify("list of size ",av->size(),
                 " can't be multiplied by list of size ",bv->size()));
+        // fast path: a vector of numbers. If an element isn't a number,
+        // or the result is NaN, use the general case to report the error.
+        double sum = 0.0;
+        bool ok = true;
+        for (size_t i = 0; i < av->size(); ++i) {
+            double x = av->at(i).to_num_or_nan();
+            double y = bv->at(i).to_num_or_nan();
+            ok &= (x == x) & (y == y);
+            sum += x * y;
+        }
+        if (ok && sum == sum)
+            return {sum};
+
         Value result = {0.0};
         for (size_t i = 0; i < av->size(); ++i)
             result = add(result, multiply(av->at(i), bv->at(i), cx), cx);
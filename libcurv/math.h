@@ -22,6 +22,13 @@ Value dot(Value a, Value b, const At_Syntax& cx);
 
 Value add(Value a, Value b, const At_Syntax& cx);
 Value multiply(Value a, Value b, const At_Syntax& cx);
+Value subtract(Value a, Value b, const At_Syntax& cx);
+Value divide(Value a, Value b, const At_Syntax& cx);
+Value power(Value a, Value b, const At_Syntax& cx);
+Value negate(Value a, const At_Syntax& cx);
+
+// Boolean negation, applied element-wise to a list.
+Value eval_not(Value a, const At_Syntax& cx);
 
 } // namespace curv
 #endif // header guard
@@ -489,6 +489,10 @@ struct Range_Expr : public Just_Expression
         half_open_(half_open)
     {}
     virtual Value eval(Frame&) const override;
+
+    // Evaluate the arguments and return the number of elements in the range,
+    // without constructing it. Element i is `first + step*i`.
+    unsigned eval_count(Frame&, double& first, double& step) const;
 };
 
 struct List_Expr_Base : public Just_Expression
@@ -499,6 +503,11 @@ struct List_Expr_Base : public Just_Expression
     void init(); // call after construction & initialization of array elements
     virtual Value eval(Frame&) const override;
     Shared<List> eval_list(Frame&) const;
+
+    // True if each element is an expression, which generates exactly one
+    // value, so that the list size is known at compile time. Set by init().
+    bool fixed_size_ = false;
+
     virtual SC_Value sc_eval(SC_Frame&) const override;
     virtual size_t hash() const noexcept override;
     virtual bool hash_eq(const Operation&) const noexcept override;
@@ -530,12 +539,26 @@ struct Scope_Executable
     // actions to execute at runtime: action statements and slot initialization
     std::vector<Shared<const Operation>> actions_ = {};
 
+    // The dependency graph of the actions: action_deps_[i] lists the
+    // earlier actions that must be executed before action i. Independent
+    // actions may be executed in parallel (see exec_parallel). Empty if the
+    // actions must be executed serially.
+    std::vector<std::vector<unsigned>> action_deps_ = {};
+
+    // For a block, action_slots_[i] lists the frame slots initialized by
+    // action i. Empty for a module, whose slots are in the module object.
+    std::vector<std::vector<slot_t>> action_slots_ = {};
+
     Scope_Executable() {}
 
     /// Initialize the module slot, execute the definitions and action list.
     /// Return the module.
     Shared<Module> eval_module(Frame&) const;
     void exec(Frame&) const;
+    /// Execute the action list using multiple threads, respecting
+    /// action_deps_. Return false, having done nothing, if the actions
+    /// should be executed serially instead.
+    bool exec_parallel(Frame&) const;
     void sc_exec(SC_Frame&) const;
 };
 
@@ -734,6 +757,9 @@ struct For_Op : public Operation
     Shared<const Operation> list_;
     Shared<const Operation> cond_;
     Shared<const Operation> body_;
+    // If list_ is a range expression, like `for (i in 0..<n)`, then the
+    // elements are generated one at a time, without constructing a List.
+    Shared<const Range_Expr> range_;
 
     For_Op(
         Shared<const Phrase> syntax,
@@ -746,7 +772,8 @@ struct For_Op : public Operation
         pattern_(std::move(pattern)),
         list_(std::move(list)),
         cond_(std::move(cond)),
-        body_(std::move(body))
+        body_(std::move(body)),
+        range_(cast<const Range_Expr>(list_))
     {}
 
     virtual void exec(Frame&, Executor&) const override;
@@ -819,6 +846,10 @@ struct If_Else_Op : public Operation
     virtual void sc_exec(SC_Frame&) const override;
     virtual size_t hash() const noexcept override;
     virtual bool hash_eq(const Operation&) const noexcept override;
+
+    // Evaluate the if-else when the condition is not a boolean value:
+    // a reactive boolean yields a reactive result, otherwise it's an error.
+    Value reactive_eval(Value cond, Frame&) const;
 };
 
 struct Lambda_Expr : public Just_Expression
@@ -829,6 +860,7 @@ struct Lambda_Expr : public Just_Expression
     slot_t nslots_;
     Symbol_Ref name_{}; // may be set by Function_Definition::analyse
     int argpos_ = 0; // may be set by Function_Definition::analyse
+    mutable Shared<Operation> code_ = nullptr; // bytecode, see use_bytecode()
 
     Lambda_Expr(
         Shared<const Phrase> syntax,
@@ -24,9 +24,8 @@ struct Module_Base : public Record
     /// It has a reference count so that the same dictionary
     /// can be shared between multiple modules.
     ///
-    /// TODO: This might be more efficient as a sorted array of field names.
-    /// The index of the field name would be interpreted as the slot index.
-    /// (Reimplementing `Symbol_Map` using hash trees is another proposal.)
+    /// TODO: The slot index could be the index of the field name in the
+    /// (sorted, flat) Symbol_Map, which would eliminate the slot_t values.
     struct Dictionary : public Shared_Base, public Symbol_Map<slot_t>
     {
         Dictionary() : Shared_Base(), Symbol_Map<slot_t>() {}
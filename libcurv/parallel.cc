@@ -0,0 +1,174 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/meaning.h>
+
+#include <libcurv/frame.h>
+#include <libcurv/system.h>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace curv {
+
+namespace {
+
+// True while the current thread is executing actions in parallel.
+// Scopes that are evaluated by these actions are executed serially.
+thread_local bool in_exec_parallel = false;
+
+// Executes the actions of a Scope_Executable using a pool of threads.
+//
+// An action becomes ready once the actions it depends on are complete.
+// Each thread evaluates actions in a private copy of the frame, since
+// actions use the frame slots above the scope's bindings as temporaries.
+// For a block, the slots initialized by an action are copied from the
+// private frame to the shared frame when the action completes, and into
+// a private frame before the actions that depend on it are executed.
+//
+// Errors are reported deterministically. If an action fails, then actions
+// with a higher index aren't started, and actions with a lower index run
+// to completion. The error reported is the one from the failed action with
+// the lowest index, which is the error that serial execution reports.
+struct Scheduler
+{
+    const Scope_Executable& exec_;
+    Frame& frame_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // ready actions, lowest index first
+    std::priority_queue<unsigned, std::vector<unsigned>,
+        std::greater<unsigned>> ready_;
+    // number of incomplete dependencies of each action
+    std::vector<unsigned> ndeps_;
+    // the actions that depend on each action
+    std::vector<std::vector<unsigned>> users_;
+    unsigned nrunning_ = 0;
+    unsigned failed_; // index of the first failed action, or #actions
+    std::exception_ptr error_;
+
+    Scheduler(const Scope_Executable& exec, Frame& frame)
+    :
+        exec_(exec),
+        frame_(frame),
+        ndeps_(exec.actions_.size()),
+        users_(exec.actions_.size()),
+        failed_(exec.actions_.size())
+    {
+        for (unsigned i = 0; i < exec.actions_.size(); ++i) {
+            ndeps_[i] = exec.action_deps_[i].size();
+            for (unsigned d : exec.action_deps_[i])
+                users_[d].push_back(i);
+            if (ndeps_[i] == 0)
+                ready_.push(i);
+        }
+    }
+
+    // Execute actions in the private frame `pf` until none are left.
+    void work(Frame& pf)
+    {
+        Operation::Action_Executor aex;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            while (ready_.empty() && nrunning_ > 0)
+                cond_.wait(lock);
+            if (ready_.empty())
+                break;
+            unsigned i = ready_.top();
+            ready_.pop();
+            if (i > failed_)
+                continue;
+            ++nrunning_;
+            if (!exec_.action_slots_.empty()) {
+                for (unsigned d : exec_.action_deps_[i]) {
+                    for (slot_t s : exec_.action_slots_[d])
+                        pf[s] = frame_[s];
+                }
+            }
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                exec_.actions_[i]->exec(pf, aex);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+            --nrunning_;
+            if (error) {
+                if (i < failed_) {
+                    failed_ = i;
+                    error_ = error;
+                }
+            } else {
+                if (!exec_.action_slots_.empty()) {
+                    for (slot_t s : exec_.action_slots_[i])
+                        frame_[s] = pf[s];
+                }
+                for (unsigned u : users_[i]) {
+                    if (--ndeps_[u] == 0)
+                        ready_.push(u);
+                }
+            }
+            cond_.notify_all();
+        }
+    }
+};
+
+} // namespace
+
+bool
+Scope_Executable::exec_parallel(Frame& f) const
+{
+    if (action_deps_.empty() || f.system_.eval_threads_ <= 1
+        || in_exec_parallel)
+    {
+        return false;
+    }
+    unsigned nthreads = f.system_.eval_threads_;
+    if (nthreads > actions_.size())
+        nthreads = actions_.size();
+
+    Thread_Shared_Scope shared;
+    Scheduler sched(*this, f);
+
+    // Each thread has a private copy of the frame, and of the import state.
+    std::vector<std::unique_ptr<Frame>> frames;
+    for (unsigned i = 0; i < nthreads; ++i) {
+        auto pf = Frame::make(f.size_, f.system_, f.parent_frame_,
+            f.call_phrase_, f.nonlocals_);
+        pf->func_ = f.func_;
+        for (slot_t s = 0; s < f.size_; ++s)
+            (*pf)[s] = f[s];
+        frames.push_back(std::move(pf));
+    }
+    std::vector<System::Import_State> import_states(
+        nthreads - 1, f.system_.import_state());
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < nthreads; ++i) {
+        workers.emplace_back([&,i]() -> void {
+            Use_Import_State uis(f.system_, import_states[i-1]);
+            in_exec_parallel = true;
+            sched.work(*frames[i]);
+        });
+    }
+    in_exec_parallel = true;
+    sched.work(*frames[0]);
+    in_exec_parallel = false;
+    for (auto& w : workers)
+        w.join();
+    frames.clear();
+
+    if (sched.error_)
+        std::rethrow_exception(sched.error_);
+    return true;
+}
+
+} // namespace curv
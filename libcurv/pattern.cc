@@ -156,7 +156,8 @@ struct Predicate_Pattern : public Pattern
               {
                 Function* fun = (Function*)&funp;
                 std::unique_ptr<Frame> f2 {
-                    Frame::make(fun->nslots_, f.system_, &f, call_phrase(), nullptr)
+                    make_call_frame(
+                        fun->nslots_, f.system_, &f, call_phrase(), nullptr)
                 };
                 auto result = fun->call(arg, *f2);
                 return result.to_bool(At_Phrase(*call_phrase(), f));
@@ -47,49 +47,52 @@ SC_Compiler::define_function(
         cx);
 }
 
-void
-SC_Compiler::define_function(
+// Define a function that calls each of `funcs` with the same arguments.
+// If there is more than one, the results are concatenated into a vector.
+static void
+define_function_body(
+    SC_Compiler& sc,
     const char* name,
-    std::vector<SC_Type> param_types,
+    const std::vector<SC_Type>& param_types,
     SC_Type result_type,
-    Shared<const Function> func,
+    const std::vector<Shared<const Function>>& funcs,
     const Context& cx)
 {
-    begin_function();
+    sc.begin_function();
 
     // function prologue
-    if (target_ == SC_Target::cpp)
-        out_ << "extern \"C\" void " << name << "(";
+    if (sc.target_ == SC_Target::cpp)
+        sc.out_ << "extern \"C\" void " << name << "(";
     else
-        out_ << result_type << " " << name << "(";
+        sc.out_ << result_type << " " << name << "(";
     bool first = true;
     std::vector<SC_Value> params;
     int n = 0;
     for (auto& ty : param_types) {
-        params.push_back(newvalue(ty));
-        if (!first) out_ << ", ";
+        params.push_back(sc.newvalue(ty));
+        if (!first) sc.out_ << ", ";
         first = false;
-        if (target_ == SC_Target::cpp)
-            out_ << "const " << ty << "* param" << n++;
+        if (sc.target_ == SC_Target::cpp)
+            sc.out_ << "const " << ty << "* param" << n++;
         else
-            out_ << ty << " " << params.back();
+            sc.out_ << ty << " " << params.back();
     }
-    if (target_ == SC_Target::cpp) {
-        if (!first) out_ << ", ";
-        out_ << result_type << "* result)\n";
+    if (sc.target_ == SC_Target::cpp) {
+        if (!first) sc.out_ << ", ";
+        sc.out_ << result_type << "* result)\n";
     } else
-        out_ << ")\n";
-    out_ << "{\n";
-    if (target_ == SC_Target::cpp) {
+        sc.out_ << ")\n";
+    sc.out_ << "{\n";
+    if (sc.target_ == SC_Target::cpp) {
         n = 0;
         for (unsigned i = 0; i < params.size(); ++i) {
-            out_ << "  " << param_types[i] << " " << params[i]
-                 << " = *param" << n++ << ";\n";
+            sc.out_ << "  " << param_types[i] << " " << params[i]
+                    << " = *param" << n++ << ";\n";
         }
     }
 
     // function body
-    auto f = SC_Frame::make(0, *this, &cx, nullptr, nullptr);
+    auto f = SC_Frame::make(0, sc, &cx, nullptr, nullptr);
     Shared<Operation> arg_expr;
     if (params.size() == 1)
         arg_expr = make<SC_Data_Ref>(nullptr, params[0]);
@@ -100,18 +103,127 @@ SC_Compiler::define_function(
         }
         arg_expr = std::move(param_list);
     }
-    auto result = func->sc_call_expr(*arg_expr, nullptr, *f);
+    SC_Value result;
+    if (funcs.size() == 1)
+        result = funcs[0]->sc_call_expr(*arg_expr, nullptr, *f);
+    else {
+        std::vector<SC_Value> parts;
+        unsigned count = 0;
+        for (auto& func : funcs) {
+            auto part = func->sc_call_expr(*arg_expr, nullptr, *f);
+            if (part.type.rank_ > 0 || !part.type.is_numeric()) {
+                throw Exception(cx, stringify(name,": component function ",
+                    parts.size()+1," returns ",part.type));
+            }
+            count += part.type.count();
+            parts.push_back(part);
+        }
+        if (count != result_type.count()) {
+            throw Exception(cx, stringify(name,": component functions return ",
+                count," numbers, expected ",result_type));
+        }
+        result = sc.newvalue(result_type);
+        sc.out() << "  " << result_type << " " << result << " = "
+                 << result_type << "(";
+        first = true;
+        for (auto part : parts) {
+            if (!first) sc.out() << ",";
+            first = false;
+            sc.out() << part;
+        }
+        sc.out() << ");\n";
+    }
     if (result.type != result_type) {
         throw Exception(cx, stringify(name," function returns ",result.type));
     }
-    end_function();
+    sc.end_function();
 
     // function epilogue
-    if (target_ == SC_Target::cpp) {
-        out_ << "  *result = " << result << ";\n";
+    if (sc.target_ == SC_Target::cpp) {
+        sc.out_ << "  *result = " << result << ";\n";
     } else {
-        out_ << "  return " << result << ";\n";
+        sc.out_ << "  return " << result << ";\n";
     }
+    sc.out_ << "}\n";
+}
+
+void
+SC_Compiler::define_function(
+    const char* name,
+    std::vector<SC_Type> param_types,
+    SC_Type result_type,
+    Shared<const Function> func,
+    const Context& cx)
+{
+    define_function_body(*this, name, param_types, result_type,
+        {func}, cx);
+}
+
+void
+SC_Compiler::define_fused_function(
+    const char* name, SC_Type param_type, SC_Type result_type,
+    std::vector<Shared<const Function>> funcs, const Context& cx)
+{
+    assert(result_type.rank_ == 0 && result_type.is_numeric());
+    define_function_body(*this, name, std::vector<SC_Type>{param_type},
+        result_type, funcs, cx);
+}
+
+void
+SC_Compiler::define_batch_function(
+    const char* name, SC_Type param_type, SC_Type result_type,
+    Shared<const Function> func, const Context& cx)
+{
+    assert(target_ == SC_Target::cpp);
+    assert(param_type.rank_ == 0 && param_type.is_numeric());
+    assert(result_type.rank_ == 0 && result_type.is_numeric());
+    unsigned nparams = param_type.count();
+    unsigned nresults = result_type.count();
+
+    begin_function();
+
+    // function prologue
+    out_ << "extern \"C\" void " << name << "(unsigned n";
+    for (unsigned i = 0; i < nparams; ++i)
+        out_ << ", const float* in" << i;
+    for (unsigned i = 0; i < nresults; ++i)
+        out_ << ", float* out" << i;
+    out_ << ")\n";
+    out_ << "{\n";
+
+    // function body
+    auto param = newvalue(param_type);
+    auto f = SC_Frame::make(0, *this, &cx, nullptr, nullptr);
+    auto arg_expr = make<SC_Data_Ref>(nullptr, param);
+    auto result = func->sc_call_expr(*arg_expr, nullptr, *f);
+    if (result.type != result_type) {
+        throw Exception(cx, stringify(name," function returns ",result.type));
+    }
+    out_ << "  /* constants */\n";
+    out_ << constants_.str();
+    out_ << "  for (unsigned i = 0; i < n; ++i) {\n";
+    out_ << "  " << param_type << " " << param << " = ";
+    if (nparams == 1)
+        out_ << "in0[i];\n";
+    else {
+        out_ << param_type << "(";
+        for (unsigned i = 0; i < nparams; ++i) {
+            if (i > 0) out_ << ",";
+            out_ << "in" << i << "[i]";
+        }
+        out_ << ");\n";
+    }
+    out_ << "  /* body */\n";
+    out_ << body_.str();
+
+    // function epilogue
+    if (nresults == 1)
+        out_ << "  out0[i] = " << result << ";\n";
+    else {
+        for (unsigned i = 0; i < nresults; ++i)
+            out_ << "  out" << i << "[i] = " << result << "[" << i << "];\n";
+    }
+    out_ << "  }\n";
     out_ << "}\n";
 }
 
@@ -122,6 +234,8 @@ SC_Compiler::begin_function()
     valcache_.clear();
     opcaches_.clear();
     opcaches_.emplace_back(Op_Cache{});
+    callcaches_.clear();
+    callcaches_.emplace_back(Call_Cache{});
     constants_.str("");
     body_.str("");
 }
@@ -135,6 +249,32 @@ SC_Compiler::end_function()
     out_ << body_.str();
 }
 
+bool
+SC_Compiler::find_call(const Call_Key& key, SC_Value& result) const
+{
+    for (auto& cache : callcaches_) {
+        auto cached = cache.find(key);
+        if (cached != cache.end()) {
+            result = cached->second.result_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+SC_Compiler::add_call(const Call_Key& key, Value func, SC_Value result)
+{
+    callcaches_.back()[key] = Call_Cache_Entry{func, result};
+}
+
+void
+SC_Compiler::clear_calls()
+{
+    for (auto& cache : callcaches_)
+        cache.clear();
+}
+
 SC_Value sc_call_unary_numeric(SC_Frame& f, const char* name)
 {
     auto arg = f[0];
@@ -552,6 +692,7 @@ Assignment_Action::sc_exec(SC_Frame& f) const
     f.sc_.out() << "  ";
     locative_->sc_print(f);
     f.sc_.out() << "="<<val<<";\n";
+    f.sc_.clear_calls();
 }
 void
 Data_Setter::sc_exec(SC_Frame& f) const
@@ -740,6 +881,19 @@ SC_Value Local_Data_Ref::sc_eval(SC_Frame& f) const
     return f[slot_];
 }
 
+bool sc_eval_var(SC_Frame& f, const Operation& op, SC_Value& val)
+{
+    if (auto ref = dynamic_cast<const Local_Data_Ref*>(&op)) {
+        val = f[ref->slot_];
+        return true;
+    }
+    if (auto ref = dynamic_cast<const SC_Data_Ref*>(&op)) {
+        val = ref->val_;
+        return true;
+    }
+    return false;
+}
+
 SC_Value Nonlocal_Data_Ref::sc_eval(SC_Frame& f) const
 {
     return sc_eval_const(f, f.nonlocals_->at(slot_), *syntax_);
@@ -801,64 +955,122 @@ SC_Value Not_Expr::sc_eval(SC_Frame& f) const
         << arg << ";\n";
     return result;
 }
+// Compile an operation that is conditionally evaluated, capturing the code
+// in a string, so that it can be placed inside an if statement. Uniform
+// subexpressions are still hoisted into the constants section, and only
+// those are entered in the value and operation caches. Calls are cached in
+// a new scope, which is discarded afterwards. So SSA values defined inside
+// the branch can't be referenced outside of it. In a uniform context, both
+// arms are evaluated eagerly into the constants section.
+static SC_Value
+sc_eval_branch(SC_Frame& f, const Operation& op, std::string& code)
+{
+    if (f.sc_.in_constants_)
+        return sc_eval_op(f, op);
+    std::stringstream saved;
+    saved.swap(f.sc_.body_);
+    f.sc_.callcaches_.emplace_back(Call_Cache{});
+    SC_Value val;
+    try {
+        val = sc_eval_op(f, op);
+    } catch (...) {
+        f.sc_.callcaches_.pop_back();
+        saved.swap(f.sc_.body_);
+        throw;
+    }
+    f.sc_.callcaches_.pop_back();
+    code = f.sc_.body_.str();
+    saved.swap(f.sc_.body_);
+    return val;
+}
 SC_Value Or_Expr::sc_eval(SC_Frame& f) const
 {
-    // TODO: change Or to use lazy evaluation.
     auto arg1 = sc_eval_expr(f, *arg1_, SC_Type::Bool());
-    auto arg2 = sc_eval_expr(f, *arg2_, SC_Type::Bool());
+    std::string code2;
+    auto arg2 = sc_eval_branch(f, *arg2_, code2);
+    if (arg2.type != SC_Type::Bool()) {
+        throw Exception(At_SC_Phrase(arg2_->syntax_, f), stringify(
+            "wrong argument type: expected Bool, got ",arg2.type));
+    }
     SC_Value result = f.sc_.newvalue(SC_Type::Bool());
-    f.sc_.out() <<"  bool "<<result<<" =("<<arg1<<" || "<<arg2<<");\n";
+    f.sc_.out() <<"  bool "<<result<<" = "<<arg1<<";\n"
+                <<"  if (!"<<result<<") {\n"
+                << code2
+                <<"  "<<result<<" = "<<arg2<<";\n"
+                <<"  }\n";
     return result;
 }
 SC_Value And_Expr::sc_eval(SC_Frame& f) const
 {
-    // TODO: change And to use lazy evaluation.
     auto arg1 = sc_eval_expr(f, *arg1_, SC_Type::Bool());
-    auto arg2 = sc_eval_expr(f, *arg2_, SC_Type::Bool());
+    std::string code2;
+    auto arg2 = sc_eval_branch(f, *arg2_, code2);
+    if (arg2.type != SC_Type::Bool()) {
+        throw Exception(At_SC_Phrase(arg2_->syntax_, f), stringify(
+            "wrong argument type: expected Bool, got ",arg2.type));
+    }
     SC_Value result = f.sc_.newvalue(SC_Type::Bool());
-    f.sc_.out() <<"  bool "<<result<<" =("<<arg1<<" && "<<arg2<<");\n";
+    f.sc_.out() <<"  bool "<<result<<" = "<<arg1<<";\n"
+                <<"  if ("<<result<<") {\n"
+                << code2
+                <<"  "<<result<<" = "<<arg2<<";\n"
+                <<"  }\n";
     return result;
 }
 SC_Value If_Else_Op::sc_eval(SC_Frame& f) const
 {
-    // TODO: change If to use lazy evaluation.
     auto arg1 = sc_eval_expr(f, *arg1_, SC_Type::Bool());
-    auto arg2 = sc_eval_op(f, *arg2_);
-    auto arg3 = sc_eval_op(f, *arg3_);
+    std::string code2, code3;
+    auto arg2 = sc_eval_branch(f, *arg2_, code2);
+    auto arg3 = sc_eval_branch(f, *arg3_, code3);
     if (arg2.type != arg3.type) {
         throw Exception(At_SC_Phrase(syntax_, f), stringify(
             "if: type mismatch in 'then' and 'else' arms (",
             arg2.type, ",", arg3.type, ")"));
     }
     SC_Value result = f.sc_.newvalue(arg2.type);
-    f.sc_.out() <<"  "<<arg2.type<<" "<<result
-             <<" =("<<arg1<<" ? "<<arg2<<" : "<<arg3<<");\n";
+    f.sc_.out() <<"  "<<arg2.type<<" "<<result<<";\n"
+                <<"  if ("<<arg1<<") {\n"
+                << code2
+                <<"  "<<result<<" = "<<arg2<<";\n"
+                <<"  } else {\n"
+                << code3
+                <<"  "<<result<<" = "<<arg3<<";\n"
+                <<"  }\n";
     return result;
 }
 void If_Else_Op::sc_exec(SC_Frame& f) const
 {
     auto arg1 = sc_eval_expr(f, *arg1_, SC_Type::Bool());
     f.sc_.out() << "  if ("<<arg1<<") {\n";
+    f.sc_.callcaches_.emplace_back(Call_Cache{});
     arg2_->sc_exec(f);
+    f.sc_.callcaches_.back().clear();
     f.sc_.out() << "  } else {\n";
     arg3_->sc_exec(f);
+    f.sc_.callcaches_.pop_back();
     f.sc_.out() << "  }\n";
 }
 void If_Op::sc_exec(SC_Frame& f) const
 {
     auto arg1 = sc_eval_expr(f, *arg1_, SC_Type::Bool());
     f.sc_.out() << "  if ("<<arg1<<") {\n";
+    f.sc_.callcaches_.emplace_back(Call_Cache{});
     arg2_->sc_exec(f);
+    f.sc_.callcaches_.pop_back();
     f.sc_.out() << "  }\n";
 }
 void While_Op::sc_exec(SC_Frame& f) const
 {
     f.sc_.opcaches_.emplace_back(Op_Cache{});
+    f.sc_.clear_calls();
+    f.sc_.callcaches_.emplace_back(Call_Cache{});
     f.sc_.out() << "  while (true) {\n";
     auto cond = sc_eval_expr(f, *cond_, SC_Type::Bool());
     f.sc_.out() << "  if (!"<<cond<<") break;\n";
     body_->sc_exec(f);
     f.sc_.out() << "  }\n";
+    f.sc_.callcaches_.pop_back();
     f.sc_.opcaches_.pop_back();
 }
 void For_Op::sc_exec(SC_Frame& f) const
@@ -888,6 +1100,8 @@ void For_Op::sc_exec(SC_Frame& f) const
   #endif
     auto i = f.sc_.newvalue(SC_Type::Num());
     f.sc_.opcaches_.emplace_back(Op_Cache{});
+    f.sc_.clear_calls();
+    f.sc_.callcaches_.emplace_back(Call_Cache{});
   #if RANGE_EXPRESSIONS
     f.sc_.out() << "  for (float " << i << "=" << first << ";"
              << i << (range->half_open_ ? "<" : "<=") << last << ";"
@@ -904,6 +1118,7 @@ void For_Op::sc_exec(SC_Frame& f) const
     }
     body_->sc_exec(f);
     f.sc_.out() << "  }\n";
+    f.sc_.callcaches_.pop_back();
     f.sc_.opcaches_.pop_back();
 }
 SC_Value Equal_Expr::sc_eval(SC_Frame& f) const
@@ -5,6 +5,8 @@
 #ifndef LIBCURV_SC_COMPILER_H
 #define LIBCURV_SC_COMPILER_H
 
+#include <map>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 #include <libcurv/sc_frame.h>
@@ -58,6 +60,22 @@ struct Op_Hash_Eq
 using Op_Cache =
     std::unordered_map<Shared<const Operation>, SC_Value, Op_Hash, Op_Hash_Eq>;
 
+// Results of inline expanded closure calls whose argument is a variable,
+// keyed on the closure's body and nonlocals, and on the argument. SubCurv
+// functions have no side effects, so a later call of the same closure with
+// the same argument can reuse the result. For example, `_union2.colour`
+// calls the `dist` functions of its children, which were already called
+// by `_union2.dist` or by the `colour` function of an enclosing union.
+// The entry holds a reference to the closure, so that the key pointers
+// remain valid.
+using Call_Key = std::tuple<const void*, const void*, unsigned>;
+struct Call_Cache_Entry
+{
+    Value func_;
+    SC_Value result_;
+};
+using Call_Cache = std::map<Call_Key, Call_Cache_Entry>;
+
 /// Global state for the GLSL/C++ code generator.
 struct SC_Compiler
 {
@@ -71,6 +89,9 @@ struct SC_Compiler
     std::unordered_map<Value, SC_Value, Value::Hash, Value::Hash_Eq>
         valcache_{};
     std::vector<Op_Cache> opcaches_{};
+    // A stack of call caches. A scope is pushed while compiling code that is
+    // conditionally executed, or that is the body of a loop.
+    std::vector<Call_Cache> callcaches_{};
 
     SC_Compiler(std::ostream& s, SC_Target t, System& sys)
     :
@@ -97,9 +118,39 @@ struct SC_Compiler
         Shared<const Function> func,
         const Context& cx);
 
+    // C++ target only. Define a batched entry point that evaluates `func`
+    // at `n` points, with arguments and results passed as structure of
+    // arrays: one float array per vector component. The generated function
+    // has the signature
+    //   void name(unsigned n, const float* in0,..., float* out0,...)
+    // The function body is compiled inline into a loop over the points,
+    // with constants hoisted out of the loop, and with no dependencies
+    // between iterations, so that the C++ compiler can vectorize it.
+    // The parameter and result types must be Num or VecN.
+    void define_batch_function(
+        const char* name, SC_Type param_type, SC_Type result_type,
+        Shared<const Function> func, const Context&);
+
+    // Define a function that calls each of `funcs` with the same argument,
+    // and returns their results concatenated into one vector of type
+    // `result_type`. The calls are compiled into a single function body,
+    // so constants, uniform subexpressions and function calls that are common
+    // to the functions are only emitted once. For example, fusing the colour
+    // and dist functions of a shape into one Vec4 function costs little
+    // more than computing the colour alone.
+    void define_fused_function(
+        const char* name, SC_Type param_type, SC_Type result_type,
+        std::vector<Shared<const Function>> funcs, const Context&);
+
     void begin_function();
     void end_function();
 
+    // Call cache operations. Assigning to a variable, or compiling a loop,
+    // clears the cache, since an argument variable may have been modified.
+    bool find_call(const Call_Key&, SC_Value&) const;
+    void add_call(const Call_Key&, Value func, SC_Value result);
+    void clear_calls();
+
     inline SC_Value newvalue(SC_Type type)
     {
         return SC_Value(valcount_++, type);
@@ -136,6 +187,9 @@ struct SC_Compiler
 SC_Value sc_eval_op(SC_Frame& f, const Operation& op);
 SC_Value sc_eval_expr(SC_Frame&, const Operation& op, SC_Type);
 SC_Value sc_eval_const(SC_Frame& f, Value val, const Phrase&);
+// If `op` is a reference to a local variable, store its value in `val`
+// without emitting any code, and return true.
+bool sc_eval_var(SC_Frame&, const Operation& op, SC_Value& val);
 SC_Value sc_call_unary_numeric(SC_Frame&, const char*);
 void sc_put_as(SC_Frame& f, SC_Value val, const Context&, SC_Type type);
 SC_Value sc_vec_element(SC_Frame&, SC_Value, int);
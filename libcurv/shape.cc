@@ -27,6 +27,22 @@ Shape_Program::Shape_Program(
     is_3d_ = false;
 }
 
+void
+Shape::dist_batch(unsigned n,
+    const float* x, const float* y, const float* z, const float* t,
+    float* out)
+{
+    for (unsigned i = 0; i < n; ++i)
+        out[i] = dist(x[i], y[i], z[i], t[i]);
+}
+
+double
+Shape::dist_colour(double x, double y, double z, double t, Vec3& col)
+{
+    col = colour(x, y, z, t);
+    return dist(x, y, z, t);
+}
+
 Location Shape_Program::location() const
 {
     return nub_->location();
@@ -126,6 +142,29 @@ Shape_Program::recognize(Value val, Render_Opts* opts)
     return true;
 }
 
+Shape_Program::Shape_Program(
+    const Shape_Program& shape)
+:
+    system_(shape.system_),
+    nub_(shape.nub_),
+    record_(shape.record_),
+    dist_fun_(shape.dist_fun_),
+    colour_fun_(shape.colour_fun_),
+    viewed_shape_(shape.viewed_shape_)
+{
+    is_2d_ = shape.is_2d_;
+    is_3d_ = shape.is_3d_;
+    bbox_ = shape.bbox_;
+    if (shape.dist_frame_) {
+        dist_frame_ = Frame::make(
+            dist_fun_->nslots_, system_, nullptr, nullptr, nullptr);
+    }
+    if (shape.colour_frame_) {
+        colour_frame_ = Frame::make(
+            colour_fun_->nslots_, system_, nullptr, nullptr, nullptr);
+    }
+}
+
 Shape_Program::Shape_Program(
     const Shape_Program& shape,
     Shared<Record> r,
@@ -158,21 +197,44 @@ Shape_Program::Shape_Program(
             "bad parametric shape: call result has no 'colour' field: ", r)};
 }
 
+Value
+Shape_Program::make_point(double x, double y, double z, double t)
+{
+    if (point_ == nullptr || load_use_count(*point_) > 1)
+        point_ = make_list(4);
+    (*point_)[0] = Value{x};
+    (*point_)[1] = Value{y};
+    (*point_)[2] = Value{z};
+    (*point_)[3] = Value{t};
+    return Value{point_};
+}
+
+// Drop the references held by a call frame's slots once a call returns.
+// Otherwise, the frame would keep the last point argument alive, and
+// make_point would be unable to reuse it.
+static void
+clear_frame(Frame& f)
+{
+    for (slot_t i = 0; i < f.size_; ++i)
+        f[i] = missing;
+}
+
 double
 Shape_Program::dist(double x, double y, double z, double t)
 {
-    At_Program cx(*this);
-    Shared<List> point = List::make({Value{x}, Value{y}, Value{z}, Value{t}});
-    Value result = dist_fun_->call({point}, *dist_frame_);
-    return result.to_num(cx);
+    Value result = dist_fun_->call(make_point(x,y,z,t), *dist_frame_);
+    clear_frame(*dist_frame_);
+    if (result.is_num())
+        return result.to_num_unsafe();
+    return result.to_num(At_Program(*this));
 }
 
 Vec3
 Shape_Program::colour(double x, double y, double z, double t)
 {
     At_Program cx(*this);
-    Shared<List> point = List::make({Value{x}, Value{y}, Value{z}, Value{t}});
-    Value result = colour_fun_->call({point}, *colour_frame_);
+    Value result = colour_fun_->call(make_point(x,y,z,t), *colour_frame_);
+    clear_frame(*colour_frame_);
     Shared<List> cval = result.to<List>(cx);
     cval->assert_size(3, cx);
     return Vec3{ cval->at(0).to_num(cx),
@@ -61,6 +61,20 @@ struct Shape
     BBox bbox_;
     virtual double dist(double x, double y, double z, double t) = 0;
     virtual Vec3 colour(double x, double y, double z, double t) = 0;
+
+    // Evaluate dist at n points, passed as arrays of coordinates.
+    // The default implementation calls dist() once per point.
+    // Compiled_Shape overrides this with vectorized code.
+    virtual void dist_batch(unsigned n,
+        const float* x, const float* y, const float* z, const float* t,
+        float* out);
+
+    // Evaluate dist and colour at the same point, returning the distance.
+    // The default implementation calls dist() and colour(). A Compiled_Shape
+    // constructed with fused=true uses a fused function that shares the
+    // work common to both.
+    virtual double dist_colour(double x, double y, double z, double t,
+        Vec3& colour);
 };
 
 struct Shape_Program final : public Shape
@@ -84,6 +98,11 @@ struct Shape_Program final : public Shape
     std::unique_ptr<Frame> dist_frame_;
     std::unique_ptr<Frame> colour_frame_;
 
+    // Argument list passed to dist and colour. It is updated in place when
+    // we hold the only reference, so that sampling a shape using the
+    // interpreter doesn't allocate a new point for each sample.
+    Shared<List> point_;
+
     Viewed_Shape* viewed_shape_ = nullptr;
 
     Shape_Program(Program&);
@@ -98,6 +117,12 @@ struct Shape_Program final : public Shape
     // Used with the first constructor.
     bool recognize(Value, Render_Opts*);
 
+    // Copy a recognized shape. The copy shares the shape's functions, but
+    // has its own call frames and point argument, so that the copy and the
+    // original can be evaluated concurrently by different threads, within
+    // a Thread_Shared_Scope.
+    Shape_Program(const Shape_Program&);
+
     // This is called from the Viewed_Shape constructor, after a
     // parametric shape has been recognized. We construct a Shape_Program
     // that describes a parametric shape.
@@ -108,6 +133,9 @@ struct Shape_Program final : public Shape
 
     // Invoke the shape's `colour` function.
     Vec3 colour(double x, double y, double z, double t);
+
+private:
+    Value make_point(double x, double y, double z, double t);
 };
 
 } // namespace
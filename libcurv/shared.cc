@@ -0,0 +1,11 @@
+// Copyright 2016-2019 Doug Moen
+// Licensed under the Apache License, version 2.0
+// See accompanying file LICENSE or https://www.apache.org/licenses/LICENSE-2.0
+
+#include <libcurv/shared.h>
+
+namespace curv {
+
+std::atomic<unsigned> thread_shared_scopes{0};
+
+} // namespace curv
@@ -6,6 +6,7 @@
 #define LIBCURV_SHARED_H
 
 #include <boost/intrusive_ptr.hpp>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
@@ -67,6 +68,7 @@ template<typename T, class... Args> Shared<T> make(Args&&... args)
 /// For performance reasons, the use_count is incremented and decremented
 /// non-atomically, which is not thread safe. That's what you typically
 /// need in cases where `std::shared_ptr` is too expensive.
+/// Within a `Thread_Shared_Scope`, use_count updates are atomic instead.
 ///
 /// The memory overhead is one use_count, instead of two for `std::shared_ptr`.
 /// Plus I'm forcing the use of a vtable. I specifically want the vtable pointer
@@ -143,25 +145,55 @@ private:
     Shared_Base& operator=(const Shared_Base&) = delete;
 };
 
+/// The number of live Thread_Shared_Scope objects.
+extern std::atomic<unsigned> thread_shared_scopes;
+
+/// True if reference counts are currently updated atomically.
+inline bool is_thread_shared()
+{
+    return thread_shared_scopes.load(std::memory_order_relaxed) != 0;
+}
+
+/// While a Thread_Shared_Scope exists, Shared_Base reference counts are
+/// updated atomically, so that Values may be shared between threads.
+/// Outside of a scope, the cost is one test of a global flag per update.
+///
+/// Create the scope before starting the threads that share Values,
+/// and destroy it after they are joined: the mode must not change while
+/// more than one thread is using shared objects. Only reference counting
+/// is made thread safe. Objects that are mutated during evaluation, like
+/// a Frame or a Shape_Program, must not be shared: each thread uses its own.
+struct Thread_Shared_Scope
+{
+    Thread_Shared_Scope() { ++thread_shared_scopes; }
+    ~Thread_Shared_Scope() { --thread_shared_scopes; }
+    Thread_Shared_Scope(const Thread_Shared_Scope&) = delete;
+    Thread_Shared_Scope& operator=(const Thread_Shared_Scope&) = delete;
+};
+
+/// Read the use_count of an object that may be shared with other threads.
+inline std::uint32_t load_use_count(const Shared_Base& obj)
+{
+    return __atomic_load_n(&obj.use_count, __ATOMIC_RELAXED);
+}
+
 inline void intrusive_ptr_add_ref(const Shared_Base* p)
 {
-    ++p->use_count;
+    if (is_thread_shared())
+        __atomic_fetch_add(&p->use_count, 1, __ATOMIC_RELAXED);
+    else
+        ++p->use_count;
 }
 
 inline void intrusive_ptr_release(const Shared_Base* p)
 {
-    if (--p->use_count == 0)
+    if (is_thread_shared()) {
+        if (__atomic_sub_fetch(&p->use_count, 1, __ATOMIC_ACQ_REL) == 0)
+            delete p;
+    } else if (--p->use_count == 0)
         delete p;
 }
 
-// How to support atomic refcount update in the future.
-// * Add a Shared_Atomic_Base class, which always uses atomic updates.
-// * Add a Shared_Maybe_Atomic_Base class, which reserves a bit in the
-//   use_count to indicate whether the use_count should be updated atomically.
-//   When an object is first constructed, it's only accessible from one thread.
-//   Later, it might "escape" and become visible to more than thread.
-//   If and when this happens, we mark the object as atomic.
-
 template<class T, class U>
 inline Shared<T>
 cast(Shared<U> p)
@@ -180,7 +212,7 @@ template<class T>
 inline Shared<T>
 share(T& obj)
 {
-    assert(obj.use_count > 0);
+    assert(load_use_count(obj) > 0);
     return Shared<T>(&obj);
 }
 
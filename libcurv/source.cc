@@ -18,8 +18,8 @@ namespace curv
 
 Shared<const String> readfile(const char* path, const Context& ctx)
 {
-    // TODO: Cache multiple references to the same file. Where does the cache
-    // go? System or Session object.
+    // Multiple references to the same Curv source file are cached by
+    // curv_import(), using System::import_cache_.
 
     // TODO: Pluggable file system abstraction, for unit testing and
     // abstracting the behaviour of `file` (would also support caching).
@@ -30,17 +30,24 @@ public:
     static Shared<STRING>
     make(int ty, const char* str, size_t len)
     {
+        if (len > UINT32_MAX)
+            throw std::bad_alloc();
         void* raw = malloc(sizeof(STRING) + len);
         if (raw == nullptr)
             throw std::bad_alloc();
         STRING* s = new(raw) STRING(ty);
         memcpy(s->data_, str, len);
         s->data_[len] = '\0';
-        s->size_ = len;
+        s->size_ = uint32_t(len);
+        s->hash_ = 0;
         return Shared<STRING>{s};
     }
 private:
-    size_t size_;
+    uint32_t size_;
+protected:
+    // Hash code. Only computed for symbols, which are interned.
+    uint32_t hash_;
+private:
     char data_[1];
 public:
     // interface is based on std::string and the STL container concept
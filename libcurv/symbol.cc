@@ -5,15 +5,79 @@
 #include <libcurv/symbol.h>
 #include <libcurv/exception.h>
 #include <cctype>
+#include <mutex>
 
 namespace curv {
 
 const char Symbol::name[] = "symbol";
 
+namespace {
+
+// The global symbol table: an open addressing hash table with linear probing.
+// It owns a reference to each symbol, so symbols are never freed.
+struct Symbol_Table
+{
+    std::mutex mutex_;
+    std::vector<Shared<const Symbol>> slots_;
+    size_t count_ = 0;
+
+    Symbol_Table() : slots_(1024) {}
+
+    static uint32_t hash(const char* str, size_t len)
+    {
+        // FNV-1a
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; ++i) {
+            h ^= (unsigned char)str[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+    void grow()
+    {
+        std::vector<Shared<const Symbol>> old(slots_.size() * 2);
+        old.swap(slots_);
+        size_t mask = slots_.size() - 1;
+        for (auto& sym : old) {
+            if (sym == nullptr) continue;
+            size_t i = sym->hash() & mask;
+            while (slots_[i] != nullptr)
+                i = (i + 1) & mask;
+            slots_[i] = std::move(sym);
+        }
+    }
+};
+
+Symbol_Table& symbol_table()
+{
+    static Symbol_Table* table = new Symbol_Table();
+    return *table;
+}
+
+} // namespace
+
 Symbol_Ref
 make_symbol(const char* str, size_t len)
 {
-    return Symbol::make<Symbol>(Ref_Value::ty_symbol, str, len);
+    uint32_t h = Symbol_Table::hash(str, len);
+    Symbol_Table& table = symbol_table();
+    std::lock_guard<std::mutex> lock(table.mutex_);
+    size_t mask = table.slots_.size() - 1;
+    size_t i = h & mask;
+    for (; table.slots_[i] != nullptr; i = (i + 1) & mask) {
+        auto& sym = *table.slots_[i];
+        if (sym.hash_ == h && sym.size() == len
+            && memcmp(sym.data(), str, len) == 0)
+        {
+            return Symbol_Ref(table.slots_[i]);
+        }
+    }
+    auto sym = Symbol::make<Symbol>(Ref_Value::ty_symbol, str, len);
+    sym->hash_ = h;
+    table.slots_[i] = sym;
+    if (++table.count_ * 2 > table.slots_.size())
+        table.grow();
+    return Symbol_Ref(std::move(sym));
 }
 
 bool is_C_identifier(const char* p)
@@ -84,7 +148,7 @@ Value Symbol_Ref::to_value() const
         return Value{true};
     if (*this == "false")
         return Value{false};
-    return Value{*this};
+    return Value{share(**this)};
 }
 
 std::ostream& operator<<(std::ostream& out, Symbol_Ref a)
@@ -6,7 +6,10 @@
 #define LIBCURV_SYMBOL_H
 
 #include <libcurv/string.h>
-#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace curv {
@@ -20,6 +23,7 @@ struct Symbol : public String_or_Symbol
     friend Symbol_Ref make_symbol(const char*, size_t);
     virtual void print(std::ostream&) const;
     static const char name[];
+    uint32_t hash() const noexcept { return hash_; }
 };
 
 /// A Symbol_Ref is a short immutable string with an efficient representation.
@@ -27,35 +31,38 @@ struct Symbol : public String_or_Symbol
 /// A Symbol_Ref represents an identifier during semantic analysis and run time.
 /// For example, a symbol in a symbol map, or a field name in a record value.
 ///
-/// There is a guaranteed global ordering on symbols, which is relied on
-/// for efficiently merging two symbol maps.
+/// Symbols are interned in a global symbol table, so two symbols with the
+/// same name are the same object: symbol equality is pointer equality, and
+/// each symbol has a precomputed hash code. The symbol table slowly grows,
+/// it never shrinks.
 ///
-/// Possible changes in future revisions:
-/// * Add a hash code, so that we can use hash trees for Symbol_Map.
-/// * Use a global symbol table stored in the curv::System object to ensure that
-///   symbols are unique, so we can use pointer equality as symbol equality.
-///   This will also eliminate refcount manipulation, at a cost: the symbol
-///   table slowly grows, never shrinks.
-struct Symbol_Ref : private Shared<const Symbol>
+/// There is a guaranteed global ordering on symbols (alphabetical), which is
+/// relied on for efficiently merging two symbol maps, and for printing
+/// records in a canonical order.
+///
+/// Since interned symbols are never freed, a Symbol_Ref is a plain pointer,
+/// and copying it doesn't touch the reference count.
+struct Symbol_Ref
 {
 private:
-    using Base = Shared<const Symbol>;
-    inline Symbol_Ref(Base sym) : Base(sym) {}
-    friend void Symbol::print(std::ostream& out) const;
+    const Symbol* sym_;
 public:
-    using Shared<const Symbol>::Shared;
+    inline Symbol_Ref() noexcept : sym_(nullptr) {}
+    inline Symbol_Ref(std::nullptr_t) noexcept : sym_(nullptr) {}
 
-    inline Symbol_Ref()
+    // The Symbol must have been constructed by make_symbol().
+    inline Symbol_Ref(const Shared<const Symbol>& sym) noexcept
     :
-        Base()
-    {
-    }
+        sym_(sym.get())
+    {}
+    inline Symbol_Ref(const Shared<Symbol>& sym) noexcept
+    :
+        sym_(sym.get())
+    {}
 
-    inline Symbol_Ref& operator=(Symbol_Ref a2)
-    {
-        Base::operator=(a2);
-        return *this;
-    }
+    const Symbol* get() const noexcept { return sym_; }
+    const Symbol* operator->() const noexcept { return sym_; }
+    const Symbol& operator*() const noexcept { return *sym_; }
 
     bool empty() const noexcept
     {
@@ -64,11 +71,12 @@ public:
 
     int cmp(Symbol_Ref a) const noexcept
     {
+        if (this->get() == a.get()) return 0;
         return strcmp((*this)->c_str(), a->c_str());
     }
     friend bool operator==(Symbol_Ref a1, Symbol_Ref a2) noexcept
     {
-        return *a1 == *a2;
+        return a1.get() == a2.get();
     }
     friend bool operator==(Symbol_Ref a1, const char* a2) noexcept
     {
@@ -76,12 +84,13 @@ public:
     }
     friend bool operator!=(Symbol_Ref a1, Symbol_Ref a2) noexcept
     {
-        return !(*a1 == *a2);
+        return a1.get() != a2.get();
     }
     friend bool operator<(Symbol_Ref a1, Symbol_Ref a2) noexcept
     {
-        return *a1 < *a2;
+        return a1.get() != a2.get() && *a1 < *a2;
     }
+    uint32_t hash() const noexcept { return (*this)->hash(); }
 
   #if 0
     inline const char* data() const { return (*this)->data(); }
@@ -92,7 +101,7 @@ public:
 
     friend void swap(Symbol_Ref& a1, Symbol_Ref& a2) noexcept
     {
-        a1.swap(a2);
+        std::swap(a1.sym_, a2.sym_);
     }
     friend std::ostream& operator<<(std::ostream& out, Symbol_Ref a);
     Value to_value() const;
@@ -126,12 +135,143 @@ int value_to_enum(Value, const std::vector<const char*>&, const Context&);
 /// according to the global ordering on Symbols. This is used to efficiently
 /// merge two symbol maps.
 ///
-/// Alternate design: https://en.wikipedia.org/wiki/Hash_array_mapped_trie,
-/// with the keys ordered by hash value instead of alphabetically.
+/// It is a flat map: the entries are stored in a sorted vector. Most maps
+/// are small (record fields, function parameters), and for these, a linear
+/// search using pointer equality is faster than a tree or hash lookup.
+/// Large maps use binary search. Unlike std::map, inserting or erasing an
+/// entry invalidates iterators and references to other entries.
 template<typename T>
-struct Symbol_Map : public std::map<Symbol_Ref, T>
+struct Symbol_Map
 {
-    using std::map<Symbol_Ref,T>::map;
+    using key_type = Symbol_Ref;
+    using mapped_type = T;
+    using value_type = std::pair<Symbol_Ref, T>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    Symbol_Map() {}
+    Symbol_Map(std::initializer_list<value_type> init)
+    {
+        for (auto& e : init)
+            insert(e);
+    }
+
+    iterator begin() noexcept { return entries_.begin(); }
+    iterator end() noexcept { return entries_.end(); }
+    const_iterator begin() const noexcept { return entries_.begin(); }
+    const_iterator end() const noexcept { return entries_.end(); }
+    const_iterator cbegin() const noexcept { return entries_.begin(); }
+    const_iterator cend() const noexcept { return entries_.end(); }
+    size_t size() const noexcept { return entries_.size(); }
+    bool empty() const noexcept { return entries_.empty(); }
+    void clear() noexcept { entries_.clear(); }
+    void reserve(size_t n) { entries_.reserve(n); }
+
+    iterator find(Symbol_Ref key) noexcept
+    {
+        return begin() + (find_index(key) - entries_.data());
+    }
+    const_iterator find(Symbol_Ref key) const noexcept
+    {
+        return begin() + (find_index(key) - entries_.data());
+    }
+    size_t count(Symbol_Ref key) const noexcept
+    {
+        return find(key) != end();
+    }
+    T& at(Symbol_Ref key)
+    {
+        auto i = find(key);
+        if (i == end())
+            throw std::out_of_range("Symbol_Map::at");
+        return i->second;
+    }
+    const T& at(Symbol_Ref key) const
+    {
+        auto i = find(key);
+        if (i == end())
+            throw std::out_of_range("Symbol_Map::at");
+        return i->second;
+    }
+    T& operator[](Symbol_Ref key)
+    {
+        return try_emplace(key).first->second;
+    }
+    std::pair<iterator,bool> insert(const value_type& e)
+    {
+        return try_emplace(e.first, e.second);
+    }
+    std::pair<iterator,bool> insert(value_type&& e)
+    {
+        return try_emplace(e.first, std::move(e.second));
+    }
+    std::pair<iterator,bool> emplace(value_type&& e)
+    {
+        return try_emplace(e.first, std::move(e.second));
+    }
+    template<class... Args>
+    std::pair<iterator,bool> emplace(Symbol_Ref key, Args&&... args)
+    {
+        return try_emplace(key, std::forward<Args>(args)...);
+    }
+    template<class... Args>
+    std::pair<iterator,bool> try_emplace(Symbol_Ref key, Args&&... args)
+    {
+        auto i = lower_bound(key);
+        if (i != end() && i->first == key)
+            return {i, false};
+        i = entries_.emplace(i, std::piecewise_construct,
+            std::forward_as_tuple(key),
+            std::forward_as_tuple(std::forward<Args>(args)...));
+        return {i, true};
+    }
+    iterator erase(const_iterator i) { return entries_.erase(i); }
+    size_t erase(Symbol_Ref key)
+    {
+        auto i = find(key);
+        if (i == end()) return 0;
+        entries_.erase(i);
+        return 1;
+    }
+    iterator lower_bound(Symbol_Ref key) noexcept
+    {
+        return std::lower_bound(begin(), end(), key,
+            [](const value_type& e, Symbol_Ref k) { return e.first < k; });
+    }
+    const_iterator lower_bound(Symbol_Ref key) const noexcept
+    {
+        return std::lower_bound(begin(), end(), key,
+            [](const value_type& e, Symbol_Ref k) { return e.first < k; });
+    }
+
+    friend bool operator==(const Symbol_Map& a, const Symbol_Map& b)
+    {
+        return a.entries_ == b.entries_;
+    }
+    friend bool operator!=(const Symbol_Map& a, const Symbol_Map& b)
+    {
+        return !(a == b);
+    }
+
+private:
+    std::vector<value_type> entries_;
+    static constexpr size_t linear_search_max = 16;
+
+    // Returns a pointer to the entry, or a pointer past the end.
+    const value_type* find_index(Symbol_Ref key) const noexcept
+    {
+        const value_type* p = entries_.data();
+        size_t n = entries_.size();
+        if (n <= linear_search_max) {
+            for (size_t i = 0; i < n; ++i)
+                if (p[i].first == key) return p + i;
+            return p + n;
+        }
+        auto i = lower_bound(key);
+        if (i != end() && i->first == key)
+            return &*i;
+        return p + n;
+    }
 };
 
 } // namespace curv
@@ -12,6 +12,8 @@
 #include <libcurv/program.h>
 #include <libcurv/source.h>
 
+#include <mutex>
+
 namespace curv {
 
 void System::print_exception(
@@ -55,6 +57,7 @@ void System::print_json_exception(
 
 void System::error(const std::exception& exc)
 {
+    std::lock_guard<std::mutex> lock(console_mutex_);
     if (use_json_api_)
         print_json_exception("error", exc, console());
     else
@@ -63,6 +66,7 @@ void System::error(const std::exception& exc)
 
 void System::warning(const std::exception& exc)
 {
+    std::lock_guard<std::mutex> lock(console_mutex_);
     if (use_json_api_)
         print_json_exception("warning", exc, console());
     else
@@ -71,6 +75,7 @@ void System::warning(const std::exception& exc)
 
 void System::print(const char* str)
 {
+    std::lock_guard<std::mutex> lock(console_mutex_);
     if (use_json_api_) {
         console() << "{\"print\":";
         write_json_string(str, console());
@@ -81,6 +86,32 @@ void System::print(const char* str)
     console() << std::endl;
 }
 
+namespace {
+// The import state used by the current thread, if it isn't the System's
+// main_import_state_.
+thread_local std::pair<System*,System::Import_State*> thread_import_state
+    {nullptr, nullptr};
+}
+
+System::Import_State& System::import_state()
+{
+    if (thread_import_state.first == this)
+        return *thread_import_state.second;
+    return main_import_state_;
+}
+
+Use_Import_State::Use_Import_State(System& sys, System::Import_State& state)
+:
+    saved_(thread_import_state)
+{
+    thread_import_state = {&sys, &state};
+}
+
+Use_Import_State::~Use_Import_State()
+{
+    thread_import_state = saved_;
+}
+
 System_Impl::System_Impl(std::ostream& console)
 :
     console_(console)
@@ -89,15 +120,61 @@ System_Impl::System_Impl(std::ostream& console)
     importers_[".curv"] = curv_import;
 }
 
+namespace {
+
+// A snapshot of the definitions in an evaluated library.
+//
+// Compiling and evaluating std.curv dominates the cost of constructing a
+// System. The snapshot is reused by later calls to load_library within the
+// same process that load the same library source into the same namespace.
+// The values in a snapshot are immutable, so they can be shared between
+// System objects, but their reference counts are not: see load_library
+// in system.h for the restriction on sharing them between threads.
+struct Library_Snapshot
+{
+    std::string path_;
+    std::string source_;
+    bool use_bytecode_;
+    Namespace base_;  // the namespace that the library was compiled in
+    Namespace defs_;  // the library definitions
+};
+
+std::mutex snapshot_mutex;
+std::vector<Library_Snapshot> snapshots;
+
+} // namespace
+
 void System_Impl::load_library(String_Ref path)
 {
     auto file = make<File_Source>(std::move(path), At_System{*this});
+    std::string source(file->begin(), file->size());
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        for (auto& snap : snapshots) {
+            if (snap.path_ == file->name_->c_str()
+                && snap.source_ == source
+                && snap.use_bytecode_ == use_bytecode_
+                && snap.base_ == std_namespace_)
+            {
+                for (auto& b : snap.defs_)
+                    std_namespace_[b.first] = b.second;
+                return;
+            }
+        }
+    }
+    Library_Snapshot snap{file->name_->c_str(), std::move(source),
+        use_bytecode_, std_namespace_, {}};
     Program prog{std::move(file), *this};
     prog.compile();
     auto stdlib = prog.eval();
     auto m = stdlib.to<Module>(At_Phrase(*prog.phrase_, *this, nullptr));
-    for (auto b : *m)
-        std_namespace_[b.first] = make<Builtin_Value>(b.second);
+    for (auto b : *m) {
+        auto def = make<Builtin_Value>(b.second);
+        std_namespace_[b.first] = def;
+        snap.defs_[b.first] = def;
+    }
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    snapshots.push_back(std::move(snap));
 }
 
 const Namespace& System_Impl::std_namespace()
@@ -6,8 +6,11 @@
 #define LIBCURV_SYSTEM_H
 
 #include <ostream>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <map>
+#include <mutex>
 #include <libcurv/filesystem.h>
 #include <libcurv/builtin.h>
 
@@ -32,6 +35,14 @@ struct System
     // True if the json-api protocol is being used.
     bool use_json_api_ = false;
 
+    // Set to true to evaluate function bodies using the bytecode interpreter
+    // (see bytecode.h) instead of the tree walking interpreter. This affects
+    // functions that are constructed after the flag is set: for full effect,
+    // set it before loading the standard library.
+    // The bytecode interpreter is experimental, and is not yet faster than
+    // the tree walker: see bench/eval.cc.
+    bool use_bytecode_ = false;
+
     virtual std::ostream& console() = 0;
 
     // Write an exception object to an output stream, using the Curv colour
@@ -49,11 +60,46 @@ struct System
     void warning(const std::exception& exc);
     void print(const char*);
 
-    // This is non-empty while a `file` operation is being evaluated.
-    // It is used to detect recursive file references.
-    // Later, this may change to a file cache.
-    // Or, it could move into the Program structure.
-    std::unordered_set<Filesystem::path,Path_Hash> active_files_{};
+    // Set to a number > 1 to evaluate the independent definitions of a
+    // module using up to that many threads (see Scope_Executable).
+    unsigned eval_threads_ = 1;
+
+    // Cache of the values of Curv source files imported by `file`, keyed by
+    // canonical path. An entry is reused if the contents of the file, and of
+    // every file it imported while being evaluated, are unchanged.
+    // See curv_import().
+    using File_Hashes = std::vector<std::pair<Filesystem::path,uint64_t>>;
+    struct Import_Entry
+    {
+        File_Hashes files_; // the file and its imports, with content hashes
+        Value value_;
+    };
+    std::unordered_map<Filesystem::path,Import_Entry,Path_Hash>
+        import_cache_{};
+    // Import cache statistics.
+    unsigned import_hits_ = 0;
+    unsigned import_misses_ = 0;
+
+    // The state of the `file` operations being evaluated by one thread.
+    struct Import_State
+    {
+        // This is non-empty while a `file` operation is being evaluated.
+        // It is used to detect recursive file references.
+        std::unordered_set<Filesystem::path,Path_Hash> active_files_{};
+        // While Curv source files are being imported, the files that they
+        // import are recorded here.
+        std::vector<File_Hashes*> import_deps_{};
+    };
+    Import_State main_import_state_{};
+    // The import state of the current thread. This is main_import_state_,
+    // except in a worker thread that is evaluating definitions in parallel,
+    // which has its own copy (see Use_Import_State).
+    Import_State& import_state();
+    // Guards import_cache_, the import statistics, and the File_Hashes
+    // lists in import_deps_, which are shared with worker threads.
+    std::mutex import_mutex_;
+    // Serializes output to the console.
+    std::mutex console_mutex_;
 
     // Used by `file` to import a file based on its extension.
     // The extension includes the leading '.', and "" means no extension.
@@ -62,7 +108,7 @@ struct System
     std::map<std::string,Importer> importers_;
 };
 
-// RAII helper class, for use with System::active_files_.
+// RAII helper class, for use with System::Import_State::active_files_.
 struct Active_File
 {
     std::unordered_set<Filesystem::path,Path_Hash>& active_files_;
@@ -82,12 +128,32 @@ struct Active_File
     }
 };
 
+// RAII helper class: while it exists, the current thread uses `state`
+// as its import state for `sys`.
+struct Use_Import_State
+{
+    std::pair<System*,System::Import_State*> saved_;
+    Use_Import_State(System& sys, System::Import_State& state);
+    ~Use_Import_State();
+};
+
 /// Default implementation of the System interface.
 struct System_Impl : public System
 {
     Namespace std_namespace_;
     std::ostream& console_;
     System_Impl(std::ostream&);
+    // Load a library file (like std.curv), and add its definitions to
+    // std_namespace_. The evaluated definitions are cached for the lifetime
+    // of the process, so loading the same library (with the same source
+    // code, namespace and use_bytecode_ flag) into another System in the
+    // same process is cheap. The cache isn't persistent, so it doesn't speed
+    // up a `curv` command, which loads std.curv once.
+    //
+    // The cached values are shared by every System that loads the library,
+    // and their reference counts are only atomic within a Thread_Shared_Scope.
+    // If two of these Systems are used concurrently by different threads,
+    // then both threads must be inside a Thread_Shared_Scope.
     void load_library(String_Ref path);
     virtual const Namespace& std_namespace() override;
     virtual std::ostream& console() override;
@@ -85,10 +85,12 @@ public: \
 /// which return std::unique_ptr. (The pointers are deleted using `delete`,
 /// but that happens internal to unique_ptr.)
 ///
-/// `Tail_Array` uses `malloc` and `free` for storage management.
+/// `Tail_Array` uses `malloc` and `free` for storage management, by default.
 /// This is because C++ allocators don't provide an appropriate interface:
 /// there's no way to allocate a Tail_Array object while requesting
 /// the correct number of bytes and the correct alignment.
+/// The optional `Alloc` argument replaces `malloc` and `free` with
+/// `Alloc::allocate` and `Alloc::deallocate`. See Tail_Array_Malloc.
 ///
 /// Suppose `Base` is derived from a polymorphic base class `P`, such that
 /// you can delete a `P*`. A big clue is that `P` defines a virtual destructor.
@@ -102,7 +104,18 @@ public: \
 ///   using the supplied factory functions, because ordinary C++ constructors
 ///   don't support variable-size objects.
 /// * You can't assign to it, copy it or move it.
-template<class Base>
+/// The default storage management policy for Tail_Array.
+struct Tail_Array_Malloc
+{
+    static void* allocate(size_t size) noexcept { return malloc(size); }
+    static void* reallocate(void* p, size_t size) noexcept
+    {
+        return realloc(p, size);
+    }
+    static void deallocate(void* p) noexcept { free(p); }
+};
+
+template<class Base, class Alloc = Tail_Array_Malloc>
 class Tail_Array final : public Base
 {
     using _value_type = typename Base::value_type;
@@ -110,9 +123,19 @@ public:
     /// Allocate an instance. Array elements are default constructed.
     template<typename... Rest>
     static std::unique_ptr<Tail_Array> make(size_t size, Rest&&... rest)
+    {
+        return make_using(Alloc::allocate, size, std::forward<Rest>(rest)...);
+    }
+
+    /// Allocate an instance, using `alloc(nbytes)` to allocate storage
+    /// instead of Alloc::allocate. The storage is still released using
+    /// Alloc::deallocate, which must accept it.
+    template<class F, typename... Rest>
+    static std::unique_ptr<Tail_Array>
+    make_using(F&& alloc, size_t size, Rest&&... rest)
     {
         // allocate the object
-        void* mem = malloc(sizeof(Tail_Array) + size*sizeof(_value_type));
+        void* mem = alloc(sizeof(Tail_Array) + size*sizeof(_value_type));
         if (mem == nullptr)
             throw std::bad_alloc();
         Tail_Array* r = (Tail_Array*)mem;
@@ -134,7 +157,7 @@ public:
             r->Base::size_ = size;
         } catch(...) {
             r->destroy_array(size);
-            free(mem);
+            Alloc::deallocate(mem);
             throw;
         }
         return std::unique_ptr<Tail_Array>(r);
@@ -146,7 +169,7 @@ public:
     {
         // allocate the object
         auto size = c.size();
-        void* mem = malloc(sizeof(Tail_Array) + size*sizeof(_value_type));
+        void* mem = Alloc::allocate(sizeof(Tail_Array) + size*sizeof(_value_type));
         if (mem == nullptr)
             throw std::bad_alloc();
         Tail_Array* r = (Tail_Array*)mem;
@@ -163,7 +186,7 @@ public:
             }
         } catch (...) {
             r->destroy_array(i);
-            free(mem);
+            Alloc::deallocate(mem);
             throw;
         }
 
@@ -173,7 +196,7 @@ public:
             r->Base::size_ = size;
         } catch(...) {
             r->destroy_array(size);
-            free(mem);
+            Alloc::deallocate(mem);
             throw;
         }
         return std::unique_ptr<Tail_Array>(r);
@@ -184,7 +207,7 @@ public:
     static std::unique_ptr<Tail_Array> make_copy(const _value_type* a, size_t size, Rest&&... rest)
     {
         // allocate the object
-        void* mem = malloc(sizeof(Tail_Array) + size*sizeof(_value_type));
+        void* mem = Alloc::allocate(sizeof(Tail_Array) + size*sizeof(_value_type));
         if (mem == nullptr)
             throw std::bad_alloc();
         Tail_Array* r = (Tail_Array*)mem;
@@ -206,7 +229,7 @@ public:
                 }
             } catch (...) {
                 r->destroy_array(i);
-                free(mem);
+                Alloc::deallocate(mem);
                 throw;
             }
         }
@@ -217,7 +240,7 @@ public:
             r->Base::size_ = size;
         } catch(...) {
             r->destroy_array(size);
-            free(mem);
+            Alloc::deallocate(mem);
             throw;
         }
         return std::unique_ptr<Tail_Array>(r);
@@ -230,7 +253,7 @@ public:
     {
         // TODO: much code duplication here.
         // allocate the object
-        void* mem = malloc(sizeof(Tail_Array) + il.size()*sizeof(_value_type));
+        void* mem = Alloc::allocate(sizeof(Tail_Array) + il.size()*sizeof(_value_type));
         if (mem == nullptr)
             throw std::bad_alloc();
         Tail_Array* r = (Tail_Array*)mem;
@@ -251,7 +274,7 @@ public:
                 }
             } catch (...) {
                 r->destroy_array(i);
-                free(mem);
+                Alloc::deallocate(mem);
                 throw;
             }
         }
@@ -262,19 +285,46 @@ public:
             r->Base::size_ = il.size();
         } catch(...) {
             r->destroy_array(il.size());
-            free(mem);
+            Alloc::deallocate(mem);
             throw;
         }
         return std::unique_ptr<Tail_Array>(r);
     }
 
+    /// Change the number of elements in an instance. Elements are destroyed,
+    /// or default constructed, at the end of the array. The instance may be
+    /// moved to a new address by Alloc::reallocate, so `value_type` must be
+    /// trivially relocatable: it can be moved using memcpy, like curv::Value.
+    static void resize(std::unique_ptr<Tail_Array>& p, size_t size)
+    {
+        Tail_Array* r = p.release();
+        size_t old_size = r->Base::size_;
+        if (size < old_size) {
+            r->destroy_range(size, old_size);
+            r->Base::size_ = size;
+        }
+        void* mem = Alloc::reallocate(r,
+            sizeof(Tail_Array) + size*sizeof(_value_type));
+        if (mem == nullptr) {
+            p.reset(r);
+            if (size > old_size)
+                throw std::bad_alloc();
+            return;
+        }
+        r = (Tail_Array*)mem;
+        for (size_t i = old_size; i < size; ++i)
+            new((void*)&r->Base::array_[i]) _value_type();
+        r->Base::size_ = size;
+        p.reset(r);
+    }
+
     ~Tail_Array()
     {
         destroy_array(Base::size_);
     }
     void operator delete(void* p) noexcept
     {
-        free(p);
+        Alloc::deallocate(p);
     }
 
 private:
@@ -289,11 +339,15 @@ private:
     }
 
     void destroy_array(size_t size)
+    {
+        destroy_range(0, size);
+    }
+    void destroy_range(size_t first, size_t last)
     {
         if (!std::is_trivially_destructible<_value_type>::value) {
             static_assert(std::is_nothrow_destructible<_value_type>::value,
                 "value_type destructor must be declared noexcept");
-            for (size_t i = 0; i < size; ++i)
+            for (size_t i = first; i < last; ++i)
             {
                 Base::array_[i].~_value_type();
             }
@@ -0,0 +1 @@
+#define CURV_VERSION "71b1e4d-dirty"
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <libcurv/geom/compiled_shape.h>
+#include <libcurv/geom/cpu_render.h>
+#include <libcurv/exception.h>
+#include <libcurv/program.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace curv;
+
+extern System& make_system();
+
+TEST(curv, cpu_render)
+{
+    // A 2x2 red square, centred in an 8x4 image with a white background.
+    Program prog2{make<String_Source>("", "square 2 >> colour red"),
+        make_system()};
+    prog2.compile();
+    Value val2 = prog2.eval();
+    Shape_Program shape2(prog2);
+    ASSERT_TRUE(shape2.recognize(val2, nullptr));
+    Render_Opts opts;
+    std::vector<unsigned char> img(8*4*4);
+    geom::cpu_render(shape2, opts, {8,4}, 0.0, 1, img.data());
+    const unsigned char white[4] = {255,255,255,255};
+    const unsigned char red[4] = {255,0,0,255};
+    EXPECT_EQ(memcmp(&img[(1*8 + 0)*4], white, 4), 0);
+    EXPECT_EQ(memcmp(&img[(1*8 + 4)*4], red, 4), 0);
+    EXPECT_EQ(memcmp(&img[(3*8 + 7)*4], white, 4), 0);
+
+    // A cube in 3D. The image doesn't depend on the number of threads.
+    Program prog3{make<String_Source>("", "cube 1"), make_system()};
+    prog3.compile();
+    Value val3 = prog3.eval();
+    Shape_Program shape3(prog3);
+    ASSERT_TRUE(shape3.recognize(val3, nullptr));
+    geom::Compiled_Shape cshape(shape3, geom::Jit_Backend::vm);
+    std::vector<unsigned char> img1(40*40*4), img4(40*40*4);
+    geom::cpu_render(cshape, opts, {40,40}, 0.0, 1, img1.data());
+    geom::cpu_render(cshape, opts, {40,40}, 0.0, 4, img4.data());
+    EXPECT_TRUE(img1 == img4);
+    EXPECT_EQ(memcmp(&img1[0], white, 4), 0);
+    EXPECT_NE(memcmp(&img1[(20*40 + 20)*4], white, 4), 0);
+}
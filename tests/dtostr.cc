@@ -92,3 +92,36 @@ TEST(curv, dtostr)
     double huge = nextafter(infinity, 0.);
     DTEST(huge, "1.7976931348623157e308");
 }
+
+void
+ftest(const char*file, int line, float n, const char*str)
+{
+    char buf[DTOSTR_BUFSIZE];
+    ftostr(n, buf);
+    if (strcmp(buf,str) != 0) {
+        cout << file << ":" << line << ":"
+             << " expected " << str << " got " << buf << "\n";
+        EXPECT_TRUE(false);
+    }
+    if (!isnan(n) && strtof(buf, NULL) != n) {
+        cout << file << ":" << line << ":"
+             << " at " << str << ", round trip failed\n";
+        EXPECT_TRUE(false);
+    }
+}
+
+#define FTEST(n,s) ftest(__FILE__,__LINE__,n,s)
+
+TEST(curv, ftostr)
+{
+    FTEST(0.f, "0");
+    FTEST(0.1f, "0.1");
+    FTEST(-1.5f, "-1.5");
+    FTEST(1000.f, "1000");
+    FTEST(10000.f, "1e4");
+    FTEST(0.00001f, "1e-5");
+    FTEST(3.14159265358979323846264f, "3.1415927");
+    FTEST(16777216.f, "16777216");
+    FTEST(1.f/0.f, "inf");
+    FTEST(0.f/0.f, "nan");
+}
@@ -19,18 +19,27 @@ std::stringstream sconsole;
 
 struct Std_System : public System_Impl
 {
-    Std_System() : System_Impl(sconsole)
+    Std_System(bool bytecode) : System_Impl(sconsole)
     {
+        use_bytecode_ = bytecode;
         curv::geom::add_builtins(*this);
         load_library("../lib/curv/std.curv");
     }
 };
 
+// The evaluator tests are run twice: once using the tree walking interpreter,
+// and once using the bytecode interpreter.
+bool use_bytecode = false;
+
 curv::System&
 make_system()
 {
     try {
-        static Std_System sys;
+        if (use_bytecode) {
+            static Std_System sys(true);
+            return sys;
+        }
+        static Std_System sys(false);
         return sys;
     } catch (std::exception& e) {
         System::print_exception("ERROR: ", e, std::cerr);
@@ -200,7 +209,8 @@ int reps()
 #define FAILMSG(expr,result) EXPECT_PRED_FORMAT2(eval_failmsg,expr,result)
 #define FAILALL(expr,result) EXPECT_PRED_FORMAT2(eval_failall,expr,result)
 
-TEST(curv, eval)
+void
+eval_tests()
 {
   int r = reps();
   for (int i = 0; i < r; ++i) {
@@ -239,7 +249,25 @@ TEST(curv, eval)
     SUCCESS("[10,20]-3", "[7,17]");
     SUCCESS("5-[1,2]", "[4,3]");
     SUCCESS("[1,2]-[10,20]", "[-9,-18]");
+    SUCCESS("[[1,2],[3,4]]*[10,100]", "[[10,20],[300,400]]");
+    SUCCESS("[1,[2,3]]+1", "[2,[3,4]]");
+    SUCCESS("-[1,[2,3]]", "[-1,[-2,-3]]");
+    FAILMSG("[1,0]/[2,0]", "0 / 0: domain error");
+    FAILMSG("[1,null]+1", "#null + 1: domain error");
+    SUCCESS("dot([1,2,3],[4,5,6])", "32");
+    SUCCESS("dot([[1,2],[3,4]],[5,6])", "[17,39]");
+    FAILMSG("dot([inf,1],[0,1])",
+        "argument #1 of dot: inf * 0: domain error");
+    SUCCESS("sum([[1,2],[3,4]])", "[4,6]");
+    SUCCESS("max([[1,5],[3,2]])", "[3,5]");
     FAILMSG("inf-inf","inf - inf: domain error");
+    // The same, in a function body, which is compiled to bytecode.
+    FAILMSG("(x -> x - x)(inf)", "inf - inf: domain error");
+    FAILMSG("(x -> x + -x)(inf)", "inf + -inf: domain error");
+    FAILMSG("(x -> x * 0)(inf)", "inf * 0: domain error");
+    FAILMSG("(x -> x / x)(0)", "0 / 0: domain error");
+    FAILMSG("(x -> [x - x])(inf)", "inf - inf: domain error");
+    FAILMSG("(x -> x ^ 0.5)(-1)", "-1 ^ 0.5: domain error");
     FAILMSG("[]-[1]","mismatched list sizes (0,1) in array operation");
     FAILMSG("0/0", "0 / 0: domain error");
     SUCCESS("1/0", "inf");
@@ -393,6 +421,10 @@ TEST(curv, eval)
     FAILMSG("for (i) x", "syntax error: expecting 'in'");
     FAILMSG("for (42 in i) x", "not a pattern");
     SUCCESS("[for (i in [1,2,3]) i+1]", "[2,3,4]");
+    SUCCESS("[for (i in 1..3 by 0.5) i*2]", "[2,3,4,5,6]");
+    SUCCESS("[for (i in 3..<0 by -1) i]", "[3,2,1]");
+    SUCCESS("[for (i in 0..<999999999 while i < 3) i]", "[0,1,2]");
+    FAILMSG("[for (i in 1..inf) i]", "1 .. inf: too many elements in range");
 
     // generalized actions
     SUCCESS("do (let a=-2 in for(b in a..2) if(b>0) print b);"
@@ -490,3 +522,34 @@ TEST(curv, eval)
         "Try 'local x = 1' if you want a local definition.");
   }
 }
+
+TEST(curv, eval)
+{
+    use_bytecode = false;
+    eval_tests();
+}
+
+TEST(curv, eval_bytecode)
+{
+    use_bytecode = true;
+    eval_tests();
+    use_bytecode = false;
+}
+
+TEST(curv, eval_parallel)
+{
+    make_system().eval_threads_ = 4;
+    eval_tests();
+
+    // Independent definitions are evaluated in parallel, in dependency order.
+    SUCCESS("let a = 1; b = a + 1; f x = x + c; c = 10; d = f b in [a,b,d]",
+        "[1,2,12]");
+    SUCCESS("{a = 1; b = [a, c]; c = 3}", "{a:1,b:[1,3],c:3}");
+    // If several definitions fail, the first error is reported,
+    // as it is with serial evaluation.
+    FAILMSG("let a = 1; b = error \"first\"; c = error \"second\" in a",
+        "first");
+    FAILMSG("let b = c + error \"first\"; c = error \"second\" in b",
+        "second");
+    make_system().eval_threads_ = 1;
+}
@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 #include <libcurv/output_file.h>
+#include <libcurv/geom/jit_cache.h>
+#include <libcurv/context.h>
+#include <libcurv/import.h>
+#include <libcurv/program.h>
+#include <libcurv/source.h>
 #include <sstream>
 #include <fstream>
 #include <cstdio>
@@ -61,3 +66,122 @@ TEST(curv, output_file)
     ASSERT_EQ(readfile(p4), "foo");
     remove(",f4");
 }
+
+TEST(curv, jit_cache)
+{
+    using curv::geom::Jit_Cache;
+    fs::path dir(",jit_cache");
+    fs::remove_all(dir);
+
+    auto k1 = Jit_Cache::key("source", "-O3");
+    ASSERT_EQ(k1, Jit_Cache::key("source", "-O3"));
+    ASSERT_NE(k1, Jit_Cache::key("source", "-O2"));
+    ASSERT_NE(Jit_Cache::key("ab", "c"), Jit_Cache::key("a", "bc"));
+    auto k2 = Jit_Cache::key("source2", "-O3");
+
+    Jit_Cache disabled(fs::path(), 100);
+    ASSERT_FALSE(disabled.enabled());
+    ASSERT_TRUE(disabled.lookup(k1).empty());
+
+    // Each entry is 10 bytes, and the cache holds at most 15 bytes,
+    // so inserting a second entry evicts the first.
+    Jit_Cache cache(dir, 15);
+    writefile(",jit.so", "0123456789");
+    ASSERT_TRUE(cache.lookup(k1).empty());
+    cache.insert(k1, ",jit.so");
+    auto so = cache.lookup(k1);
+    ASSERT_FALSE(so.empty());
+    ASSERT_EQ(readfile(so), "0123456789");
+
+    fs::last_write_time(so, fs::last_write_time(so) - 10);
+    cache.insert(k2, ",jit.so");
+    ASSERT_TRUE(cache.lookup(k1).empty());
+    ASSERT_FALSE(cache.lookup(k2).empty());
+
+    remove(",jit.so");
+    fs::remove_all(dir);
+}
+
+TEST(curv, import_cache)
+{
+    auto eval = [](const char* src) -> Value {
+        Program prog{make<String_Source>("", src), sys};
+        prog.compile();
+        return prog.eval();
+    };
+    writefile(",imp_a.curv", "file \",imp_b.curv\" + 1");
+    writefile(",imp_b.curv", "1");
+    unsigned hits = sys.import_hits_;
+    unsigned misses = sys.import_misses_;
+
+    ASSERT_EQ(eval("[file \",imp_a.curv\", file \",imp_a.curv\"]")
+        .equal(eval("[2,2]"), At_System{sys}), true);
+    ASSERT_EQ(sys.import_misses_ - misses, 2u);
+    ASSERT_EQ(sys.import_hits_ - hits, 1u);
+
+    // Changing a file imported by ,imp_a.curv invalidates its cache entry.
+    writefile(",imp_b.curv", "2");
+    ASSERT_EQ(eval("file \",imp_a.curv\"").to_num_or_nan(), 3.0);
+    ASSERT_EQ(sys.import_misses_ - misses, 4u);
+    ASSERT_EQ(eval("file \",imp_a.curv\"").to_num_or_nan(), 3.0);
+    ASSERT_EQ(sys.import_hits_ - hits, 2u);
+
+    // A file that imports a directory depends on the directory listing.
+    fs::create_directory(",imp_d");
+    writefile(",imp_d/x.curv", "1");
+    writefile(",imp_c.curv", "count(fields(file \",imp_d\"))");
+    ASSERT_EQ(eval("file \",imp_c.curv\"").to_num_or_nan(), 1.0);
+    writefile(",imp_d/y.curv", "1");
+    ASSERT_EQ(eval("file \",imp_c.curv\"").to_num_or_nan(), 2.0);
+
+    remove(",imp_a.curv");
+    remove(",imp_b.curv");
+    remove(",imp_c.curv");
+    fs::remove_all(",imp_d");
+}
+
+// An importer for *.edit files, which overwrites another file while the
+// program that imports it is being evaluated.
+static const char* edit_path = nullptr;
+static Value edit_import(const fs::path&, const Context&)
+{
+    writefile(edit_path, "100");
+    return Value{0.0};
+}
+
+TEST(curv, import_deps_edited_during_eval)
+{
+    // Evaluate a program file the way live mode does, and report if one of
+    // the files it depends on changed after it was read.
+    auto edited = [](const char* path) -> bool {
+        System::File_Hashes deps{{fs::path(path), hash_file(path)}};
+        Record_Imports record(sys, deps);
+        Program prog{make<File_Source>(make_string(path), At_System{sys}),
+            sys};
+        prog.compile();
+        prog.eval();
+        return !files_unchanged(deps);
+    };
+    sys.importers_[".edit"] = edit_import;
+    writefile(",dep_a.curv", "file \",dep_b.curv\" + file \",dep.edit\"");
+    writefile(",dep_b.curv", "1");
+    writefile(",dep.edit", "");
+
+    // An imported file is edited after it is read.
+    edit_path = ",dep_b.curv";
+    ASSERT_TRUE(edited(",dep_a.curv"));
+
+    // The program file is edited after it is read.
+    edit_path = ",dep_a.curv";
+    ASSERT_TRUE(edited(",dep_a.curv"));
+
+    // Rewriting a file with the same contents isn't a change.
+    writefile(",dep_a.curv", "file \",dep_b.curv\" + file \",dep.edit\"");
+    edit_path = ",dep_b.curv";
+    ASSERT_FALSE(edited(",dep_a.curv"));
+
+    sys.importers_.erase(".edit");
+    remove(",dep_a.curv");
+    remove(",dep_b.curv");
+    remove(",dep.edit");
+}
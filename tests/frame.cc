@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <libcurv/frame.h>
+#include <libcurv/system.h>
+
+#include <vector>
+
+using namespace curv;
+
+extern System& make_system();
+
+TEST(curv, frame_stack)
+{
+    System& sys = make_system();
+
+    // Call frames are reused in LIFO order.
+    auto a = make_call_frame(4, sys, nullptr, nullptr, nullptr);
+    auto b = make_call_frame(4, sys, &*a, nullptr, nullptr);
+    Frame* bp = &*b;
+    b = nullptr;
+    b = make_call_frame(4, sys, &*a, nullptr, nullptr);
+    EXPECT_EQ(&*b, bp);
+
+    // A heap frame can be destroyed in any order.
+    auto h = Frame::make(2, sys, nullptr, nullptr, nullptr);
+    auto c = make_call_frame(4, sys, &*b, nullptr, nullptr);
+    h = nullptr;
+
+    // A frame destroyed out of order is reclaimed when the frames above it
+    // are destroyed.
+    b = nullptr;
+    c = nullptr;
+    auto d = make_call_frame(4, sys, &*a, nullptr, nullptr);
+    EXPECT_EQ(&*d, bp);
+    d = nullptr;
+
+    // Deep recursion, using more than one chunk, then a large frame.
+    std::vector<std::unique_ptr<Frame>> stack;
+    for (int i = 0; i < 10000; ++i) {
+        stack.push_back(make_call_frame(8, sys, nullptr, nullptr, nullptr));
+        (*stack.back())[7] = Value{double(i)};
+    }
+    auto big = make_call_frame(100000, sys, nullptr, nullptr, nullptr);
+    (*big)[99999] = Value{1.0};
+    EXPECT_EQ((*stack[1234])[7].to_num_or_nan(), 1234.0);
+    big = nullptr;
+    while (!stack.empty())
+        stack.pop_back();
+    a = nullptr;
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+#include <libcurv/context.h>
+#include <libcurv/exception.h>
+#include <libcurv/json.h>
+#include <sstream>
+#include "sys.h"
+using namespace curv;
+
+// Read a JSON text, then write it back out as JSON.
+static std::string round_trip(const char* json)
+{
+    std::stringstream ss;
+    write_json_value(read_json_value(json, At_System{sys}), ss);
+    return ss.str();
+}
+
+TEST(curv, json)
+{
+    EXPECT_EQ(round_trip("1"), "1");
+    EXPECT_EQ(round_trip(" -2.5e1 "), "-25");
+    EXPECT_EQ(round_trip("[true, false, null]"), "[true,false,null]");
+    EXPECT_EQ(round_trip("{\"b\": [], \"a\": {}}"), "{\"a\":{},\"b\":[]}");
+    EXPECT_EQ(round_trip("\"q\\\"\\\\\\/\\n\\t\""), "\"q\\\"\\\\/\\n\\t\"");
+    EXPECT_EQ(round_trip("\"\\u0041\\u00e9\""), "\"A\\u00C3\\u00A9\"");
+
+    EXPECT_THROW(read_json_value("", At_System{sys}), Exception);
+    EXPECT_THROW(read_json_value("[1,]", At_System{sys}), Exception);
+    EXPECT_THROW(read_json_value("{\"a\" 1}", At_System{sys}), Exception);
+    EXPECT_THROW(read_json_value("\"abc", At_System{sys}), Exception);
+    EXPECT_THROW(read_json_value("1 2", At_System{sys}), Exception);
+}
@@ -22,3 +22,30 @@ TEST(curv, list)
     x = nullptr;
     ASSERT_EQ(y->use_count, 1u);
 }
+
+TEST(curv, list_builder)
+{
+    List_Builder lb;
+    ASSERT_TRUE(lb.empty());
+    auto empty = lb.get_list();
+    ASSERT_EQ(empty->size(), 0u);
+
+    // Grow the buffer several times, holding references to a shared value,
+    // which must survive the buffer being reallocated.
+    auto y = Shared<List>{List::make(0)};
+    for (int i = 0; i < 100; ++i)
+        lb.push_back(i % 2 ? Value{double(i)} : Value{y});
+    ASSERT_EQ(lb.size(), 100u);
+    ASSERT_EQ(y->use_count, 51u);
+    auto x = lb.get_list();
+    ASSERT_EQ(x->size(), 100u);
+    ASSERT_TRUE(lb.empty());
+    ASSERT_TRUE((*x)[99].eq(Value{99.0}));
+    ASSERT_TRUE((*x)[98].eq(Value{y}));
+    x = nullptr;
+    ASSERT_EQ(y->use_count, 1u);
+
+    // The builder can be reused after get_list().
+    lb.push_back(Value{1.0});
+    ASSERT_EQ(lb.get_list()->size(), 1u);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <libcurv/geom/mesh.h>
+#include <libcurv/program.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+
+#include <cstring>
+#include <sstream>
+
+using namespace curv;
+
+extern System& make_system();
+
+TEST(curv, mesh_writers)
+{
+    // A unit square in the XY plane, as a quad, and a triangle above it.
+    geom::Mesh mesh;
+    mesh.points_ = {{0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,0.5}};
+    mesh.quads_ = {{0,1,2,3}};
+    mesh.triangles_ = {{0,1,4}};
+    EXPECT_EQ(mesh.ntriangles(), 3u);
+
+    std::ostringstream obj;
+    geom::write_obj(mesh, obj);
+    EXPECT_EQ(obj.str(),
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 1 1 0\n"
+        "v 0 1 0\n"
+        "v 0 0 0.5\n"
+        "f 1 2 5\n"
+        "f 1 2 3 4\n");
+
+    std::ostringstream stl;
+    geom::write_stl(mesh, false, stl);
+    std::string facet1 =
+        "solid curv\n"
+        "facet normal 0 -1 0\n"
+        " outer loop\n"
+        "  vertex 0 0 0\n"
+        "  vertex 1 0 0\n"
+        "  vertex 0 0 0.5\n"
+        " endloop\n"
+        "endfacet\n";
+    EXPECT_EQ(stl.str().substr(0, facet1.size()), facet1);
+
+    // Binary STL: 80 byte header, triangle count, 50 bytes per triangle.
+    std::ostringstream bin;
+    geom::write_stl(mesh, true, bin);
+    std::string b = bin.str();
+    ASSERT_EQ(b.size(), 84u + 3*50u);
+    EXPECT_NE(b.substr(0,5), "solid");
+    EXPECT_EQ(b.substr(80,4), std::string("\3\0\0\0", 4));
+    // the first vertex of the third triangle (the 2nd half of the quad)
+    float v[3];
+    memcpy(v, &b[84 + 2*50 + 12], 12);
+    EXPECT_EQ(v[0], 0.0f);
+    EXPECT_EQ(v[1], 0.0f);
+    EXPECT_EQ(v[2], 0.0f);
+    // its normal is +Z
+    memcpy(v, &b[84 + 2*50], 12);
+    EXPECT_EQ(v[2], 1.0f);
+
+    Program prog{make<String_Source>("", "cube 2 >> colour red"),
+        make_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    ASSERT_TRUE(shape.recognize(val, nullptr));
+    std::ostringstream x3d;
+    geom::write_x3d(mesh, shape, geom::Mesh_Colouring::face, x3d);
+    std::string x = x3d.str();
+    EXPECT_NE(x.find("colorPerVertex=\"false\" coordIndex="
+        "\"0 1 4 -1 0 1 2 -1 0 2 3 -1\""), std::string::npos);
+    EXPECT_NE(x.find("<Coordinate point=\"0 0 0 1 0 0 1 1 0 0 1 0 0 0 0.5\""),
+        std::string::npos);
+    EXPECT_NE(x.find("<Color color=\" 1 0 0 1 0 0 1 0 0\""),
+        std::string::npos);
+}
+
+TEST(curv, mesh_stream)
+{
+    // Two triangles sharing an edge, written as 2 pieces. The shared points
+    // have the same ids in both pieces, and are only written once.
+    geom::Mesh a, b;
+    a.points_ = {{0,0,0}, {1,0,0}, {0,1,0}};
+    a.triangles_ = {{0,1,2}};
+    b.points_ = {{0,1,0}, {1,0,0}, {1,1,0}};
+    b.triangles_ = {{1,2,0}};
+
+    std::ostringstream obj;
+    geom::Mesh_Stream os(geom::Mesh_Stream::Format::obj, obj);
+    os.write(a, {0,1,2});
+    os.write(b, {2,1,3});
+    os.finish();
+    EXPECT_EQ(obj.str(),
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 0 1 0\n"
+        "f 1 2 3\n"
+        "v 1 1 0\n"
+        "f 2 4 3\n");
+
+    // The triangle count of a binary STL file is filled in by finish().
+    std::ostringstream stl;
+    geom::Mesh_Stream ss(geom::Mesh_Stream::Format::binary_stl, stl);
+    ss.write(a, {0,1,2});
+    ss.write(b, {2,1,3});
+    ss.finish();
+    std::string s = stl.str();
+    ASSERT_EQ(s.size(), 84u + 2*50u);
+    EXPECT_EQ(s.substr(80,4), std::string("\2\0\0\0", 4));
+}
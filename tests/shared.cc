@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <libcurv/list.h>
+#include <libcurv/program.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+
+#include <thread>
+#include <vector>
+
+using namespace curv;
+
+extern System& make_system();
+
+TEST(curv, thread_shared)
+{
+    auto x = make_list(1);
+    Value v{x};
+    {
+        Thread_Shared_Scope scope;
+        EXPECT_TRUE(is_thread_shared());
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&]() -> void {
+                for (int j = 0; j < 100000; ++j) {
+                    Value copy = v;
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+    }
+    EXPECT_FALSE(is_thread_shared());
+    EXPECT_EQ(x->use_count, 2u);
+
+    // A shape can be sampled by multiple threads, each using its own copy
+    // of the Shape_Program.
+    Program prog{make<String_Source>("",
+        "let r = 2 in make_shape {"
+        "  dist p = mag[p[X],p[Y],p[Z]] - r;"
+        "  colour p = [1,0,0];"
+        "  is_3d = true;"
+        "}"),
+        make_system()};
+    prog.compile();
+    Value val = prog.eval();
+    Shape_Program shape(prog);
+    ASSERT_TRUE(shape.recognize(val, nullptr));
+    std::vector<double> dists(4);
+    {
+        Thread_Shared_Scope scope;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&,i]() -> void {
+                Shape_Program copy(shape);
+                double d = 0.0;
+                for (int j = 0; j < 1000; ++j)
+                    d = copy.dist(i, 0, 0, 0);
+                dists[i] = d;
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+    }
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(dists[i], i - 2.0);
+}
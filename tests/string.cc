@@ -44,4 +44,33 @@ TEST(curv, string)
     //ASSERT_TRUE(m["2"] == 2);
     //ASSERT_TRUE(m["3"] == 3);
     //ASSERT_TRUE(m["4"] == 4);
+
+    // symbols are interned
+    ASSERT_EQ(a0.get(), a1.get());
+    ASSERT_EQ(a0.hash(), a1.hash());
+    ASSERT_EQ(make_symbol(std::string("foo")).get(), a0.get());
+    ASSERT_EQ(token_to_symbol(Range<const char*>("'foo'", 5)), a0);
+
+    // a large map uses binary search, a small map uses linear search;
+    // both iterate in alphabetical order.
+    Symbol_Map<int> big;
+    for (int i = 99; i >= 0; --i) {
+        big[make_symbol(stringify(i)->c_str())] = i;
+        if (i == 90)
+            ASSERT_EQ(big.find(make_symbol("95"))->second, 95);
+    }
+    ASSERT_EQ(big.size(), 100u);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(big.at(make_symbol(stringify(i)->c_str())), i);
+    ASSERT_TRUE(big.find(make_symbol("100")) == big.end());
+    ASSERT_FALSE(big.insert({make_symbol("42"), 0}).second);
+    ASSERT_EQ(big[make_symbol("42")], 42);
+    Symbol_Ref prev;
+    for (auto& e : big) {
+        if (!prev.empty())
+            ASSERT_TRUE(prev < e.first);
+        prev = e.first;
+    }
+    ASSERT_EQ(big.erase(make_symbol("42")), 1u);
+    ASSERT_EQ(big.count(make_symbol("42")), 0u);
 }
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <libcurv/geom/cpp_program.h>
+#include <libcurv/geom/vm_program.h>
+#include <libcurv/context.h>
+#include <libcurv/format.h>
+#include <libcurv/list.h>
+#include <libcurv/program.h>
+#include <libcurv/shape.h>
+#include <libcurv/source.h>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace curv;
+
+extern System& make_system();
+
+// The shapes of the standard library, and the operations on them.
+static const char shapes_src[] = R"(
+[
+circle 1,
+square 1,
+rect(1,2),
+regular_polygon 5,
+convex_polygon[[0,0],[1,0],[0,1]],
+intersection[half_plane{d: 1, normal: [0,1]}, circle 3],
+sphere 1,
+cube 1,
+box(1,2,3),
+cylinder{d:1, h:2},
+cone{d:1, h:2},
+torus{major: 2, minor: 1},
+prism 6,
+tetrahedron 1,
+octahedron 1,
+dodecahedron 1,
+icosahedron 1,
+intersection[half_space{d: 1, normal: [0,0,1]}, sphere 3],
+nothing,
+everything >> colour red,
+complement(circle 1),
+union[circle 1, square 1 >> move(1,0)],
+union[for (i in 0..<20) sphere 0.2 >> move(i/4, 0, 0)],
+intersection[circle 1, square 1 >> move(1,0)],
+symmetric_difference[circle 1, square 1 >> move(1,0)],
+row[circle 1, square 1, rect(1,2)],
+smooth 0.5 .union[sphere 1, cube 1 >> move(1,0,0)],
+smooth 0.5 .intersection[sphere 1, cube 1 >> move(0.5,0,0)],
+smooth 0.5 .difference[sphere 1, cube 1 >> move(0.5,0,0)],
+chamfer 0.5 .union[sphere 1, cube 1 >> move(1,0,0)],
+circle 1 >> move(1,2),
+cube 1 >> rotate{angle: 1, axis: [1,1,0]},
+square 1 >> rotate 0.5,
+cube 1 >> scale 2,
+cube 1 >> stretch[1,2,3],
+cube 1 >> reflect_x,
+cube 1 >> reflect_xy,
+cube 1 >> move(1,2,3) >> reflect_yz,
+cube 1 >> move(1,2,3) >> reflect Z_axis,
+square 1 >> shear_x 0.5,
+rect(1,3) >> local_taper_x {range: (-1,1), scale: (0.5,1.5)},
+box(1,1,3) >> local_taper_xy {range: (-1,1), scale: ([0.5,1],[1.5,2])},
+cube 1 >> at [1,0,0] (rotate{angle: 1, axis: [0,0,1]}),
+sphere 1 >> slice_xy,
+cube 1 >> rotate{angle: 1, axis: [1,0,0]} >> slice_xz,
+circle 1 >> extrude 2,
+morph 0.3 (sphere 1, cube 1),
+loft 1 (circle 1, square 1),
+revolve(circle 0.5 >> move(1,0)),
+circle 0.3 >> repeat_x 1,
+circle 0.3 >> repeat_xy [1,2],
+sphere 0.3 >> repeat_xyz [1,2,3],
+circle 0.3 >> move(1,0) >> repeat_mirror_x,
+rect(0.2,0.5) >> move(0,1) >> repeat_radial 5,
+box(1,1,3) >> twist 1,
+rect(4,1) >> bend{},
+cube 1 >> offset 0.2,
+cube 1 >> shell 0.1,
+square 1 >> pancake 0.2,
+cube 1 >> lipschitz 2,
+intersection[gyroid, sphere 3],
+square 2 >> colour (sRGB.hue 0.3),
+cube 2 >> colour ((x,y,z,t) -> [abs x, abs y, mod(z+t,1)]),
+intersection[make_texture(i_linear 1 >> i_animate 2, sRGB.hue), square 4],
+intersection[make_texture(i_radial 3, sRGB.hue), square 4],
+intersection[make_texture(i_concentric 1, sRGB.hue), square 4],
+intersection[make_texture(i_gyroid, sRGB.hue), cube 4],
+show_dist(circle 1),
+distance_field(square 1),
+show_axes(cube 1),
+show_axes(circle 1),
+show_bbox(sphere 1 >> stretch[1,2,3]),
+show_gradient(0.1,0.2) (circle 1),
+intersection[show_ifield i_gyroid, square 4],
+intersection[show_colour blue, circle 1],
+show_cmap(sRGB.hue),
+cube 1 >> set_bbox[[-2,-2,-2],[2,2,2]],
+]
+)";
+
+// Each shape's dist and colour functions are compiled to C++ by SC_Compiler.
+// The VM backend parses that C++ code and lowers it to VM code. Check that
+// both backends compute the same results, at points inside, on and around
+// the bounding box, and at two different times.
+TEST(curv, vm_vs_cpp)
+{
+    System& sys = make_system();
+    Program prog{make<String_Source>("", shapes_src), sys};
+    prog.compile();
+    auto shapes = prog.eval().to<List>(At_Program(prog));
+
+    std::vector<std::unique_ptr<Shape_Program>> sp;
+    geom::Cpp_Program cpp(sys);
+    geom::VM_Program vm(sys);
+    At_System cx{sys};
+    for (size_t i = 0; i < shapes->size(); ++i) {
+        sp.push_back(std::make_unique<Shape_Program>(prog));
+        ASSERT_TRUE(sp[i]->recognize(shapes->at(i), nullptr)) << i;
+        auto dname = stringify("dist",i);
+        auto cname = stringify("colour",i);
+        cpp.define_function(dname->c_str(), SC_Type::Vec(4), SC_Type::Num(),
+            sp[i]->dist_fun_, cx);
+        cpp.define_function(cname->c_str(), SC_Type::Vec(4), SC_Type::Vec(3),
+            sp[i]->colour_fun_, cx);
+        vm.define_function(dname->c_str(), SC_Type::Vec(4), SC_Type::Num(),
+            sp[i]->dist_fun_, cx);
+        vm.define_function(cname->c_str(), SC_Type::Vec(4), SC_Type::Vec(3),
+            sp[i]->colour_fun_, cx);
+    }
+    cpp.compile(cx);
+    vm.compile(cx);
+
+    typedef void (*Dist_Func)(const glm::vec4*, float*);
+    typedef void (*Colour_Func)(const glm::vec4*, glm::vec3*);
+    auto close = [](float a, float b) -> bool {
+        if (std::isinf(a) || std::isinf(b)) return a == b;
+        return std::abs(a - b) <= 1e-4f * (1.0f + std::abs(a));
+    };
+    for (size_t i = 0; i < sp.size(); ++i) {
+        auto dname = stringify("dist",i);
+        auto cname = stringify("colour",i);
+        auto cpp_dist = (Dist_Func) cpp.get_function(dname->c_str());
+        auto cpp_colour = (Colour_Func) cpp.get_function(cname->c_str());
+        auto& vm_dist = vm.get_function(dname->c_str());
+        auto& vm_colour = vm.get_function(cname->c_str());
+        auto regs = vm_dist.make_registers();
+        auto cregs = vm_colour.make_registers();
+
+        const BBox& b = sp[i]->bbox_;
+        // The grid is not quite symmetric. At a point that is equidistant
+        // from two shapes, the colour of a union depends on rounding, and
+        // the C++ compiler may contract a*b+c into a fused multiply-add.
+        auto coord = [](double lo, double hi, int k, double skew) -> float {
+            if (!std::isfinite(lo) || !std::isfinite(hi)) {
+                lo = -3.0;
+                hi = 3.0;
+            }
+            double pad = (hi - lo) * 0.25 + 0.1;
+            return float(lo - pad + (hi - lo + 2*pad) * (k + skew) / 6.5);
+        };
+        for (int t = 0; t < 2; ++t)
+        for (int kz = 0; kz <= (sp[i]->is_3d_ ? 6 : 0); ++kz)
+        for (int ky = 0; ky <= 6; ++ky)
+        for (int kx = 0; kx <= 6; ++kx) {
+            glm::vec4 p{coord(b.xmin, b.xmax, kx, 0.13),
+                coord(b.ymin, b.ymax, ky, 0.29),
+                sp[i]->is_3d_ ? coord(b.zmin, b.zmax, kz, 0.41) : 0.0f,
+                float(t * 0.7)};
+            float in[4] = {p.x, p.y, p.z, p.w};
+            float d1, d2;
+            cpp_dist(&p, &d1);
+            vm_dist.call(in, &d2, regs.data());
+            EXPECT_TRUE(close(d1, d2))
+                << "shape " << i << " dist(" << p.x << "," << p.y << ","
+                << p.z << "," << p.w << "): cpp " << d1 << ", vm " << d2;
+            glm::vec3 c1;
+            float c2[3];
+            cpp_colour(&p, &c1);
+            vm_colour.call(in, c2, cregs.data());
+            EXPECT_TRUE(close(c1.x, c2[0]) && close(c1.y, c2[1])
+                && close(c1.z, c2[2]))
+                << "shape " << i << " colour(" << p.x << "," << p.y << ","
+                << p.z << "," << p.w << "): cpp " << c1.x << "," << c1.y
+                << "," << c1.z << ", vm " << c2[0] << "," << c2[1] << ","
+                << c2[2];
+        }
+    }
+}